@@ -1,6 +1,12 @@
+import gzip
+import hashlib
+import os
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome.components.esp32 import add_idf_sdkconfig_option
 from esphome.const import CONF_ID
+from esphome.core import ID, HexInt
 
 ftp_http_proxy_ns = cg.esphome_ns.namespace('ftp_http_proxy')
 FTPHTTPProxy = ftp_http_proxy_ns.class_('FTPHTTPProxy', cg.Component)
@@ -9,6 +15,44 @@ CONF_FTP_SERVER = 'ftp_server'
 CONF_USERNAME = 'username'
 CONF_PASSWORD = 'password'
 CONF_LOCAL_PORT = 'local_port'
+CONF_POOL_SIZE = 'pool_size'
+CONF_MAX_TRANSFERS = 'max_transfers'
+CONF_TRANSFER_QUEUE_SIZE = 'transfer_queue_size'
+CONF_EVENT_LOOP_STREAMS = 'event_loop_streams'
+CONF_SEGMENTED_DOWNLOAD = 'segmented_download'
+CONF_CONNECTIONS = 'connections'
+CONF_THRESHOLD = 'threshold'
+CONF_SEGMENT_SIZE = 'segment_size'
+CONF_LISTING_CACHE_TTL = 'listing_cache_ttl'
+CONF_LISTING_CACHE_SIZE = 'listing_cache_size'
+CONF_FILE_METADATA_SIZE = 'file_metadata_size'
+CONF_CONTENT_CACHE_SIZE = 'content_cache_size'
+CONF_CONTENT_CACHE_MAX_FILE = 'content_cache_max_file'
+CONF_PERSIST_PARTITION = 'persist_partition'
+
+WEB_DIR = os.path.join(os.path.dirname(__file__), 'web')
+WEB_CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+    '.json': 'application/json',
+}
+
+def web_assets():
+    """Fichiers de web/ compressés: (uri, type, contenu gzip, etag)."""
+    for name in sorted(os.listdir(WEB_DIR)):
+        content_type = WEB_CONTENT_TYPES.get(os.path.splitext(name)[1].lower())
+        if content_type is None:
+            continue
+        with open(os.path.join(WEB_DIR, name), 'rb') as f:
+            raw = f.read()
+        uri = '/' if name == 'index.html' else '/ui/' + name
+        # mtime=0: sortie identique d'une compilation à l'autre
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '"' + hashlib.sha256(raw).hexdigest()[:16] + '"'
+        yield uri, content_type, data, etag
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(FTPHTTPProxy),
@@ -16,6 +60,26 @@ CONFIG_SCHEMA = cv.Schema({
     cv.Required(CONF_USERNAME): cv.string,
     cv.Required(CONF_PASSWORD): cv.string,
     cv.Optional(CONF_LOCAL_PORT, default=8080): cv.port,
+    cv.Optional(CONF_POOL_SIZE, default=2): cv.int_range(min=1, max=32),
+    cv.Optional(CONF_MAX_TRANSFERS, default=3): cv.int_range(min=1, max=8),
+    cv.Optional(CONF_TRANSFER_QUEUE_SIZE, default=8): cv.int_range(min=1, max=32),
+    # Flux servis par une boucle d'événements unique une fois le RETR accepté; 0 la désactive
+    cv.Optional(CONF_EVENT_LOOP_STREAMS, default=0): cv.int_range(min=0, max=32),
+    # Gros fichiers récupérés par blocs sur plusieurs sessions FTP en parallèle
+    # (liens à forte latence); tampon de connections × segment_size en PSRAM
+    cv.Optional(CONF_SEGMENTED_DOWNLOAD): cv.Schema({
+        cv.Optional(CONF_CONNECTIONS, default=4): cv.int_range(min=2, max=8),
+        cv.Optional(CONF_THRESHOLD, default=8 * 1024 * 1024): cv.int_range(min=64 * 1024),
+        cv.Optional(CONF_SEGMENT_SIZE, default=256 * 1024): cv.int_range(min=16 * 1024, max=4 * 1024 * 1024),
+    }),
+    cv.Optional(CONF_LISTING_CACHE_TTL, default='30s'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_LISTING_CACHE_SIZE, default=16): cv.int_range(min=1, max=256),
+    cv.Optional(CONF_FILE_METADATA_SIZE, default=2048): cv.int_range(min=64, max=65536),
+    # Octets de PSRAM pour le cache de contenu; 0 le désactive
+    cv.Optional(CONF_CONTENT_CACHE_SIZE, default=0): cv.int_range(min=0, max=64 * 1024 * 1024),
+    cv.Optional(CONF_CONTENT_CACHE_MAX_FILE, default=1024 * 1024): cv.int_range(min=1024, max=16 * 1024 * 1024),
+    # Partition NVS des partages (README): repli sur "nvs" si absente de la table
+    cv.Optional(CONF_PERSIST_PARTITION, default='ftp_proxy'): cv.All(cv.string, cv.Length(min=1, max=15)),
 }).extend(cv.COMPONENT_SCHEMA)
 
 async def to_code(config):
@@ -26,4 +90,28 @@ async def to_code(config):
     cg.add(var.set_username(config[CONF_USERNAME]))
     cg.add(var.set_password(config[CONF_PASSWORD]))
     cg.add(var.set_local_port(config[CONF_LOCAL_PORT]))
+    cg.add(var.set_pool_size(config[CONF_POOL_SIZE]))
+    cg.add(var.set_max_transfers(config[CONF_MAX_TRANSFERS]))
+    cg.add(var.set_transfer_queue_size(config[CONF_TRANSFER_QUEUE_SIZE]))
+    cg.add(var.set_event_loop_streams(config[CONF_EVENT_LOOP_STREAMS]))
+    if CONF_SEGMENTED_DOWNLOAD in config:
+        segmented = config[CONF_SEGMENTED_DOWNLOAD]
+        cg.add(var.set_segment_connections(segmented[CONF_CONNECTIONS]))
+        cg.add(var.set_segment_threshold(segmented[CONF_THRESHOLD]))
+        cg.add(var.set_segment_size(segmented[CONF_SEGMENT_SIZE]))
+    if config[CONF_EVENT_LOOP_STREAMS] > 0:
+        # Par flux: socket client, socket de données et session de contrôle du pool
+        transfers = config[CONF_EVENT_LOOP_STREAMS] + config[CONF_MAX_TRANSFERS]
+        sockets = 2 * transfers + config[CONF_POOL_SIZE] + 12
+        add_idf_sdkconfig_option('CONFIG_LWIP_MAX_SOCKETS', min(sockets, 253))
+    cg.add(var.set_listing_cache_ttl(config[CONF_LISTING_CACHE_TTL]))
+    cg.add(var.set_listing_cache_size(config[CONF_LISTING_CACHE_SIZE]))
+    cg.add(var.set_file_metadata_size(config[CONF_FILE_METADATA_SIZE]))
+    cg.add(var.set_content_cache_size(config[CONF_CONTENT_CACHE_SIZE]))
+    cg.add(var.set_content_cache_max_file(config[CONF_CONTENT_CACHE_MAX_FILE]))
+    cg.add(var.set_persist_partition(config[CONF_PERSIST_PARTITION]))
 
+    for index, (uri, content_type, data, etag) in enumerate(web_assets()):
+        data_id = ID(f'{config[CONF_ID].id}_web_asset_{index}', is_declaration=True, type=cg.uint8)
+        data_array = cg.progmem_array(data_id, [HexInt(x) for x in data])
+        cg.add(var.add_web_asset(uri, content_type, data_array, len(data), etag))
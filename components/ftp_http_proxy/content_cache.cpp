@@ -0,0 +1,120 @@
+#include "content_cache.h"
+#include <algorithm>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+CachedContent::~CachedContent() {
+  if (reserved_in) {
+    reserved_in->release_reservation(size);
+  }
+  if (data) {
+    platform::free_buffer(data);
+  }
+}
+
+bool ContentCache::init(size_t budget, size_t max_object) {
+  budget_ = budget;
+  max_object_ = std::min(max_object, budget);
+  if (!enabled()) {
+    return true;
+  }
+  return mutex_.init();
+}
+
+CachedContentPtr ContentCache::allocate(size_t size) {
+  if (!accepts(size)) {
+    return nullptr;
+  }
+  // Place réservée avant l'allocation: des remplissages simultanés ne peuvent pas
+  // dépasser ensemble le budget
+  mutex_.lock();
+  if (reserved_ + size > budget_) {
+    mutex_.unlock();
+    return nullptr;
+  }
+  reserved_ += size;
+  evict_if_needed();
+  mutex_.unlock();
+
+  // PSRAM uniquement: la mémoire interne est réservée aux sockets et aux tampons de transfert
+  auto content = std::make_shared<CachedContent>();
+  content->size = size;
+  content->reserved_in = this;
+  content->data = (uint8_t *)platform::alloc_psram(size);
+  if (!content->data) {
+    return nullptr;  // La réservation est rendue par le destructeur
+  }
+  return content;
+}
+
+void ContentCache::release_reservation(size_t size) {
+  mutex_.lock();
+  reserved_ -= size;
+  mutex_.unlock();
+}
+
+CachedContentPtr ContentCache::get(const std::string &path) {
+  if (!enabled()) {
+    return nullptr;
+  }
+  mutex_.lock();
+  auto it = index_.find(path);
+  if (it == index_.end()) {
+    mutex_.unlock();
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  CachedContentPtr content = it->second->content;
+  mutex_.unlock();
+  return content;
+}
+
+void ContentCache::put(const std::string &path, CachedContentPtr content) {
+  if (!content || !accepts(content->size)) {
+    return;
+  }
+  mutex_.lock();
+  if (content->reserved_in == this) {
+    // La réservation devient l'entrée
+    reserved_ -= content->size;
+    content->reserved_in = nullptr;
+  }
+  auto it = index_.find(path);
+  if (it != index_.end()) {
+    used_ -= it->second->content->size;
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_.push_front(Node{path, content});
+  index_[path] = lru_.begin();
+  used_ += content->size;
+  evict_if_needed();
+  mutex_.unlock();
+}
+
+void ContentCache::invalidate(const std::string &path) {
+  if (!enabled()) {
+    return;
+  }
+  mutex_.lock();
+  auto it = index_.find(path);
+  if (it != index_.end()) {
+    used_ -= it->second->content->size;
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  mutex_.unlock();
+}
+
+void ContentCache::evict_if_needed() {
+  while (!lru_.empty() && used_ + reserved_ > budget_) {
+    Node &oldest = lru_.back();
+    used_ -= oldest.content->size;
+    index_.erase(oldest.path);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "platform.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+class ContentCache;
+
+// Copie locale (PSRAM) du contenu complet d'un fichier distant
+struct CachedContent {
+  ~CachedContent();
+
+  uint8_t *data{nullptr};
+  size_t size{0};
+  std::string validator;                 // ETag (taille et date MDTM) au moment du remplissage
+  int64_t mtime{0};                      // Date MDTM (secondes Unix)
+  std::atomic<int64_t> validated_at{0};  // Dernière validation auprès du serveur (µs)
+  // Remplissage en cours, compté dans le budget de ce cache jusqu'à put() ou abandon
+  ContentCache *reserved_in{nullptr};
+};
+
+using CachedContentPtr = std::shared_ptr<CachedContent>;
+
+// Cache LRU du contenu des fichiers, borné en octets. Les entrées sont
+// partagées: un fichier évincé pendant qu'il est servi reste valide jusqu'à la
+// fin de l'envoi.
+class ContentCache {
+ public:
+  bool init(size_t budget, size_t max_object);
+  bool enabled() const { return budget_ > 0; }
+  bool accepts(int64_t size) const { return enabled() && size > 0 && (size_t)size <= max_object_; }
+
+  // Tampon de remplissage en PSRAM, réservé sur le budget (les entrées les plus
+  // anciennes sont évincées pour lui faire place); nullptr si la taille, le budget
+  // restant après les autres remplissages ou la mémoire ne le permettent pas
+  CachedContentPtr allocate(size_t size);
+
+  CachedContentPtr get(const std::string &path);
+  void put(const std::string &path, CachedContentPtr content);
+  void invalidate(const std::string &path);
+
+  void count_hit() { hits_++; }
+  void count_miss() { misses_++; }
+  uint32_t hits() const { return hits_.load(); }
+  uint32_t misses() const { return misses_.load(); }
+  // Entrées et remplissages en cours
+  size_t used() const { return used_ + reserved_; }
+  size_t budget() const { return budget_; }
+
+ protected:
+  struct Node {
+    std::string path;
+    CachedContentPtr content;
+  };
+
+  friend struct CachedContent;
+
+  // Évince jusqu'à ce que entrées et remplissages tiennent dans le budget
+  void evict_if_needed();
+  void release_reservation(size_t size);
+
+  platform::Mutex mutex_;
+  size_t budget_{0};
+  size_t max_object_{0};
+  size_t used_{0};      // Entrées du cache
+  size_t reserved_{0};  // Remplissages en cours
+  std::list<Node> lru_;  // Le plus récent en tête
+  std::unordered_map<std::string, std::list<Node>::iterator> index_;
+  std::atomic<uint32_t> hits_{0};
+  std::atomic<uint32_t> misses_{0};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
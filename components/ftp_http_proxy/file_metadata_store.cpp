@@ -0,0 +1,99 @@
+#include "file_metadata_store.h"
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+std::string FileMetadataStore::normalize_path(const std::string &path) {
+  std::vector<std::string> segments;
+  size_t pos = 0;
+  while (pos <= path.size()) {
+    size_t slash = path.find('/', pos);
+    if (slash == std::string::npos) slash = path.size();
+    std::string segment = path.substr(pos, slash - pos);
+    pos = slash + 1;
+
+    if (segment.empty() || segment == ".") {
+      continue;
+    }
+    if (segment == "..") {
+      if (!segments.empty()) segments.pop_back();
+      continue;
+    }
+    segments.push_back(std::move(segment));
+  }
+
+  std::string normalized;
+  for (const auto &segment : segments) {
+    if (!normalized.empty()) normalized += '/';
+    normalized += segment;
+  }
+  return normalized;
+}
+
+bool FileMetadataStore::is_shareable(const std::string &path) const {
+  auto it = entries_.find(path);
+  return it != entries_.end() && it->second.meta.shareable;
+}
+
+FileMetadataStore::Node &FileMetadataStore::touch(const std::string &path) {
+  auto result = entries_.emplace(path, Node{});
+  Node &node = result.first->second;
+  if (result.second) {
+    evictable_.push_front(&result.first->first);
+    node.lru_pos = evictable_.begin();
+  } else if (!node.meta.shareable) {
+    evictable_.splice(evictable_.begin(), evictable_, node.lru_pos);
+  }
+  return node;
+}
+
+void FileMetadataStore::set_shareable(const std::string &path, bool shareable) {
+  auto it = entries_.find(path);
+  if (it == entries_.end() && !shareable) {
+    return;  // Rien à retenir pour un fichier inconnu non partageable
+  }
+
+  Node &node = touch(path);
+  if (shareable && !node.meta.shareable) {
+    evictable_.erase(node.lru_pos);  // Épinglé tant qu'il reste partageable
+  } else if (!shareable && node.meta.shareable) {
+    auto key = entries_.find(path);
+    evictable_.push_front(&key->first);
+    node.lru_pos = evictable_.begin();
+  }
+  node.meta.shareable = shareable;
+  evict_if_needed();
+}
+
+void FileMetadataStore::update_stat(const std::string &path, uint64_t size, int64_t mtime, bool exact_mtime,
+                                    const std::string &unique, int64_t stat_at) {
+  Node &node = touch(path);
+  node.meta.has_stat = true;
+  node.meta.size = size;
+  node.meta.mtime = mtime;
+  node.meta.exact_mtime = exact_mtime;
+  node.meta.stat_at = stat_at;
+  node.meta.unique = unique;
+  evict_if_needed();
+}
+
+bool FileMetadataStore::get(const std::string &path, FileMetadata &out) const {
+  auto it = entries_.find(path);
+  if (it == entries_.end()) {
+    return false;
+  }
+  out = it->second.meta;
+  return true;
+}
+
+void FileMetadataStore::evict_if_needed() {
+  while (entries_.size() > max_entries_ && !evictable_.empty()) {
+    const std::string *oldest = evictable_.back();
+    evictable_.pop_back();
+    entries_.erase(*oldest);
+  }
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Métadonnées connues d'un fichier distant
+struct FileMetadata {
+  bool shareable{false};
+  bool has_stat{false};  // Taille/date issues d'un listing
+  uint64_t size{0};
+  int64_t mtime{0};      // Secondes Unix UTC, 0 si inconnue
+  bool exact_mtime{false};  // Date issue d'un MLSD, à la seconde
+  int64_t stat_at{0};    // Instant du listing (horloge de l'appelant)
+  std::string unique;    // Fait MLSD "unique"
+};
+
+// Métadonnées des fichiers indexées par chemin complet normalisé. La mémoire est
+// bornée: au-delà de la limite, les fichiers non partageables les moins récemment
+// vus sont évincés; les fichiers partageables ne le sont jamais.
+// Non synchronisée: l'appelant sérialise les accès.
+class FileMetadataStore {
+ public:
+  // "/a//b/./c/" -> "a/b/c"; ".." remonte d'un niveau sans sortir de la racine
+  static std::string normalize_path(const std::string &path);
+
+  void set_max_entries(size_t max_entries) { max_entries_ = max_entries; }
+
+  // Les chemins passés aux méthodes suivantes doivent être normalisés
+  bool is_shareable(const std::string &path) const;
+  void set_shareable(const std::string &path, bool shareable);
+  void update_stat(const std::string &path, uint64_t size, int64_t mtime, bool exact_mtime,
+                   const std::string &unique, int64_t stat_at);
+  bool get(const std::string &path, FileMetadata &out) const;
+
+  size_t size() const { return entries_.size(); }
+  template<typename F> void for_each_shareable(F callback) const {
+    for (const auto &entry : entries_) {
+      if (entry.second.meta.shareable) callback(entry.first, entry.second.meta);
+    }
+  }
+
+ private:
+  struct Node {
+    FileMetadata meta;
+    std::list<const std::string *>::iterator lru_pos;  // Valide si !meta.shareable
+  };
+
+  Node &touch(const std::string &path);
+  void evict_if_needed();
+
+  std::unordered_map<std::string, Node> entries_;
+  // Fichiers non partageables, le plus récent en tête; les clés pointent dans entries_
+  std::list<const std::string *> evictable_;
+  size_t max_entries_{2048};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
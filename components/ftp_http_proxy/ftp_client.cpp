@@ -0,0 +1,197 @@
+#include "ftp_client.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Au-delà, la ligne est tronquée et le texte de la réponse n'est plus complété
+static const size_t FTP_REPLY_MAX_LINE = 512;
+static const size_t FTP_REPLY_MAX_TEXT = 4096;
+
+// Code d'une ligne "ddd texte", "ddd-texte" ou "ddd" seul; 0 si la ligne n'en porte pas
+static int line_code(const std::string &line) {
+  if (line.size() < 3 || !isdigit((unsigned char)line[0]) || !isdigit((unsigned char)line[1]) ||
+      !isdigit((unsigned char)line[2])) {
+    return 0;
+  }
+  if (line.size() > 3 && line[3] != ' ' && line[3] != '-') {
+    return 0;
+  }
+  return (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0');
+}
+
+bool FtpReply::passive_address(char *ip, size_t ip_size, uint16_t &port) const {
+  if (code != PASSIVE_MODE) {
+    return false;
+  }
+  // RFC 1123 §4.1.2.6: les parenthèses sont facultatives, les six nombres suivent le texte
+  const char *p = text.c_str();
+  while (*p && !isdigit((unsigned char)*p)) {
+    p++;
+  }
+  int h[4], p1, p2;
+  if (sscanf(p, "%d,%d,%d,%d,%d,%d", &h[0], &h[1], &h[2], &h[3], &p1, &p2) != 6) {
+    return false;
+  }
+  for (int value : {h[0], h[1], h[2], h[3], p1, p2}) {
+    if (value < 0 || value > 255) {
+      return false;
+    }
+  }
+  snprintf(ip, ip_size, "%d.%d.%d.%d", h[0], h[1], h[2], h[3]);
+  port = (uint16_t)(p1 * 256 + p2);
+  return true;
+}
+
+size_t FtpReplyParser::feed(const char *data, size_t len) {
+  size_t i = 0;
+  while (i < len && !ready_) {
+    char c = data[i++];
+    if (c == '\n') {
+      if (!line_.empty() && line_.back() == '\r') {
+        line_.pop_back();
+      }
+      this->end_line();
+      line_.clear();
+    } else if (line_.size() < FTP_REPLY_MAX_LINE) {
+      line_ += c;
+    }
+  }
+  return i;
+}
+
+void FtpReplyParser::end_line() {
+  int code = line_code(line_);
+  if (!multiline_) {
+    if (code == 0) {
+      return;  // Ligne parasite entre deux réponses
+    }
+    reply_.code = code;
+    reply_.text.assign(line_, std::min<size_t>(line_.size(), 4), std::string::npos);
+    if (line_.size() > 3 && line_[3] == '-') {
+      multiline_ = true;
+    } else {
+      ready_ = true;
+    }
+    return;
+  }
+
+  if (reply_.text.size() + line_.size() < FTP_REPLY_MAX_TEXT) {
+    reply_.text += '\n';
+    reply_.text += line_;
+  }
+  // Seul le code d'ouverture suivi d'une espace termine la réponse
+  if (code == reply_.code && (line_.size() == 3 || line_[3] == ' ')) {
+    multiline_ = false;
+    ready_ = true;
+  }
+}
+
+FtpReply FtpReplyParser::take() {
+  FtpReply reply = std::move(reply_);
+  reply_ = FtpReply();
+  ready_ = false;
+  return reply;
+}
+
+void FtpReplyParser::reset() {
+  line_.clear();
+  reply_ = FtpReply();
+  multiline_ = false;
+  ready_ = false;
+}
+
+void FtpClient::attach(int sock) {
+  sock_ = sock;
+  out_.clear();
+  parser_.reset();
+  in_pos_ = 0;
+  in_len_ = 0;
+}
+
+void FtpClient::vqueue(const char *format, va_list args) {
+  va_list measure;
+  va_copy(measure, args);
+  int len = vsnprintf(nullptr, 0, format, measure);
+  va_end(measure);
+  if (len < 0) {
+    return;
+  }
+  size_t start = out_.size();
+  out_.resize(start + len + 1);
+  vsnprintf(&out_[start], len + 1, format, args);
+  out_.resize(start + len);
+  out_ += "\r\n";
+}
+
+void FtpClient::queue(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  this->vqueue(format, args);
+  va_end(args);
+}
+
+bool FtpClient::flush() {
+  size_t sent = 0;
+  while (sent < out_.size()) {
+    int n = send(sock_, out_.data() + sent, out_.size() - sent, 0);
+    if (n <= 0) {
+      out_.clear();
+      return false;
+    }
+    sent += n;
+  }
+  out_.clear();
+  return true;
+}
+
+FtpReply FtpClient::command(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  this->vqueue(format, args);
+  va_end(args);
+  if (!this->flush()) {
+    return FtpReply();
+  }
+  return this->read_reply();
+}
+
+bool FtpClient::parse_buffered() {
+  in_pos_ += parser_.feed(in_ + in_pos_, in_len_ - in_pos_);
+  return parser_.ready();
+}
+
+FtpReply FtpClient::read_reply() {
+  while (!this->parse_buffered()) {
+    int n = recv(sock_, in_, sizeof(in_), 0);
+    if (n <= 0) {
+      return FtpReply();
+    }
+    in_pos_ = 0;
+    in_len_ = n;
+  }
+  return parser_.take();
+}
+
+FtpClient::Poll FtpClient::poll_reply(FtpReply &reply) {
+  while (!this->parse_buffered()) {
+    int n = recv(sock_, in_, sizeof(in_), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return Poll::PENDING;
+    }
+    if (n <= 0) {
+      return Poll::CLOSED;
+    }
+    in_pos_ = 0;
+    in_len_ = n;
+  }
+  reply = parser_.take();
+  return Poll::REPLY;
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
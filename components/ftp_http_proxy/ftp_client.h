@@ -0,0 +1,136 @@
+#pragma once
+
+#include "platform.h"
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Réponse complète du serveur FTP (RFC 959 §4.2)
+struct FtpReply {
+  // Codes attendus par le proxy
+  enum Code : int {
+    NONE = 0,  // Pas de réponse: connexion coupée ou délai dépassé
+    DATA_ALREADY_OPEN = 125,
+    FILE_STATUS_OK = 150,
+    COMMAND_OK = 200,
+    SYSTEM_STATUS = 211,
+    FILE_STATUS = 213,
+    SERVICE_READY = 220,
+    DATA_CONNECTION_CLOSED = 225,
+    TRANSFER_COMPLETE = 226,
+    PASSIVE_MODE = 227,
+    LOGGED_IN = 230,
+    FILE_ACTION_OK = 250,
+    NEED_PASSWORD = 331,
+    PENDING_FURTHER_INFO = 350,
+    SERVICE_UNAVAILABLE = 421,
+    TRANSFER_ABORTED = 426,
+    FILE_BUSY = 450,
+    LOCAL_ERROR = 451,
+    FILE_UNAVAILABLE = 550,
+  };
+
+  // Catégorie donnée par le premier chiffre du code
+  enum class Type : uint8_t {
+    NONE = 0,
+    PRELIMINARY = 1,      // 1yz: une autre réponse suivra
+    COMPLETION = 2,       // 2yz
+    INTERMEDIATE = 3,     // 3yz: commande suivante attendue (PASS, après REST...)
+    TRANSIENT_ERROR = 4,  // 4yz
+    PERMANENT_ERROR = 5,  // 5yz
+  };
+
+  int code{NONE};
+  // Texte de la première ligne, puis lignes suivantes telles quelles, séparées par '\n'
+  std::string text;
+
+  bool valid() const { return code != NONE; }
+  bool is(Code expected) const { return code == expected; }
+  Type type() const { return code >= 100 && code < 600 ? (Type)(code / 100) : Type::NONE; }
+  bool preliminary() const { return type() == Type::PRELIMINARY; }
+  bool completion() const { return type() == Type::COMPLETION; }
+  // Fin de RETR, STOR, LIST... réussie
+  bool transfer_complete() const { return code == TRANSFER_COMPLETE || code == FILE_ACTION_OK; }
+  // Début de transfert accepté: 150 ou 125
+  bool transfer_starting() const { return code == FILE_STATUS_OK || code == DATA_ALREADY_OPEN; }
+
+  // Adresse du canal de données d'une réponse 227 "(h1,h2,h3,h4,p1,p2)"
+  bool passive_address(char *ip, size_t ip_size, uint16_t &port) const;
+};
+
+// Assemble les réponses ligne à ligne. Une réponse multiligne "ddd-" ne se termine
+// qu'à la ligne qui commence par le même code suivi d'une espace; les lignes
+// intermédiaires peuvent contenir n'importe quoi, y compris d'autres codes. Les
+// lignes sans code hors d'une réponse multiligne sont ignorées.
+class FtpReplyParser {
+ public:
+  // Consomme des octets jusqu'à la fin d'une réponse au plus et retourne le nombre
+  // d'octets consommés; ready() signale une réponse complète
+  size_t feed(const char *data, size_t len);
+  bool ready() const { return ready_; }
+  // Réponse complète; l'analyse repart pour la suivante
+  FtpReply take();
+  void reset();
+
+ private:
+  void end_line();
+
+  std::string line_;
+  FtpReply reply_;
+  bool multiline_{false};
+  bool ready_{false};
+};
+
+// Client du canal de contrôle FTP sur un socket déjà connecté. Les octets reçus
+// au-delà d'une réponse sont gardés pour la suivante: plusieurs commandes peuvent
+// partir d'un seul envoi (pipelining) et leurs réponses sont lues dans l'ordre.
+// Le socket reste à l'appelant, qui le ferme ou le rend au pool.
+class FtpClient {
+ public:
+  enum class Poll : uint8_t {
+    PENDING,  // Réponse pas encore complète
+    REPLY,    // Réponse lue
+    CLOSED,   // Connexion coupée
+  };
+
+  FtpClient() = default;
+  explicit FtpClient(int sock) : sock_(sock) {}
+
+  // Nouveau socket: commandes et octets en attente de l'ancien abandonnés
+  void attach(int sock);
+  int sock() const { return sock_; }
+
+  // Ajoute une commande au lot à envoyer ("\r\n" ajouté)
+  void queue(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  // Envoie le lot d'un seul tenant; false si la connexion est coupée
+  bool flush();
+  // Commande seule puis sa réponse (une réponse préliminaire 1yz est retournée telle quelle)
+  FtpReply command(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  // Réponse suivante; bloque dans la limite du SO_RCVTIMEO du socket
+  FtpReply read_reply();
+  // Réponse suivante sans bloquer
+  Poll poll_reply(FtpReply &reply);
+  // Octets déjà reçus et pas encore analysés: une réponse peut être disponible sans
+  // que le socket soit lisible
+  bool buffered() const { return in_pos_ < in_len_; }
+
+ private:
+  void vqueue(const char *format, va_list args);
+  // Analyse les octets en attente; true si une réponse est complète
+  bool parse_buffered();
+
+  int sock_{-1};
+  std::string out_;
+  FtpReplyParser parser_;
+  char in_[256];
+  size_t in_pos_{0};
+  size_t in_len_{0};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -1,11 +1,15 @@
 #include "esp_wifi.h"
+#include "ftp_client.h"
 #include "ftp_http_proxy.h"
-#include "web.h"
+#include "http_range.h"
+#include "listing_parser.h"
+#include "multipart_parser.h"
 #include "esphome/core/log.h"
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
 #include <cstring>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include "esp_task_wdt.h"
 #include "esp_heap_caps.h"
 #include "esp_random.h"
@@ -15,6 +19,7 @@
 #include <string>
 #include "esp_timer.h"
 #include "esp_check.h"
+#include <ctime>
 #include <cctype> // Pour std::tolower
 
 #ifndef HTTPD_410_GONE
@@ -23,11 +28,618 @@
 
 static const char *TAG = "ftp_proxy";
 
+// Paramètres du pool de connexions FTP
+static const int64_t FTP_POOL_KEEPALIVE_US = 30 * 1000000LL;    // NOOP après 30 s d'inactivité
+static const int64_t FTP_POOL_MAINTENANCE_US = 5 * 1000000LL;   // Fréquence de la maintenance
+static const uint32_t FTP_POOL_ACQUIRE_TIMEOUT_MS = 15000;      // Attente max d'une connexion libre
+static const uint32_t FTP_DATA_TIMEOUT_S = 15;                  // Canal de données sans activité
+
+// Tampon circulaire entre la lecture FTP et l'envoi HTTP, un par worker, pris dans
+// une réserve allouée au démarrage (PSRAM si possible)
+static const size_t TRANSFER_RING_SIZE = 64 * 1024;
+static const size_t TRANSFER_RING_MIN_SIZE = 8 * 1024;
+static const size_t TRANSFER_MEMORY_BUDGET = 256 * 1024;   // Total pour tous les workers
+
+// Régulation du débit
+static const size_t HTTP_SEND_MAX_CHUNK = 16 * 1024;       // Envoi max par appel
+static const size_t HTTP_SEND_MIN_CHUNK = 1460;            // Un MSS sous pression mémoire
+static const size_t INTERNAL_HEAP_HIGH_WATERMARK = 48 * 1024;
+static const size_t INTERNAL_HEAP_LOW_WATERMARK = 16 * 1024;
+static const uint32_t TRANSFER_LEAD_MS = 500;              // Avance visée du producteur
+static const int64_t FLOW_SAMPLE_US = 100 * 1000;          // Période de mesure du débit
+static const uint32_t HTTP_SEND_STALL_TIMEOUT_MS = 30000;  // Client considéré comme parti
+
+// Workers de transfert
+static const uint32_t TRANSFER_WORKER_STACK = 8192;
+static const uint32_t FTP_READER_STACK = 4096;
+static const char *TRANSFER_RETRY_AFTER = "5";             // Secondes, réponse 503
+
+// Boucle d'événements
+static const uint32_t EVENT_LOOP_STACK = 4096;
+static const size_t EVENT_LOOP_STREAM_BUFFER = 16 * 1024;  // Tampon par flux (PSRAM si possible)
+static const uint32_t EVENT_LOOP_POLL_MS = 1000;           // Vérification des délais sans activité
+
+// Cache des listings de répertoires
+static const size_t LISTING_CACHE_MAX_ENTRIES = 4096;      // Entrées au total, tous répertoires
+static const uint32_t LISTING_STALE_FACTOR = 10;           // Durée de service d'une entrée périmée
+static const uint32_t LISTING_FETCH_WAIT_MS = 15000;
+static const int LISTING_SCRATCH_BLOCKS = 3;               // Listing servi (réception + JSON) et rafraîchissement
+
+// Persistance
+static const char *PERSIST_NAMESPACE = "ftp_proxy";
+static const char *PERSIST_FULL_STATUS = "507 Insufficient Storage";
+static const size_t SHARE_TOKEN_LEN = 8;                   // Token "%08x"
+static const int64_t PERSIST_FLUSH_US = 10 * 1000000LL;    // Regroupement des écritures NVS
+static const time_t WALL_CLOCK_VALID_AFTER = 1600000000;   // Horloge pas encore synchronisée avant
+
+// Cache de contenu
+static const int64_t CONTENT_CACHE_REVALIDATE_US = 10 * 1000000LL;  // Copie servie sans SIZE/MDTM
+
+// Téléchargements partagés
+static const size_t SHARED_DOWNLOAD_WINDOW = 128 * 1024;  // Retard max d'un client rattaché
+static const uint32_t FOLLOWER_DRAIN_MS = 100;            // Clients servis par le meneur après la fin
+
+// Envois vers le serveur FTP
+static const size_t SCRATCH_BLOCK_SIZE = 4096;             // Lecture d'un corps multipart ou d'un listing
+static const int64_t UPLOAD_LOG_INTERVAL = 1024 * 1024;    // Progression dans le journal
+
+// Métriques
+static const int64_t MEMORY_SAMPLE_US = 1000000;          // Relevé du plus grand bloc libre
+
 namespace esphome {
 namespace ftp_http_proxy {
 
+static uint32_t elapsed_ms(int64_t since_us) { return (uint32_t)((esp_timer_get_time() - since_us) / 1000); }
+
+// Temps jusqu'au premier octet du corps, enregistré une seule fois par requête
+static void record_first_byte(FileTransferContext *ctx) {
+  if (ctx->accepted_at) {
+    ctx->proxy->metrics().ttfb_ms.record(elapsed_ms(ctx->accepted_at));
+    ctx->accepted_at = 0;
+  }
+}
+
+// Attend que le socket accepte des données, en nourrissant le watchdog pendant l'attente
+static bool wait_socket_writable(int sock, uint32_t timeout_ms) {
+  if (sock < 0) {
+    return true;
+  }
+  uint32_t waited_ms = 0;
+  while (waited_ms < timeout_ms) {
+    fd_set write_fds;
+    FD_ZERO(&write_fds);
+    FD_SET(sock, &write_fds);
+    struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+    int ret = select(sock + 1, NULL, &write_fds, NULL, &tv);
+    if (ret > 0) {
+      return true;
+    }
+    if (ret < 0 && errno != EINTR) {
+      return false;
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+    waited_ms += 1000;
+  }
+  return false;
+}
+
+// Taille d'envoi réduite progressivement quand la mémoire interne (tampons lwIP) se raréfie
+static size_t compute_send_chunk() {
+  size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  if (free_internal >= INTERNAL_HEAP_HIGH_WATERMARK) {
+    return HTTP_SEND_MAX_CHUNK;
+  }
+  if (free_internal <= INTERNAL_HEAP_LOW_WATERMARK) {
+    return HTTP_SEND_MIN_CHUNK;
+  }
+  size_t span = INTERNAL_HEAP_HIGH_WATERMARK - INTERNAL_HEAP_LOW_WATERMARK;
+  size_t above = free_internal - INTERNAL_HEAP_LOW_WATERMARK;
+  return HTTP_SEND_MIN_CHUNK + (HTTP_SEND_MAX_CHUNK - HTTP_SEND_MIN_CHUNK) * above / span;
+}
+
+// Type MIME d'après l'extension; nullptr si inconnu (le fichier est alors proposé en téléchargement)
+static const char *content_type_for(const std::string &path) {
+  std::string extension;
+  size_t dot_pos = path.find_last_of('.');
+  if (dot_pos != std::string::npos) {
+    extension = path.substr(dot_pos);
+    std::transform(extension.begin(), extension.end(), extension.begin(), 
+                  [](unsigned char c){ return std::tolower(c); });
+  }
+
+  if (extension == ".mp3") return "audio/mpeg";
+  if (extension == ".wav") return "audio/wav";
+  if (extension == ".ogg") return "audio/ogg";
+  if (extension == ".flac") return "audio/flac";
+  if (extension == ".mp4") return "video/mp4";
+  if (extension == ".pdf") return "application/pdf";
+  if (extension == ".jpg" || extension == ".jpeg") return "image/jpeg";
+  if (extension == ".png") return "image/png";
+  return nullptr;
+}
+
+static std::string attachment_disposition(const std::string &path) {
+  size_t slash_pos = path.find_last_of('/');
+  std::string filename = slash_pos != std::string::npos ? path.substr(slash_pos + 1) : path;
+  return "attachment; filename=\"" + filename + "\"";
+}
+
+// Type MIME et disposition d'une réponse de fichier envoyée par httpd_resp_send_chunk()
+static void set_content_headers(FileTransferContext *ctx) {
+  const char *content_type = content_type_for(ctx->remote_path);
+  if (content_type) {
+    httpd_resp_set_type(ctx->req, content_type);
+  } else {
+    // Forcer le téléchargement pour les types inconnus
+    httpd_resp_set_type(ctx->req, "application/octet-stream");
+    ctx->content_disposition = attachment_disposition(ctx->remote_path);
+    httpd_resp_set_hdr(ctx->req, "Content-Disposition", ctx->content_disposition.c_str());
+  }
+  httpd_resp_set_hdr(ctx->req, "Accept-Ranges", "bytes");
+}
+
+// Envoie la ligne de statut et les en-têtes d'une réponse de longueur connue.
+// httpd_resp_send() exige tout le corps en un seul appel bloquant; ici le corps
+// suit par morceaux via send_raw_body(), au rythme du client.
+static bool send_raw_headers(FileTransferContext *ctx, const char *status, int64_t content_length,
+                             const char *content_range) {
+  const char *content_type = content_type_for(ctx->remote_path);
+  std::string headers = "HTTP/1.1 ";
+  headers += status;
+  headers += "\r\nContent-Type: ";
+  headers += content_type ? content_type : "application/octet-stream";
+  headers += "\r\nContent-Length: " + std::to_string(content_length);
+  headers += "\r\nAccept-Ranges: bytes\r\n";
+  if (content_range) {
+    headers += "Content-Range: ";
+    headers += content_range;
+    headers += "\r\n";
+  }
+  if (!content_type) {
+    headers += "Content-Disposition: " + attachment_disposition(ctx->remote_path) + "\r\n";
+  }
+  if (!ctx->etag.empty()) {
+    headers += "ETag: " + ctx->etag + "\r\nLast-Modified: " + ctx->last_modified + "\r\n";
+  }
+  headers += "\r\n";
+  return httpd_send(ctx->req, headers.data(), headers.size()) == (int)headers.size();
+}
+
+static bool send_raw_body(httpd_req_t *req, const uint8_t *data, size_t len) {
+  int client_sock = httpd_req_to_sockfd(req);
+  while (len > 0) {
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+    // Écriture directe sur le socket; attente de place seulement quand il est plein
+    int sent = send(client_sock, data, std::min(len, compute_send_chunk()), MSG_DONTWAIT);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!wait_socket_writable(client_sock, HTTP_SEND_STALL_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Client HTTP bloqué, abandon de l'envoi");
+        return false;
+      }
+      continue;
+    }
+    if (sent <= 0) {
+      ESP_LOGE(TAG, "Échec d'envoi au client HTTP: %d", errno);
+      return false;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+// Échec d'une réponse: erreur HTTP tant que rien n'est parti, sinon fermeture de la
+// connexion pour que le client constate la troncature au lieu d'attendre la suite
+static void fail_response(FileTransferContext *ctx, ErrorCause cause, httpd_err_code_t code, const char *message) {
+  ctx->proxy->metrics().count_error(cause);
+  ctx->proxy->metrics().transfers_failed.inc();
+  if (!ctx->headers_sent) {
+    httpd_resp_send_err(ctx->req, code, message);
+    return;
+  }
+  httpd_sess_trigger_close(ctx->req->handle, httpd_req_to_sockfd(ctx->req));
+}
+
+// Sert un fichier depuis le cache local, plage comprise
+static bool serve_cached_content(FileTransferContext *ctx, const CachedContent &content) {
+  int64_t size = content.size;
+  int64_t start = 0;
+  int64_t end = size - 1;
+  const char *status = "200 OK";
+  const char *content_range = nullptr;
+
+  int range_status = ctx->range_header.empty() ? 0 : parse_range_header(ctx->range_header, size, start, end);
+  if (range_status < 0) {
+    snprintf(ctx->content_range, sizeof(ctx->content_range), "bytes */%lld", (long long)size);
+    return send_raw_headers(ctx, "416 Range Not Satisfiable", 0, ctx->content_range);
+  }
+  if (range_status > 0) {
+    status = "206 Partial Content";
+    snprintf(ctx->content_range, sizeof(ctx->content_range), "bytes %lld-%lld/%lld",
+             (long long)start, (long long)end, (long long)size);
+    content_range = ctx->content_range;
+  } else {
+    start = 0;
+    end = size - 1;
+  }
+
+  ESP_LOGI(TAG, "Servi depuis le cache: %s (%lld octets)", ctx->remote_path.c_str(), (long long)(end - start + 1));
+  ProxyMetrics &metrics = ctx->proxy->metrics();
+  bool sent = send_raw_headers(ctx, status, end - start + 1, content_range);
+  if (sent) {
+    record_first_byte(ctx);
+    sent = send_raw_body(ctx->req, content.data + start, end - start + 1);
+  }
+  if (!sent) {
+    metrics.count_error(ErrorCause::CLIENT_SEND);
+    metrics.transfers_failed.inc();
+    return false;
+  }
+  metrics.bytes_out.add(end - start + 1);
+  metrics.transfers_completed.inc();
+  return true;
+}
+
+// Validateurs HTTP dérivés de la taille et de la date du fichier
+static void set_validators(FileTransferContext *ctx, int64_t size, int64_t mtime) {
+  char etag[48];
+  snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)size, (unsigned long long)mtime);
+  ctx->etag = etag;
+
+  char date[40];
+  time_t t = (time_t)mtime;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  ctx->last_modified = date;
+}
+
+// Date HTTP "Sun, 06 Nov 1994 08:49:37 GMT" en secondes Unix, 0 si invalide
+static int64_t parse_http_date(const char *value) {
+  static const char *MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char month_name[4];
+  int day, year, hour, minute, second;
+  if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d", &day, month_name, &year, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+  const char *month_pos = strstr(MONTHS, month_name);
+  if (strlen(month_name) != 3 || !month_pos) {
+    return 0;
+  }
+  char stamp[24];
+  snprintf(stamp, sizeof(stamp), "%04d%02d%02d%02d%02d%02d", year, (int)(month_pos - MONTHS) / 3 + 1, day, hour,
+           minute, second);
+  return ListingParser::parse_ftp_timestamp(stamp);
+}
+
+// Évalue les en-têtes conditionnels d'après les validateurs de ctx (RFC 9110 §13.2.2):
+// If-None-Match prime sur If-Modified-Since
+static bool is_not_modified(const FileTransferContext *ctx, int64_t mtime) {
+  if (ctx->etag.empty()) {
+    return false;
+  }
+  if (!ctx->if_none_match.empty()) {
+    return ctx->if_none_match == "*" || ctx->if_none_match.find(ctx->etag) != std::string::npos;
+  }
+  int64_t since = parse_http_date(ctx->if_modified_since.c_str());
+  return since > 0 && mtime <= since;
+}
+
+// Statut HTTP d'un refus du serveur FTP lors d'un envoi (REST, STOR, APPE ou réponse finale)
+static const char *upload_status_for(int ftp_code) {
+  switch (ftp_code) {
+    case 421:  // Service indisponible
+    case 425:  // Canal de données impossible
+    case 426:  // Transfert interrompu
+    case 450:  // Fichier occupé
+      return "503 Service Unavailable";
+    case 452:  // Espace insuffisant
+    case 552:  // Quota dépassé
+      return "507 Insufficient Storage";
+    case 530:  // Non authentifié
+    case 532:
+    case 550:  // Accès refusé ou répertoire absent
+      return "403 Forbidden";
+    case 553:  // Nom de fichier refusé
+      return "400 Bad Request";
+    case 500:
+    case 501:
+    case 502:  // Commande non implémentée (REST, APPE)
+    case 504:
+      return "501 Not Implemented";
+    default:
+      return "502 Bad Gateway";
+  }
+}
+
+static std::string json_escape(const std::string &text) {
+  std::string out;
+  out.reserve(text.size());
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += (char)c;
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += (char)c;
+    }
+  }
+  return out;
+}
+
+// Valeur d'un champ d'un objet JSON plat, espaces tolérés autour de ':'. Les
+// chaînes sont rendues sans guillemets, les autres valeurs telles quelles.
+static bool json_field(const char *json, const char *key, std::string &value) {
+  std::string quoted = std::string("\"") + key + "\"";
+  for (const char *p = strstr(json, quoted.c_str()); p; p = strstr(p + 1, quoted.c_str())) {
+    const char *c = p + quoted.size();
+    while (isspace((unsigned char)*c)) c++;
+    if (*c != ':') {
+      continue;  // Clé trouvée dans une valeur
+    }
+    c++;
+    while (isspace((unsigned char)*c)) c++;
+    value.clear();
+    if (*c == '"') {
+      for (c++; *c && *c != '"'; c++) {
+        if (*c == '\\' && c[1]) c++;
+        value += *c;
+      }
+      return *c == '"';
+    }
+    while (*c && *c != ',' && *c != '}' && !isspace((unsigned char)*c)) value += *c++;
+    return !value.empty();
+  }
+  return false;
+}
+
+// Connexion au canal de données annoncé par une réponse 227 (rcvbuf: 0 pour la
+// valeur par défaut). Retourne le socket, ou -1 en cas d'échec.
+static int open_passive_data(const FtpReply &pasv, int rcvbuf) {
+  char ip_str[16];
+  uint16_t data_port = 0;
+  if (!pasv.passive_address(ip_str, sizeof(ip_str), data_port)) {
+    ESP_LOGE(TAG, "Réponse PASV incorrecte (%d): %s", pasv.code, pasv.text.c_str());
+    return -1;
+  }
+
+  int data_sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (data_sock < 0) {
+    ESP_LOGE(TAG, "Échec de création du socket de données: %d", errno);
+    return -1;
+  }
+  int flag = 1;
+  setsockopt(data_sock, SOL_SOCKET, SO_KEEPALIVE, &flag, sizeof(flag));
+  if (rcvbuf > 0) {
+    setsockopt(data_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+  struct timeval data_timeout = {.tv_sec = FTP_DATA_TIMEOUT_S, .tv_usec = 0};
+  setsockopt(data_sock, SOL_SOCKET, SO_RCVTIMEO, &data_timeout, sizeof(data_timeout));
+  setsockopt(data_sock, SOL_SOCKET, SO_SNDTIMEO, &data_timeout, sizeof(data_timeout));
+
+  struct sockaddr_in data_addr;
+  memset(&data_addr, 0, sizeof(data_addr));
+  data_addr.sin_family = AF_INET;
+  data_addr.sin_port = htons(data_port);
+  data_addr.sin_addr.s_addr = inet_addr(ip_str);
+  if (connect(data_sock, (struct sockaddr *)&data_addr, sizeof(data_addr)) != 0) {
+    ESP_LOGE(TAG, "Échec de connexion au port de données: %d", errno);
+    close(data_sock);
+    return -1;
+  }
+  return data_sock;
+}
+
+static void send_not_modified(FileTransferContext *ctx) {
+  ESP_LOGI(TAG, "Non modifié, 304 pour %s", ctx->remote_path.c_str());
+  ctx->proxy->metrics().not_modified.inc();
+  httpd_resp_set_status(ctx->req, "304 Not Modified");
+  httpd_resp_set_hdr(ctx->req, "ETag", ctx->etag.c_str());
+  httpd_resp_set_hdr(ctx->req, "Last-Modified", ctx->last_modified.c_str());
+  httpd_resp_send(ctx->req, NULL, 0);
+}
+
+// Émetteur JSON d'un listing en réponse chunked: chaque entrée est écrite dès
+// qu'elle est connue, via un bloc de travail vidé par httpd_resp_send_chunk
+class ListingJsonWriter {
+ public:
+  ListingJsonWriter(httpd_req_t *req, const std::string &dir_path, uint8_t *buf, size_t size)
+      : req_(req), dir_path_(dir_path), buf_((char *)buf), size_(size) {}
+
+  bool started() const { return started_; }
+
+  bool write(const ListingEntry &entry, bool shareable) {
+    if (failed_) return false;
+    if (!started_) {
+      httpd_resp_set_type(req_, "application/json");
+      started_ = true;
+      append("[");
+    } else {
+      append(",");
+    }
+    append("{\"name\":\"");
+    append_escaped(entry.name);
+    append("\",\"path\":\"");
+    if (!dir_path_.empty()) {
+      append_escaped(dir_path_);
+      append("/");
+    }
+    append_escaped(entry.name);
+    char tail[96];
+    snprintf(tail, sizeof(tail), "\",\"type\":\"%s\",\"size\":%llu,\"shareable\":%s",
+             entry.is_dir ? "directory" : "file", (unsigned long long)entry.size,
+             (shareable && !entry.is_dir) ? "true" : "false");
+    append(tail);
+    if (entry.mtime > 0) {
+      snprintf(tail, sizeof(tail), ",\"modified\":%lld", (long long)entry.mtime);
+      append(tail);
+    }
+    append("}");
+    return !failed_;
+  }
+
+  bool finish() {
+    if (!started_) {
+      httpd_resp_set_type(req_, "application/json");
+      started_ = true;
+      append("[");
+    }
+    append("]");
+    flush();
+    if (!failed_) {
+      failed_ = httpd_resp_send_chunk(req_, NULL, 0) != ESP_OK;
+    }
+    return !failed_;
+  }
+
+ private:
+  void append(const char *text) {
+    while (*text) {
+      if (len_ == size_) flush();
+      buf_[len_++] = *text++;
+    }
+  }
+
+  void append_escaped(const std::string &text) {
+    for (unsigned char c : text) {
+      if (c == '"' || c == '\\') {
+        char escaped[3] = {'\\', (char)c, '\0'};
+        append(escaped);
+      } else if (c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        append(escaped);
+      } else {
+        char plain[2] = {(char)c, '\0'};
+        append(plain);
+      }
+    }
+  }
+
+  void flush() {
+    if (len_ > 0 && !failed_) {
+      failed_ = httpd_resp_send_chunk(req_, buf_, len_) != ESP_OK;
+    }
+    len_ = 0;
+  }
+
+  httpd_req_t *req_;
+  const std::string &dir_path_;
+  char *buf_;
+  size_t size_;
+  size_t len_{0};
+  bool started_{false};
+  bool failed_{false};
+};
+
+void FileTransferContext::reset() {
+  proxy = nullptr;
+  req = nullptr;
+  remote_path.clear();
+  range_header.clear();
+  content_range[0] = '\0';
+  content_disposition.clear();
+  resume_offset = -1;
+  headers_sent = false;
+  raw_body = false;
+  accepted_at = 0;
+  if_none_match.clear();
+  if_modified_since.clear();
+  etag.clear();
+  last_modified.clear();
+  upload = false;
+  append = false;
+  upload_offset = 0;
+  upload_boundary.clear();
+}
+
 void FTPHTTPProxy::setup() {
   ESP_LOGI(TAG, "Initialisation du proxy FTP/HTTP avec ESP-IDF 5.1.5");
+
+  ftp_pool_.resize(ftp_pool_size_);
+  ftp_pool_mutex_ = xSemaphoreCreateMutex();
+  ftp_pool_slots_ = xSemaphoreCreateCounting(ftp_pool_size_, ftp_pool_size_);
+  shares_mutex_ = xSemaphoreCreateMutex();
+  file_metadata_mutex_ = xSemaphoreCreateMutex();
+  shared_downloads_mutex_ = xSemaphoreCreateMutex();
+  uploads_mutex_ = xSemaphoreCreateMutex();
+  if (!ftp_pool_mutex_ || !ftp_pool_slots_ || !shares_mutex_ || !file_metadata_mutex_ || !shared_downloads_mutex_ ||
+      !uploads_mutex_) {
+    ESP_LOGE(TAG, "Échec de création des verrous du pool FTP");
+    this->mark_failed();
+    return;
+  }
+  file_metadata_.set_max_entries(file_metadata_size_);
+  this->restore_persistent_state();
+
+  follower_sink_.begin = [](FileTransferContext *ctx, int64_t content_length) {
+    ctx->raw_body = true;
+    ctx->headers_sent = send_raw_headers(ctx, "200 OK", content_length, nullptr);
+    return ctx->headers_sent;
+  };
+  follower_sink_.send = [this](FileTransferContext *ctx, const uint8_t *data, size_t len) {
+    // Un seul envoi sans attente: un client lent ne retient ni le meneur ni les autres
+    int sent = send(httpd_req_to_sockfd(ctx->req), data, len, MSG_DONTWAIT);
+    if (sent < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    if (sent > 0) {
+      record_first_byte(ctx);
+      metrics_.bytes_out.add(sent);
+    }
+    return sent;
+  };
+  follower_sink_.detach = [this](FileTransferContext *ctx, size_t offset) {
+    this->resume_detached_transfer(ctx, offset);
+  };
+  follower_sink_.finish = [this](FileTransferContext *ctx, bool complete) {
+    if (!complete) {
+      metrics_.count_error(ErrorCause::CLIENT_SEND);
+      metrics_.transfers_failed.inc();
+      httpd_sess_trigger_close(ctx->req->handle, httpd_req_to_sockfd(ctx->req));
+    } else {
+      metrics_.transfers_completed.inc();
+      if (!ctx->raw_body) {
+        httpd_resp_send_chunk(ctx->req, NULL, 0);
+      }
+    }
+    httpd_req_async_handler_complete(ctx->req);
+    contexts_.release(ctx);
+  };
+
+  this->init_memory_pools();
+  if (!this->start_transfer_workers()) {
+    this->mark_failed();
+    return;
+  }
+  if (event_loop_streams_ > 0 && !this->start_event_loop()) {
+    this->mark_failed();
+    return;
+  }
+
+  listing_refresh_queue_ = xQueueCreate(4, sizeof(std::string*));
+  if (!listing_cache_.init(listing_cache_size_, LISTING_CACHE_MAX_ENTRIES, listing_cache_ttl_,
+                           listing_cache_ttl_ * LISTING_STALE_FACTOR) ||
+      !listing_refresh_queue_ ||
+      xTaskCreate(listing_refresh_task, "listing_refresh", 6144, this, tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Échec d'initialisation du cache des listings");
+    this->mark_failed();
+    return;
+  }
+
+  if (!content_cache_.init(content_cache_size_, content_cache_max_file_)) {
+    ESP_LOGE(TAG, "Échec d'initialisation du cache de contenu");
+    this->mark_failed();
+    return;
+  }
+  if (content_cache_.enabled()) {
+    ESP_LOGI(TAG, "Cache de contenu: %u Ko, fichiers jusqu'à %u Ko", (unsigned)(content_cache_size_ / 1024),
+             (unsigned)(content_cache_max_file_ / 1024));
+  }
+
   delayed_setup_ = true;
 }
 
@@ -39,68 +651,278 @@ void FTPHTTPProxy::loop() {
     if (startup_counter >= 5) {
       delayed_setup_ = false;
       this->setup_http_server();
+
+      // Préchauffer le pool de connexions FTP sans bloquer la boucle principale
+      xTaskCreate(ftp_pool_warm_task, "ftp_pool_warm", 4096, this, tskIDLE_PRIORITY + 1, NULL);
+    }
+    return;
+  }
+
+  int64_t now_us = esp_timer_get_time();
+  if (now_us - last_memory_sample_ >= MEMORY_SAMPLE_US) {
+    last_memory_sample_ = now_us;
+    this->sample_memory();
+  }
+
+  if (now_us - last_pool_maintenance_ >= FTP_POOL_MAINTENANCE_US) {
+    last_pool_maintenance_ = now_us;
+    this->maintain_ftp_pool();
+  }
+
+  // Supprimer les liens de partage expirés, seulement quand une échéance est atteinte
+  int64_t now = now_us / 1000000;
+  if (now > next_share_expiry_.load(std::memory_order_relaxed)) {
+    xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+    size_t expired = active_shares_.expire(now);
+    next_share_expiry_.store(active_shares_.next_expiry());
+    xSemaphoreGive(shares_mutex_);
+    ESP_LOGD(TAG, "%u lien(s) de partage expiré(s)", (unsigned)expired);
+  }
+
+  if (now_us - last_persist_flush_ >= PERSIST_FLUSH_US) {
+    last_persist_flush_ = now_us;
+    if (!restored_shares_.empty()) {
+      this->activate_restored_shares();
     }
+    this->persist_state();
+  }
+}
+
+// Heure Unix courante, 0 tant que l'horloge n'a pas été synchronisée
+static int64_t wall_clock_now() {
+  time_t now = time(nullptr);
+  return now >= WALL_CLOCK_VALID_AFTER ? (int64_t)now : 0;
+}
+
+void FTPHTTPProxy::restore_persistent_state() {
+  if (!persistent_store_.open(persist_partition_.c_str(), PERSIST_NAMESPACE)) {
+    ESP_LOGW(TAG, "Persistance indisponible: partages conservés en RAM uniquement");
     return;
   }
 
-  // Supprimer les liens de partage expirés
+  int64_t start = esp_timer_get_time();
+  std::unordered_map<std::string, ShareLink> shares;
+  size_t flags = 0;
+  persistent_store_.load([&](const PersistRecord &record) {
+    if (record.type == PersistRecord::SHARE) {
+      shares[record.token] = ShareLink{record.path, record.token, record.expiry};
+    } else {
+      file_metadata_.set_shareable(FileMetadataStore::normalize_path(record.path), record.shareable);
+      flags++;
+    }
+  });
+
+  restored_shares_.reserve(shares.size());
+  for (auto &share : shares) {
+    restored_shares_.push_back(std::move(share.second));
+  }
+  ESP_LOGI(TAG, "État restauré en %lld ms: %u partage(s), %u statut(s) de partage",
+           (long long)((esp_timer_get_time() - start) / 1000), (unsigned)restored_shares_.size(),
+           (unsigned)flags);
+  this->activate_restored_shares();
+}
+
+void FTPHTTPProxy::activate_restored_shares() {
+  // Les échéances sont en heure Unix: impossible de les convertir avant la synchronisation
+  int64_t wall = wall_clock_now();
+  if (!wall) {
+    return;
+  }
   int64_t now = esp_timer_get_time() / 1000000;
-  active_shares_.erase(
-    std::remove_if(
-      active_shares_.begin(), 
-      active_shares_.end(),
-      [now](const ShareLink& link) { return link.expiry < now; }
-    ),
-    active_shares_.end()
-  );
+  size_t active = 0;
+  xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+  for (const auto &share : restored_shares_) {
+    if (share.expiry > wall && active_shares_.add(share.path, share.token, now + (share.expiry - wall))) {
+      active++;
+    }
+  }
+  next_share_expiry_.store(active_shares_.next_expiry());
+  xSemaphoreGive(shares_mutex_);
+  ESP_LOGI(TAG, "%u lien(s) de partage réactivé(s), %u expiré(s)", (unsigned)active,
+           (unsigned)(restored_shares_.size() - active));
+  std::vector<ShareLink>().swap(restored_shares_);
 }
 
-bool FTPHTTPProxy::is_shareable(const std::string &path) {
-  for (const auto &file : ftp_files_) {
-    if (file.path == path) {
-      return file.shareable;
+void FTPHTTPProxy::persist_state() {
+  if (!persistent_store_.is_open()) {
+    return;
+  }
+  // Un flush en échec garde ses modifications et demande la compaction ci-dessous
+  if (persistent_store_.has_pending()) {
+    persistent_store_.flush();
+  }
+  // Les partages non encore réactivés doivent survivre à la compaction: on attend
+  int64_t wall = wall_clock_now();
+  if (!persistent_store_.needs_compaction() || !wall || !restored_shares_.empty()) {
+    return;
+  }
+
+  int64_t now = esp_timer_get_time() / 1000000;
+  persistent_store_.compact([&](PersistEncoder &encoder) {
+    xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+    active_shares_.for_each([&](const ShareLink &share) {
+      if (share.expiry > now) {
+        encoder.add_share(share.path, share.token, wall + (share.expiry - now));
+      }
+    });
+    xSemaphoreGive(shares_mutex_);
+
+    xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+    file_metadata_.for_each_shareable([&](const std::string &path, const FileMetadata &) {
+      encoder.add_shareable(path, true);
+    });
+    xSemaphoreGive(file_metadata_mutex_);
+  });
+}
+
+bool FTPHTTPProxy::persisted_state_fits(const std::string &share_path, const std::string &flag_path) {
+  if (!persistent_store_.is_open()) {
+    return true;
+  }
+  // Même parcours que la compaction, avec le partage ou le statut à ajouter
+  PersistSizer sizer(PersistentStore::CHUNK_SIZE);
+  int64_t now = esp_timer_get_time() / 1000000;
+  xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+  active_shares_.for_each([&](const ShareLink &share) {
+    if (share.expiry > now) {
+      sizer.add_share(share.path, share.token);
     }
+  });
+  xSemaphoreGive(shares_mutex_);
+  if (!share_path.empty()) {
+    sizer.add_share(share_path, std::string(SHARE_TOKEN_LEN, '0'));
   }
-  return false;
+
+  xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+  file_metadata_.for_each_shareable([&](const std::string &path, const FileMetadata &) {
+    sizer.add_shareable(path);
+  });
+  xSemaphoreGive(file_metadata_mutex_);
+  if (!flag_path.empty()) {
+    sizer.add_shareable(flag_path);
+  }
+  return persistent_store_.fits(sizer);
+}
+
+bool FTPHTTPProxy::is_shareable(const std::string &path) {
+  std::string key = FileMetadataStore::normalize_path(path);
+  xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+  bool shareable = file_metadata_.is_shareable(key);
+  xSemaphoreGive(file_metadata_mutex_);
+  return shareable;
+}
+
+bool FTPHTTPProxy::set_shareable(const std::string &path, bool shareable) {
+  std::string key = FileMetadataStore::normalize_path(path);
+  if (shareable && !is_shareable(key) && !persisted_state_fits("", key)) {
+    ESP_LOGW(TAG, "Partition de persistance pleine, statut refusé: %s", key.c_str());
+    return false;
+  }
+  xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+  file_metadata_.set_shareable(key, shareable);
+  xSemaphoreGive(file_metadata_mutex_);
+  persistent_store_.record_shareable(key, shareable);
+  return true;
+}
+
+bool FTPHTTPProxy::get_file_metadata(const std::string &path, FileMetadata &meta) {
+  std::string key = FileMetadataStore::normalize_path(path);
+  xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+  bool found = file_metadata_.get(key, meta);
+  xSemaphoreGive(file_metadata_mutex_);
+  return found;
 }
 
-void FTPHTTPProxy::create_share_link(const std::string &path, int expiry_hours) {
+void FTPHTTPProxy::record_file_metadata(const std::string &remote_dir, const ListingEntry &entry) {
+  if (entry.is_dir) {
+    return;
+  }
+  std::string key = FileMetadataStore::normalize_path(remote_dir + "/" + entry.name);
+  xSemaphoreTake(file_metadata_mutex_, portMAX_DELAY);
+  file_metadata_.update_stat(key, entry.size, entry.mtime, entry.exact_mtime, entry.unique, esp_timer_get_time());
+  xSemaphoreGive(file_metadata_mutex_);
+}
+
+std::string FTPHTTPProxy::create_share_link(const std::string &path, int expiry_hours) {
   if (!is_shareable(path)) {
     ESP_LOGW(TAG, "Tentative de partage d'un fichier non partageable: %s", path.c_str());
-    return;
+    return "";
+  }
+  if (!persisted_state_fits(path, "")) {
+    ESP_LOGW(TAG, "Partition de persistance pleine, partage refusé: %s", path.c_str());
+    return "";
   }
   
-  // Générer un token aléatoire
-  uint32_t random_value = esp_random();
-  char token[16];
-  snprintf(token, sizeof(token), "%08x", random_value);
-  
-  ShareLink share;
-  share.path = path;
-  share.token = token;
-  share.expiry = (esp_timer_get_time() / 1000000) + (expiry_hours * 3600);
-  
-  active_shares_.push_back(share);
+  int64_t expiry = (esp_timer_get_time() / 1000000) + (expiry_hours * 3600);
+  char token[SHARE_TOKEN_LEN + 1];
+
+  xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+  // Générer un token aléatoire, unique parmi les partages actifs
+  do {
+    snprintf(token, sizeof(token), "%08x", (unsigned)esp_random());
+  } while (!active_shares_.add(path, token, expiry));
+  next_share_expiry_.store(active_shares_.next_expiry());
+  xSemaphoreGive(shares_mutex_);
+
+  // Persisté en heure Unix: l'horloge de démarrage repart de zéro à chaque reboot
+  int64_t wall = wall_clock_now();
+  if (wall) {
+    persistent_store_.record_share(path, token, wall + (expiry_hours * 3600));
+  } else {
+    ESP_LOGW(TAG, "Horloge non synchronisée: le lien %s ne survivra pas à un redémarrage", token);
+  }
   
   ESP_LOGI(TAG, "Lien de partage créé pour %s: token=%s, expire dans %d heures", 
            path.c_str(), token, expiry_hours);
+  return token;
 }
 
-bool FTPHTTPProxy::connect_to_ftp(int& sock, const char* server, const char* username, const char* password) {
+bool FTPHTTPProxy::find_share(const std::string &token, ShareLink &share) {
+  int64_t now = esp_timer_get_time() / 1000000;
+  xSemaphoreTake(shares_mutex_, portMAX_DELAY);
+  bool found = active_shares_.find(token, now, share);
+  xSemaphoreGive(shares_mutex_);
+  return found;
+}
+
+bool FTPHTTPProxy::connect_to_ftp(FtpClient &ftp, const char* server, const char* username, const char* password) {
   if (!server || !username || !password) {
     ESP_LOGE(TAG, "Paramètres FTP invalides");
     return false;
   }
 
-  // Résolution DNS
-  struct hostent *ftp_host = gethostbyname(server);
-  if (!ftp_host) {
-    ESP_LOGE(TAG, "Échec de la résolution DNS pour %s: %d", server, h_errno);
+  // "hôte:port" pour un serveur hors du port standard
+  std::string host = server;
+  uint16_t port = 21;
+  size_t colon = host.rfind(':');
+  if (colon != std::string::npos && host.find(':') == colon) {
+    port = (uint16_t)atoi(host.c_str() + colon + 1);
+    host.resize(colon);
+    if (port == 0) {
+      ESP_LOGE(TAG, "Port FTP invalide: %s", server);
+      return false;
+    }
+  }
+
+  // Résolution DNS: getaddrinfo() et non gethostbyname(), dont le résultat statique
+  // est partagé par les workers et les segments qui ouvrent des sessions en parallèle
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *ftp_host = nullptr;
+  int gai_err = getaddrinfo(host.c_str(), nullptr, &hints, &ftp_host);
+  if (gai_err != 0 || !ftp_host) {
+    ESP_LOGE(TAG, "Échec de la résolution DNS pour %s: %d", host.c_str(), gai_err);
     return false;
   }
+  struct sockaddr_in server_addr;
+  memcpy(&server_addr, ftp_host->ai_addr, sizeof(server_addr));
+  server_addr.sin_port = htons(port);
+  freeaddrinfo(ftp_host);
 
   // Création du socket
-  sock = socket(AF_INET, SOCK_STREAM, 0);
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
   if (sock < 0) {
     ESP_LOGE(TAG, "Échec de création du socket : %d", errno);
     return false;
@@ -127,651 +949,2060 @@ bool FTPHTTPProxy::connect_to_ftp(int& sock, const char* server, const char* use
   }
 
   // Connexion au serveur FTP
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(21);  // Port FTP standard
-  
-  // S'assurer que l'adresse est correctement assignée
-  if (ftp_host->h_addrtype == AF_INET && ftp_host->h_addr_list[0] != NULL) {
-    memcpy(&server_addr.sin_addr, ftp_host->h_addr_list[0], sizeof(struct in_addr));
-  } else {
-    ESP_LOGE(TAG, "Format d'adresse hôte non pris en charge");
-    close(sock);
-    sock = -1;
-    return false;
-  }
-
   if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
     ESP_LOGE(TAG, "Échec de connexion FTP à %s : %d", server, errno);
     close(sock);
-    sock = -1;
     return false;
   }
 
-  // Réception du message de bienvenue
-  char buffer[512];
-  int bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received <= 0) {
-    ESP_LOGE(TAG, "Pas de réponse du serveur FTP: %d", errno);
+  // Message de bienvenue, puis USER, PASS et TYPE I envoyés d'un seul tenant:
+  // l'ouverture de session ne coûte plus qu'un aller-retour
+  // Le client reste attaché à la session: les octets reçus au-delà des réponses
+  // de connexion sont gardés pour la commande suivante
+  ftp.attach(sock);
+  FtpReply reply = ftp.read_reply();
+  if (!reply.is(FtpReply::SERVICE_READY)) {
+    ESP_LOGE(TAG, "Message de bienvenue FTP non reconnu (%d): %s", reply.code, reply.text.c_str());
     close(sock);
-    sock = -1;
+    ftp.attach(-1);
     return false;
   }
-  
-  buffer[bytes_received] = '\0';
-  if (!strstr(buffer, "220 ")) {
-    ESP_LOGE(TAG, "Message de bienvenue FTP non reconnu: %s", buffer);
+
+  ftp.queue("USER %s", username);
+  ftp.queue("PASS %s", password);
+  ftp.queue("TYPE I");
+  if (!ftp.flush()) {
+    ESP_LOGE(TAG, "Échec d'envoi des commandes d'authentification: %d", errno);
     close(sock);
-    sock = -1;
+    ftp.attach(-1);
     return false;
   }
 
-  // Envoi du nom d'utilisateur
-  snprintf(buffer, sizeof(buffer), "USER %s\r\n", username);
-  if (send(sock, buffer, strlen(buffer), 0) <= 0) {
-    ESP_LOGE(TAG, "Échec d'envoi de la commande USER: %d", errno);
+  // Les trois réponses sont lues dans l'ordre, même en cas d'échec, pour que le
+  // diagnostic porte sur la bonne commande
+  FtpReply user_reply = ftp.read_reply();
+  FtpReply pass_reply = user_reply.valid() ? ftp.read_reply() : FtpReply();
+  FtpReply type_reply = pass_reply.valid() ? ftp.read_reply() : FtpReply();
+
+  if (user_reply.is(FtpReply::LOGGED_IN)) {
+    // Certains serveurs acceptent directement l'utilisateur: PASS est alors refusé sans conséquence
+    ESP_LOGI(TAG, "Authentification FTP réussie sans mot de passe");
+  } else if (!user_reply.is(FtpReply::NEED_PASSWORD)) {
+    ESP_LOGE(TAG, "Réponse USER inattendue (%d): %s", user_reply.code, user_reply.text.c_str());
     close(sock);
-    sock = -1;
+    ftp.attach(-1);
     return false;
-  }
-  
-  bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received <= 0) {
-    ESP_LOGE(TAG, "Pas de réponse à la commande USER: %d", errno);
+  } else if (!pass_reply.is(FtpReply::LOGGED_IN)) {
+    ESP_LOGE(TAG, "Authentification FTP échouée (%d): %s", pass_reply.code, pass_reply.text.c_str());
     close(sock);
-    sock = -1;
+    ftp.attach(-1);
     return false;
   }
-  buffer[bytes_received] = '\0';
-  
-  // Certains serveurs peuvent directement accepter l'utilisateur sans mot de passe
-  if (strstr(buffer, "230 ")) {
-    // Déjà authentifié
-    ESP_LOGI(TAG, "Authentification FTP réussie sans mot de passe");
-  } else if (!strstr(buffer, "331 ")) {
-    ESP_LOGE(TAG, "Réponse USER inattendue: %s", buffer);
+
+  if (!type_reply.is(FtpReply::COMMAND_OK)) {
+    ESP_LOGE(TAG, "Échec du passage en mode binaire (%d): %s", type_reply.code, type_reply.text.c_str());
     close(sock);
-    sock = -1;
+    ftp.attach(-1);
     return false;
-  } else {
-    // Envoi du mot de passe
-    snprintf(buffer, sizeof(buffer), "PASS %s\r\n", password);
-    if (send(sock, buffer, strlen(buffer), 0) <= 0) {
-      ESP_LOGE(TAG, "Échec d'envoi de la commande PASS: %d", errno);
-      close(sock);
-      sock = -1;
-      return false;
-    }
-    
-    bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-    if (bytes_received <= 0) {
-      ESP_LOGE(TAG, "Pas de réponse à la commande PASS: %d", errno);
-      close(sock);
-      sock = -1;
-      return false;
+  }
+
+  ESP_LOGI(TAG, "Connexion FTP établie avec succès");
+  return true;
+}
+
+bool FTPHTTPProxy::drain_ftp_replies(PooledConnection &conn) {
+  // Lire sans bloquer les réponses en attente (NOOP de maintien, 421 du serveur...)
+  FtpReply reply;
+  while (true) {
+    FtpClient::Poll poll = conn.ftp.poll_reply(reply);
+    if (poll == FtpClient::Poll::PENDING) {
+      return true;
     }
-    buffer[bytes_received] = '\0';
-    
-    if (!strstr(buffer, "230 ")) {
-      ESP_LOGE(TAG, "Authentification FTP échouée: %s", buffer);
-      close(sock);
-      sock = -1;
+    if (poll == FtpClient::Poll::CLOSED) {
+      return false;  // Connexion fermée par le serveur
+    }
+    if (!reply.completion()) {
+      ESP_LOGD(TAG, "Connexion FTP du pool invalidée (%d): %s", reply.code, reply.text.c_str());
       return false;
     }
+    conn.noop_pending = false;
   }
+}
 
-  // Passage en mode binaire
-  if (send(sock, "TYPE I\r\n", 8, 0) <= 0) {
-    ESP_LOGE(TAG, "Échec d'envoi de la commande TYPE I: %d", errno);
-    close(sock);
-    sock = -1;
-    return false;
+FtpClient *FTPHTTPProxy::acquire_ftp_connection(bool wait) {
+  // Le sémaphore borne le nombre de sessions ouvertes vers le serveur FTP
+  if (xSemaphoreTake(ftp_pool_slots_, wait ? pdMS_TO_TICKS(FTP_POOL_ACQUIRE_TIMEOUT_MS) : 0) != pdTRUE) {
+    if (wait) {
+      ESP_LOGW(TAG, "Aucune connexion FTP disponible dans le pool");
+    }
+    return nullptr;
   }
-  
-  bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received <= 0 || !strstr(buffer, "200 ")) {
-    ESP_LOGE(TAG, "Échec du passage en mode binaire: %s", buffer);
-    close(sock);
-    sock = -1;
-    return false;
+
+  xSemaphoreTake(ftp_pool_mutex_, portMAX_DELAY);
+  PooledConnection *slot = nullptr;
+  // Préférer une connexion déjà authentifiée
+  for (auto &conn : ftp_pool_) {
+    if (!conn.in_use && conn.ftp.sock() >= 0) {
+      slot = &conn;
+      break;
+    }
+  }
+  if (!slot) {
+    for (auto &conn : ftp_pool_) {
+      if (!conn.in_use) {
+        slot = &conn;
+        break;
+      }
+    }
   }
+  slot->in_use = true;
+  xSemaphoreGive(ftp_pool_mutex_);
 
-  ESP_LOGI(TAG, "Connexion FTP établie avec succès");
-  return true;
+  // Vérifier l'état de la connexion avant de la prêter
+  if (slot->ftp.sock() >= 0) {
+    bool healthy = drain_ftp_replies(*slot);
+    if (healthy && slot->noop_pending) {
+      healthy = slot->ftp.read_reply().completion();
+      slot->noop_pending = false;
+    }
+    if (!healthy) {
+      ESP_LOGI(TAG, "Connexion FTP du pool expirée, reconnexion");
+      close(slot->ftp.sock());
+      slot->ftp.attach(-1);
+    }
+  }
+
+  if (slot->ftp.sock() < 0) {
+    int64_t login_start = esp_timer_get_time();
+    if (!connect_to_ftp(slot->ftp, ftp_server_.c_str(), username_.c_str(), password_.c_str())) {
+      xSemaphoreTake(ftp_pool_mutex_, portMAX_DELAY);
+      slot->in_use = false;
+      xSemaphoreGive(ftp_pool_mutex_);
+      xSemaphoreGive(ftp_pool_slots_);
+      return nullptr;
+    }
+    metrics_.ftp_login_ms.record(elapsed_ms(login_start));
+  }
+
+  slot->last_used = esp_timer_get_time();
+  return &slot->ftp;
 }
 
-void FTPHTTPProxy::file_transfer_task(void* param) {
-  FileTransferContext* ctx = (FileTransferContext*)param;
-  if (!ctx) {
-    ESP_LOGE(TAG, "Contexte de transfert invalide");
-    vTaskDelete(NULL);
+void FTPHTTPProxy::release_ftp_connection(FtpClient *ftp, bool reusable) {
+  if (!ftp) {
     return;
   }
-  
-  // S'inscrire au watchdog
-  ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_add(NULL));
-  
-  ESP_LOGI(TAG, "Démarrage du transfert pour %s", ctx->remote_path.c_str());
-  
-  FTPHTTPProxy proxy_instance;
-  int ftp_sock = -1;
-  int data_sock = -1;
-  bool success = false;
-  int bytes_received = 0;
 
-  // Taille du buffer de transfert
-  const int buffer_size = 16384;
-  
-  // Allocation plus sûre avec gestion d'erreur
-  char* buffer = nullptr;
-  
-  // Tenter d'abord d'allouer en SPIRAM si disponible
-  buffer = (char*)heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-  
-  // Si l'allocation SPIRAM échoue, essayer la mémoire interne
-  if (!buffer) {
-    buffer = (char*)heap_caps_malloc(buffer_size, MALLOC_CAP_8BIT);
-    
-    // Si toutes les allocations échouent, abandonner proprement
-    if (!buffer) {
-      ESP_LOGE(TAG, "Échec d'allocation pour le buffer de transfert");
-      httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur mémoire");
-      delete ctx;
-      ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-      vTaskDelete(NULL);
-      return;
+  xSemaphoreTake(ftp_pool_mutex_, portMAX_DELAY);
+  for (auto &conn : ftp_pool_) {
+    if (conn.in_use && &conn.ftp == ftp) {
+      // Une session dans un état incertain (transfert interrompu...) n'est pas réutilisée
+      if (!reusable && ftp->sock() >= 0) {
+        send(ftp->sock(), "QUIT\r\n", 6, 0);
+        close(ftp->sock());
+        ftp->attach(-1);
+      }
+      conn.in_use = false;
+      conn.noop_pending = false;
+      conn.last_used = esp_timer_get_time();
+      break;
     }
   }
+  xSemaphoreGive(ftp_pool_mutex_);
+  xSemaphoreGive(ftp_pool_slots_);
+}
 
-  // Vérifier la validité du chemin de fichier
-  if (ctx->remote_path.empty()) {
-    ESP_LOGE(TAG, "Chemin de fichier distant vide");
-    free(buffer);
-    httpd_resp_send_err(ctx->req, HTTPD_404_NOT_FOUND, "Fichier non spécifié");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
+void FTPHTTPProxy::maintain_ftp_pool() {
+  if (!ftp_pool_mutex_ || xSemaphoreTake(ftp_pool_mutex_, 0) != pdTRUE) {
     return;
   }
 
-  // Vérifier que la connexion FTP est réussie
-  if (!proxy_instance.connect_to_ftp(ftp_sock, ctx->ftp_server.c_str(), ctx->username.c_str(), ctx->password.c_str())) {
-    ESP_LOGE(TAG, "Échec de connexion FTP");
-    free(buffer);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de connexion au serveur FTP");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
-  }
+  int64_t now = esp_timer_get_time();
+  for (auto &conn : ftp_pool_) {
+    if (conn.in_use || conn.ftp.sock() < 0) {
+      continue;
+    }
 
-  // Définition du type MIME en fonction de l'extension
-  std::string extension;
-  size_t dot_pos = ctx->remote_path.find_last_of('.');
-  if (dot_pos != std::string::npos) {
-    extension = ctx->remote_path.substr(dot_pos);
-    std::transform(extension.begin(), extension.end(), extension.begin(), 
-                  [](unsigned char c){ return std::tolower(c); });
-  }
+    if (!drain_ftp_replies(conn)) {
+      ESP_LOGI(TAG, "Fermeture d'une connexion FTP inactive invalide");
+      close(conn.ftp.sock());
+      conn.ftp.attach(-1);
+      conn.noop_pending = false;
+      continue;
+    }
 
-  if (extension == ".mp3") {
-    httpd_resp_set_type(ctx->req, "audio/mpeg");
-  } else if (extension == ".wav") {
-    httpd_resp_set_type(ctx->req, "audio/wav");
-  } else if (extension == ".ogg") {
-    httpd_resp_set_type(ctx->req, "audio/ogg");
-  } else if (extension == ".flac") {
-    httpd_resp_set_type(ctx->req, "audio/flac");
-  } else if (extension == ".mp4") {
-    httpd_resp_set_type(ctx->req, "video/mp4");
-  } else if (extension == ".pdf") {
-    httpd_resp_set_type(ctx->req, "application/pdf");
-  } else if (extension == ".jpg" || extension == ".jpeg") {
-    httpd_resp_set_type(ctx->req, "image/jpeg");
-  } else if (extension == ".png") {
-    httpd_resp_set_type(ctx->req, "image/png");
-  } else {
-    // Forcer le téléchargement pour les types inconnus
-    httpd_resp_set_type(ctx->req, "application/octet-stream");
-    std::string filename = ctx->remote_path;
-    size_t slash_pos = ctx->remote_path.find_last_of('/');
-    if (slash_pos != std::string::npos) {
-      filename = ctx->remote_path.substr(slash_pos + 1);
+    // Maintenir la session ouverte; la réponse sera lue au prochain passage
+    if (!conn.noop_pending && now - conn.last_used >= FTP_POOL_KEEPALIVE_US) {
+      if (send(conn.ftp.sock(), "NOOP\r\n", 6, MSG_DONTWAIT) == 6) {
+        conn.noop_pending = true;
+        conn.last_used = now;
+      } else {
+        close(conn.ftp.sock());
+        conn.ftp.attach(-1);
+      }
     }
-    std::string header = "attachment; filename=\"" + filename + "\"";
-    httpd_resp_set_hdr(ctx->req, "Content-Disposition", header.c_str());
-  }
-  
-  // Activer explicitement le mode chunked pour les gros fichiers
-  httpd_resp_set_hdr(ctx->req, "Transfer-Encoding", "chunked");
-
-  // Passer en mode passif et récupérer les paramètres de connexion de données
-  if (send(ftp_sock, "PASV\r\n", 6, 0) <= 0) {
-    ESP_LOGE(TAG, "Échec d'envoi de la commande PASV: %d", errno);
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
   }
-  
-  bytes_received = recv(ftp_sock, buffer, buffer_size - 1, 0);
-  if (bytes_received <= 0) {
-    ESP_LOGE(TAG, "Erreur de réception en mode passif: %d", errno);
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+
+  xSemaphoreGive(ftp_pool_mutex_);
+}
+
+void FTPHTTPProxy::ftp_pool_warm_task(void* param) {
+  auto *proxy = (FTPHTTPProxy *)param;
+  std::vector<FtpClient *> sessions;
+
+  // Ouvrir toutes les sessions du pool puis les rendre immédiatement
+  for (int i = 0; i < proxy->ftp_pool_size_; i++) {
+    FtpClient *ftp = proxy->acquire_ftp_connection();
+    if (!ftp) {
+      break;
+    }
+    sessions.push_back(ftp);
   }
-  
-  buffer[bytes_received] = '\0';
-  
-  if (!strstr(buffer, "227 ")) {
-    ESP_LOGE(TAG, "Réponse PASV incorrecte: %s", buffer);
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+  for (FtpClient *ftp : sessions) {
+    proxy->release_ftp_connection(ftp, true);
   }
 
-  // Analyse de la réponse PASV pour extraire l'adresse IP et le port
-  char *pasv_start = strchr(buffer, '(');
-  if (!pasv_start) {
-    ESP_LOGE(TAG, "Format PASV incorrect: parenthèse non trouvée");
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+  ESP_LOGI(TAG, "Pool FTP préchauffé: %d/%d connexions", (int)sessions.size(), proxy->ftp_pool_size_);
+  vTaskDelete(NULL);
+}
+
+// Mène un téléchargement partagé et le termine à la sortie du transfert, quelle qu'elle soit
+class FTPHTTPProxy::SharedDownloadLease {
+ public:
+  SharedDownloadLease(FTPHTTPProxy *proxy, SharedDownload *shared) : proxy_(proxy), shared_(shared) {}
+  ~SharedDownloadLease() {
+    if (shared_) {
+      proxy_->finish_shared_download(shared_, complete_);
+    }
   }
-  
-  int ip[4], port[2];
-  if (sscanf(pasv_start, "(%d,%d,%d,%d,%d,%d)", &ip[0], &ip[1], &ip[2], &ip[3], &port[0], &port[1]) != 6) {
-    ESP_LOGE(TAG, "Format PASV incorrect: impossible de parser les valeurs");
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+  SharedDownload *get() const { return shared_; }
+  void set_complete() { complete_ = true; }
+  // Abandon avant la fin: les clients rattachés repartent avec leur propre transfert
+  void cancel() {
+    if (shared_) {
+      proxy_->finish_shared_download(shared_, false);
+      shared_ = nullptr;
+    }
   }
-  
-  int data_port = port[0] * 256 + port[1];
-  
-  // Création du socket de données
-  data_sock = socket(AF_INET, SOCK_STREAM, 0);
-  if (data_sock < 0) {
-    ESP_LOGE(TAG, "Échec de création du socket de données: %d", errno);
-    free(buffer);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+
+ private:
+  FTPHTTPProxy *proxy_;
+  SharedDownload *shared_;
+  bool complete_{false};
+};
+
+// Téléchargement segmenté pour les gros fichiers derrière un lien à forte latence:
+// le contenu est découpé en blocs récupérés en parallèle sur plusieurs sessions du
+// pool (REST + RETR par bloc, RETR interrompu en fin de bloc) puis renvoyés dans
+// l'ordre. Chaque session n'a qu'un tampon d'un bloc, ce qui borne la mémoire de
+// réordonnancement à sessions × taille de bloc. Commandes de contrôle et données
+// sont menées par select() depuis la tâche du worker, sans appel bloquant.
+class FTPHTTPProxy::SegmentedTransfer {
+ public:
+  SegmentedTransfer(FileTransferContext *ctx, int64_t start, int64_t length)
+      : proxy_(ctx->proxy), ctx_(ctx), start_(start), length_(length) {}
+
+  ~SegmentedTransfer() {
+    for (auto &slot : slots_) {
+      if (slot.data >= 0) {
+        close(slot.data);
+      }
+      proxy_->release_ftp_connection(slot.ctrl, this->at_rest(slot));
+      proxy_->segment_buffers_.release(slot.buf);
+    }
   }
-  
-  // Configuration des options du socket de données
-  flag = 1;
-  if (setsockopt(data_sock, SOL_SOCKET, SO_KEEPALIVE, &flag, sizeof(flag)) < 0) {
-    ESP_LOGW(TAG, "Échec de configuration SO_KEEPALIVE pour data_sock: %d", errno);
+
+  // Sessions supplémentaires libres et blocs de la réserve (PSRAM); false: transfert
+  // ordinaire, ftp reste alors à l'appelant
+  bool prepare(FtpClient *ftp) {
+    block_size_ = proxy_->segment_size_;
+    block_count_ = (length_ + block_size_ - 1) / block_size_;
+    int wanted = (int)std::min<int64_t>(proxy_->segment_connections_, block_count_);
+    if (wanted < 2) {
+      return false;
+    }
+
+    slots_.resize(wanted);
+    for (auto &slot : slots_) {
+      slot.buf = (uint8_t *)proxy_->segment_buffers_.acquire_or_alloc();
+      if (!slot.buf) {
+        ESP_LOGW(TAG, "PSRAM insuffisante pour le téléchargement segmenté");
+        this->give_back();
+        return false;
+      }
+    }
+
+    // Sessions supplémentaires sans attendre: seules celles qui sont libres servent
+    slots_[0].ctrl = ftp;
+    for (size_t i = 1; i < slots_.size(); i++) {
+      slots_[i].ctrl = proxy_->acquire_ftp_connection(false);
+      if (!slots_[i].ctrl) {
+        for (size_t j = i; j < slots_.size(); j++) {
+          proxy_->segment_buffers_.release(slots_[j].buf);
+        }
+        slots_.resize(i);
+        break;
+      }
+    }
+    if (slots_.size() < 2) {
+      slots_[0].ctrl = nullptr;
+      this->give_back();
+      return false;
+    }
+    return true;
   }
-  
-  int rcvbuf = 32768;
-  if (setsockopt(data_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
-    ESP_LOGW(TAG, "Échec de configuration SO_RCVBUF pour data_sock: %d", errno);
+
+  // Mène le transfert et la réponse HTTP jusqu'au bout; true si tout a été envoyé
+  bool run(bool partial, SharedDownload *shared) {
+    ESP_LOGI(TAG, "Téléchargement segmenté de %s: %u sessions, blocs de %u Ko", ctx_->remote_path.c_str(),
+             (unsigned)slots_.size(), (unsigned)(block_size_ / 1024));
+    int client_sock = httpd_req_to_sockfd(ctx_->req);
+    int64_t stream_start = esp_timer_get_time();
+    last_progress_ = stream_start;
+
+    for (auto &slot : slots_) {
+      if (!this->start_block(slot)) {
+        return this->fail(ErrorCause::FTP_PROTOCOL);
+      }
+    }
+
+    while (sent_ < length_) {
+      ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+      Slot *current = this->slot_for(next_to_send_);
+
+      fd_set read_fds, write_fds;
+      FD_ZERO(&read_fds);
+      FD_ZERO(&write_fds);
+      int max_fd = -1;
+      bool buffered = false;  // Réponse déjà reçue avec la précédente: pas d'attente
+      for (auto &slot : slots_) {
+        if (this->awaiting_reply(slot)) {
+          FD_SET(slot.ctrl->sock(), &read_fds);
+          max_fd = std::max(max_fd, slot.ctrl->sock());
+          buffered |= slot.ctrl->buffered();
+        }
+        if (slot.data >= 0 && slot.filled < slot.len) {
+          FD_SET(slot.data, &read_fds);
+          max_fd = std::max(max_fd, slot.data);
+        }
+      }
+      if (ctx_->headers_sent && current && current->sent < current->filled) {
+        FD_SET(client_sock, &write_fds);
+        max_fd = std::max(max_fd, client_sock);
+      }
+
+      struct timeval tv = {.tv_sec = buffered ? 0 : 1, .tv_usec = 0};
+      int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, &tv);
+      if (ready < 0) {
+        ESP_LOGE(TAG, "Erreur de select: %d", errno);
+        return this->fail(ErrorCause::FTP_DATA);
+      }
+
+      int64_t now = esp_timer_get_time();
+      for (auto &slot : slots_) {
+        if (ready > 0 && slot.data >= 0 && FD_ISSET(slot.data, &read_fds) && !this->receive(slot)) {
+          return this->fail(ErrorCause::FTP_DATA);
+        }
+        bool readable = ready > 0 && this->awaiting_reply(slot) && FD_ISSET(slot.ctrl->sock(), &read_fds);
+        if ((readable || slot.ctrl->buffered()) && !this->on_control(slot)) {
+          return this->fail(ErrorCause::FTP_PROTOCOL);
+        }
+      }
+
+      // En-têtes dès que le premier bloc est accepté par le serveur
+      if (!ctx_->headers_sent && (slots_[0].state == SlotState::FETCHING || slots_[0].filled > 0)) {
+        ctx_->raw_body = true;
+        ctx_->headers_sent = true;
+        if (!send_raw_headers(ctx_, partial ? "206 Partial Content" : "200 OK", length_,
+                              partial ? ctx_->content_range : nullptr)) {
+          ESP_LOGE(TAG, "Échec d'envoi des en-têtes au client HTTP");
+          return this->fail(ErrorCause::CLIENT_SEND);
+        }
+        if (shared) {
+          shared->set_content_length(length_);
+        }
+      }
+
+      // Bloc attendu: envoi de ce qui est arrivé, dans l'ordre
+      current = this->slot_for(next_to_send_);
+      if (current && ctx_->headers_sent && current->sent < current->filled) {
+        const uint8_t *data = current->buf + current->sent;
+        int n = send(client_sock, data, current->filled - current->sent, MSG_DONTWAIT);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+          ESP_LOGE(TAG, "Échec d'envoi au client HTTP: %d", errno);
+          return this->fail(ErrorCause::CLIENT_SEND);
+        }
+        if (n > 0) {
+          record_first_byte(ctx_);
+          proxy_->metrics_.bytes_out.add(n);
+          current->sent += n;
+          sent_ += n;
+          last_progress_ = now;
+          if (shared) {
+            shared->append(data, n, proxy_->follower_sink_);
+            shared->pump(0, proxy_->follower_sink_);
+          }
+        }
+      }
+
+      // Bloc entièrement envoyé et session revenue au repos: bloc suivant sur cette session
+      if (current && current->sent == current->len && current->state == SlotState::READY) {
+        next_to_send_++;
+        current->state = SlotState::IDLE;
+        if (next_block_ < block_count_ && !this->start_block(*current)) {
+          return this->fail(ErrorCause::FTP_PROTOCOL);
+        }
+      }
+
+      if (now - last_progress_ > (int64_t)HTTP_SEND_STALL_TIMEOUT_MS * 1000) {
+        bool client_blocked = current && current->sent < current->filled;
+        ESP_LOGE(TAG, "Téléchargement segmenté bloqué (%s)", client_blocked ? "client HTTP" : "serveur FTP");
+        return this->fail(client_blocked ? ErrorCause::CLIENT_STALL : ErrorCause::FTP_DATA);
+      }
+    }
+
+    success_ = true;
+    ESP_LOGI(TAG, "Transfert segmenté terminé avec succès: %.2f MB", sent_ / (1024.0 * 1024.0));
+    proxy_->metrics_.transfers_completed.inc();
+    int64_t stream_us = esp_timer_get_time() - stream_start;
+    if (stream_us > 0) {
+      proxy_->metrics_.throughput_kbps.record((uint32_t)((uint64_t)sent_ * 1000000 / 1024 / stream_us));
+    }
+    return true;
   }
-  
-  struct timeval data_timeout = {.tv_sec = 15, .tv_usec = 0};  // Délai augmenté
-  if (setsockopt(data_sock, SOL_SOCKET, SO_RCVTIMEO, &data_timeout, sizeof(data_timeout)) < 0) {
-    ESP_LOGW(TAG, "Échec de configuration SO_RCVTIMEO pour data_sock: %d", errno);
+
+ private:
+  enum class SlotState : uint8_t {
+    IDLE,      // Pas de bloc
+    PASV,      // PASV envoyé
+    REST,      // Canal de données en connexion, REST et RETR envoyés
+    RETR,      // RETR envoyé, attente du 150
+    FETCHING,  // Réception du bloc
+    CLOSING,   // Bloc reçu, canal fermé, attente de la réponse de fin du RETR
+    READY,     // Session au repos, bloc en attente d'envoi
+  };
+
+  struct Slot {
+    int data{-1};
+    SlotState state{SlotState::IDLE};
+    uint8_t *buf{nullptr};
+    int64_t block{-1};
+    size_t len{0};
+    size_t filled{0};
+    size_t sent{0};
+    FtpClient *ctrl{nullptr};  // Session prêtée par le pool
+  };
+
+  // Rend les sessions et tampons quand le mode segmenté est abandonné avant de commencer
+  void give_back() {
+    for (auto &slot : slots_) {
+      proxy_->release_ftp_connection(slot.ctrl, true);
+      proxy_->segment_buffers_.release(slot.buf);
+    }
+    slots_.clear();
   }
-  
-  // Connexion au port de données
-  struct sockaddr_in data_addr;
-  memset(&data_addr, 0, sizeof(data_addr));
-  data_addr.sin_family = AF_INET;
-  data_addr.sin_port = htons(data_port);
-  
-  // Utilisation de inet_addr pour définir l'adresse IP
-  char ip_str[16];
-  snprintf(ip_str, sizeof(ip_str), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
-  data_addr.sin_addr.s_addr = inet_addr(ip_str);
-  
-  if (connect(data_sock, (struct sockaddr *)&data_addr, sizeof(data_addr)) != 0) {
-    ESP_LOGE(TAG, "Échec de connexion au port de données: %d", errno);
-    free(buffer);
-    close(data_sock);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+
+  Slot *slot_for(int64_t block) {
+    for (auto &slot : slots_) {
+      if (slot.block == block && slot.state != SlotState::IDLE) {
+        return &slot;
+      }
+    }
+    return nullptr;
   }
 
-  // Envoi de la commande RETR pour récupérer le fichier
-  snprintf(buffer, buffer_size, "RETR %s\r\n", ctx->remote_path.c_str());
-  int sent = send(ftp_sock, buffer, strlen(buffer), 0);
-  if (sent <= 0) {
-    ESP_LOGE(TAG, "Échec d'envoi de la commande RETR: %d", errno);
-    free(buffer);
-    close(data_sock);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+  bool start_block(Slot &slot) {
+    slot.block = next_block_++;
+    int64_t offset = slot.block * block_size_;
+    slot.len = (size_t)std::min<int64_t>(block_size_, length_ - offset);
+    slot.filled = 0;
+    slot.sent = 0;
+    slot.state = SlotState::PASV;
+    slot.ctrl->queue("PASV");
+    return slot.ctrl->flush();
   }
 
-  // Vérification de la réponse à la commande RETR
-  bytes_received = recv(ftp_sock, buffer, buffer_size - 1, 0);
-  if (bytes_received <= 0) {
-    ESP_LOGE(TAG, "Échec de réception de la réponse RETR: %d", errno);
-    free(buffer);
-    close(data_sock);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+  // Commande envoyée sur la session, réponse attendue
+  bool awaiting_reply(const Slot &slot) const {
+    return slot.state == SlotState::PASV || slot.state == SlotState::REST || slot.state == SlotState::RETR ||
+           slot.state == SlotState::CLOSING;
   }
-  
-  buffer[bytes_received] = '\0';
-  
-  if (!strstr(buffer, "150 ") && !strstr(buffer, "125 ")) {
-    ESP_LOGE(TAG, "Fichier non trouvé ou inaccessible: %s", buffer);
-    free(buffer);
-    close(data_sock);
-    close(ftp_sock);
-    httpd_resp_send_err(ctx->req, HTTPD_404_NOT_FOUND, "Fichier non trouvé ou inaccessible");
-    delete ctx;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-    vTaskDelete(NULL);
-    return;
+
+  // Session sans RETR en cours ni réponse attendue: elle retourne dans le pool. Un
+  // RETR interrompu en fin de bloc l'est une fois sa réponse 426/450/451 lue; une
+  // éventuelle réponse 226 tardive est absorbée à la prochaine acquisition.
+  bool at_rest(const Slot &slot) const {
+    return slot.data < 0 && (slot.state == SlotState::IDLE || slot.state == SlotState::READY);
   }
-  
-  ESP_LOGI(TAG, "Téléchargement du fichier %s démarré", ctx->remote_path.c_str());
 
-  // Transfert des données
-  size_t total_bytes_transferred = 0;
-  esp_err_t err = ESP_OK;
-  
-  // Définir la taille des chunks plus petite pour les gros fichiers
-  const int chunk_size = 4096;  // Plus petit que buffer_size
-  
-  // Boucle de transfert de données
-  while (true) {
-    // Réinitialiser le watchdog régulièrement
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
-    
-    bytes_received = recv(data_sock, buffer, buffer_size, 0);
-    if (bytes_received <= 0) {
-      if (bytes_received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-        ESP_LOGE(TAG, "Erreur de réception des données: %d", errno);
-      } else {
-        // Fin normale du fichier
-        ESP_LOGI(TAG, "Fin du transfert de données");
+  // Réponses disponibles sur la session; s'arrête quand le bloc n'attend plus de réponse
+  bool on_control(Slot &slot) {
+    FtpReply reply;
+    while (this->awaiting_reply(slot)) {
+      FtpClient::Poll poll = slot.ctrl->poll_reply(reply);
+      if (poll == FtpClient::Poll::PENDING) {
+        return true;
       }
-      break;
-    }
-    
-    total_bytes_transferred += bytes_received;
-    
-    // Vérification de la mémoire disponible
-    if (esp_get_free_heap_size() < 15000) {
-      ESP_LOGW(TAG, "Mémoire critique: %d octets", esp_get_free_heap_size());
-      vTaskDelay(pdMS_TO_TICKS(50));  // Pause pour permettre la libération de mémoire
-    }
-    
-    // Envoyer en petits chunks au lieu d'un gros chunk
-    if (bytes_received > chunk_size) {
-      for (int i = 0; i < bytes_received; i += chunk_size) {
-        int current_chunk = std::min(chunk_size, bytes_received - i);
-        err = httpd_resp_send_chunk(ctx->req, buffer + i, current_chunk);
-        if (err != ESP_OK) {
-          ESP_LOGE(TAG, "Échec d'envoi du chunk: %s", esp_err_to_name(err));
+      if (poll == FtpClient::Poll::CLOSED) {
+        ESP_LOGE(TAG, "Session FTP coupée pendant le téléchargement segmenté");
+        return false;
+      }
+      last_progress_ = esp_timer_get_time();
+      switch (slot.state) {
+        case SlotState::PASV:
+          if (reply.is(FtpReply::DATA_CONNECTION_CLOSED) || reply.is(FtpReply::TRANSFER_COMPLETE)) {
+            break;  // Fin tardive du RETR interrompu précédent
+          }
+          if (!this->open_data(slot, reply)) {
+            ESP_LOGE(TAG, "PASV refusé (%d): %s", reply.code, reply.text.c_str());
+            return false;
+          }
+          break;
+        case SlotState::REST:
+          if (!reply.is(FtpReply::PENDING_FURTHER_INFO)) {
+            ESP_LOGE(TAG, "REST refusé (%d): %s", reply.code, reply.text.c_str());
+            return false;
+          }
+          slot.state = SlotState::RETR;
+          break;
+        case SlotState::RETR:
+          if (!reply.transfer_starting()) {
+            ESP_LOGE(TAG, "RETR refusé (%d): %s", reply.code, reply.text.c_str());
+            return false;
+          }
+          slot.state = slot.filled == slot.len ? SlotState::CLOSING : SlotState::FETCHING;
+          break;
+        case SlotState::CLOSING:
+          // 226 en fin de fichier; 426/450/451 pour un RETR interrompu en fin de bloc
+          if (!reply.transfer_complete() && !reply.is(FtpReply::TRANSFER_ABORTED) &&
+              !reply.is(FtpReply::FILE_BUSY) && !reply.is(FtpReply::LOCAL_ERROR)) {
+            ESP_LOGE(TAG, "Fin de bloc inattendue (%d): %s", reply.code, reply.text.c_str());
+            return false;
+          }
+          slot.state = SlotState::READY;
+          break;
+        default:
           break;
-        }
-        vTaskDelay(pdMS_TO_TICKS(5));  // Petit délai entre les chunks
       }
-    } else {
-      err = httpd_resp_send_chunk(ctx->req, buffer, bytes_received);
     }
-    
-    if (err != ESP_OK) {
-      ESP_LOGE(TAG, "Échec d'envoi au client HTTP: %s", esp_err_to_name(err));
-      break;
+    return true;
+  }
+
+  // Canal de données en connexion non bloquante, REST et RETR envoyés d'un seul tenant
+  bool open_data(Slot &slot, const FtpReply &pasv) {
+    char ip[16];
+    uint16_t port = 0;
+    if (!pasv.passive_address(ip, sizeof(ip), port)) {
+      return false;
     }
-    
-    // Afficher le progrès périodiquement
-    if (total_bytes_transferred % (256 * 1024) == 0) {
-      ESP_LOGI(TAG, "Transfert en cours: %.2f MB", total_bytes_transferred / (1024.0 * 1024.0));
-      ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());  // Réinitialiser le watchdog
-      vTaskDelay(pdMS_TO_TICKS(5));  // Petit délai pour éviter la saturation
+    slot.data = socket(AF_INET, SOCK_STREAM, 0);
+    if (slot.data < 0) {
+      return false;
+    }
+    int rcvbuf = 32768;
+    setsockopt(slot.data, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    fcntl(slot.data, F_SETFL, fcntl(slot.data, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in data_addr;
+    memset(&data_addr, 0, sizeof(data_addr));
+    data_addr.sin_family = AF_INET;
+    data_addr.sin_port = htons(port);
+    data_addr.sin_addr.s_addr = inet_addr(ip);
+    if (connect(slot.data, (struct sockaddr *)&data_addr, sizeof(data_addr)) != 0 && errno != EINPROGRESS) {
+      return false;
+    }
+
+    int64_t offset = start_ + slot.block * block_size_;
+    if (offset > 0) {
+      slot.ctrl->queue("REST %lld", (long long)offset);
     }
+    slot.ctrl->queue("RETR %s", ctx_->remote_path.c_str());
+    slot.state = offset > 0 ? SlotState::REST : SlotState::RETR;
+    return slot.ctrl->flush();
   }
-  
-  // Fermeture du socket de données
-  if (data_sock != -1) {
-    close(data_sock);
-    data_sock = -1;
+
+  bool receive(Slot &slot) {
+    int n = recv(slot.data, slot.buf + slot.filled, slot.len - slot.filled, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS)) {
+      return true;
+    }
+    if (n <= 0) {
+      ESP_LOGE(TAG, "Canal de données du bloc %lld fermé à %u/%u octets", (long long)slot.block,
+               (unsigned)slot.filled, (unsigned)slot.len);
+      return false;
+    }
+    slot.filled += n;
+    proxy_->metrics_.bytes_in.add(n);
+    last_progress_ = esp_timer_get_time();
+    if (slot.filled == slot.len) {
+      // Bloc complet: fermer le canal, le serveur conclut le RETR (interrompu
+      // si le fichier continue au-delà)
+      close(slot.data);
+      slot.data = -1;
+      if (slot.state == SlotState::FETCHING) {
+        slot.state = SlotState::CLOSING;
+      }
+    }
+    return true;
+  }
+
+  bool fail(ErrorCause cause) {
+    fail_response(ctx_, cause, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+    return false;
   }
+
+  FTPHTTPProxy *proxy_;
+  FileTransferContext *ctx_;
+  int64_t start_;
+  int64_t length_;
+  int64_t block_size_{0};
+  int64_t block_count_{0};
+  int64_t next_block_{0};    // Prochain bloc à demander
+  int64_t next_to_send_{0};  // Bloc en cours d'envoi au client
+  int64_t sent_{0};
+  int64_t last_progress_{0};
+  bool success_{false};
+  std::vector<Slot> slots_;
+};
+
+bool FTPHTTPProxy::run_transfer(TransferWorker* worker, FileTransferContext* ctx) {
+  ESP_LOGI(TAG, "Démarrage du transfert pour %s", ctx->remote_path.c_str());
   
-  // Vérification de la fin du transfert FTP
-  bytes_received = recv(ftp_sock, buffer, buffer_size - 1, 0);
-  if (bytes_received > 0) {
-    buffer[bytes_received] = '\0';
-    if (strstr(buffer, "226 ") || strstr(buffer, "250 ")) {
-      ESP_LOGI(TAG, "Transfert terminé avec succès: %.2f KB (%.2f MB)", 
-               total_bytes_transferred / 1024.0,
-               total_bytes_transferred / (1024.0 * 1024.0));
-      success = true;
+  FTPHTTPProxy *proxy = ctx->proxy;
+  FtpClient *ftp = nullptr;
+  int data_sock = -1;
+  bool success = false;
+
+  // Vérifier la validité du chemin de fichier
+  if (ctx->remote_path.empty()) {
+    ESP_LOGE(TAG, "Chemin de fichier distant vide");
+    fail_response(ctx, ErrorCause::NOT_FOUND, HTTPD_404_NOT_FOUND, "Fichier non spécifié");
+    return true;
+  }
+
+  // Reprise d'un client détaché d'un téléchargement partagé: en-têtes déjà envoyés
+  bool resuming = ctx->resume_offset >= 0;
+
+  // Requête conditionnelle: des faits MLSD récents suffisent à répondre 304 sans
+  // contacter le serveur (une date de LIST, à la minute près, ne suffit pas)
+  if (!resuming && ctx->is_conditional()) {
+    FileMetadata meta;
+    if (proxy->get_file_metadata(ctx->remote_path, meta) && meta.has_stat && meta.exact_mtime &&
+        esp_timer_get_time() - meta.stat_at < (int64_t)proxy->listing_cache_ttl_ * 1000) {
+      set_validators(ctx, meta.size, meta.mtime);
+      if (is_not_modified(ctx, meta.mtime)) {
+        send_not_modified(ctx);
+        return true;
+      }
+    }
+  }
+
+  // Cache de contenu: une copie validée récemment est servie sans contacter le serveur
+  bool use_cache = proxy->content_cache_.enabled() && !resuming;
+  std::string cache_key;
+  CachedContentPtr cached;
+  if (use_cache) {
+    cache_key = FileMetadataStore::normalize_path(ctx->remote_path);
+    cached = proxy->content_cache_.get(cache_key);
+    if (cached && esp_timer_get_time() - cached->validated_at.load() < CONTENT_CACHE_REVALIDATE_US) {
+      proxy->content_cache_.count_hit();
+      set_validators(ctx, cached->size, cached->mtime);
+      if (is_not_modified(ctx, cached->mtime)) {
+        send_not_modified(ctx);
+      } else {
+        serve_cached_content(ctx, *cached);
+      }
+      return true;
+    }
+  }
+
+  // Fichier complet: rejoindre un téléchargement identique déjà en cours, ou en
+  // devenir le meneur pour que les requêtes suivantes s'y rattachent
+  SharedDownload *shared = nullptr;
+  if (ctx->range_header.empty() && !ctx->is_conditional() && !resuming &&
+      proxy->join_shared_download(ctx, true, shared)) {
+    return false;
+  }
+  SharedDownloadLease shared_lease(proxy, shared);
+
+  // Emprunter une connexion FTP authentifiée au pool
+  ftp = proxy->acquire_ftp_connection();
+  if (!ftp) {
+    ESP_LOGE(TAG, "Échec de connexion FTP");
+    fail_response(ctx, ErrorCause::FTP_CONNECT, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de connexion au serveur FTP");
+    return true;
+  }
+
+  set_content_headers(ctx);
+
+  // Taille et date du fichier: résolution des plages, validateurs HTTP et du cache.
+  // Sur la connexion de contrôle uniquement, avant toute ouverture de canal de données;
+  // SIZE et MDTM partent ensemble.
+  int64_t file_size = -1;
+  int64_t mtime = 0;
+  if (!resuming) {
+    int features = proxy->ftp_features_.load();
+    bool ask_mtime = features < 0 || (features & FTP_FEATURE_MDTM);
+    ftp->queue("SIZE %s", ctx->remote_path.c_str());
+    if (ask_mtime) {
+      ftp->queue("MDTM %s", ctx->remote_path.c_str());
+    }
+    if (ftp->flush()) {
+      FtpReply size_reply = ftp->read_reply();
+      if (size_reply.is(FtpReply::FILE_STATUS)) {
+        file_size = strtoll(size_reply.text.c_str(), nullptr, 10);
+      }
+      FtpReply mtime_reply = ask_mtime && size_reply.valid() ? ftp->read_reply() : FtpReply();
+      if (file_size >= 0 && mtime_reply.is(FtpReply::FILE_STATUS)) {
+        mtime = ListingParser::parse_ftp_timestamp(mtime_reply.text.c_str());
+      }
+    }
+  }
+
+  ctx->etag.clear();
+  if (mtime > 0) {
+    set_validators(ctx, file_size, mtime);
+    if (is_not_modified(ctx, mtime)) {
+      proxy->release_ftp_connection(ftp, true);
+      send_not_modified(ctx);
+      return true;
+    }
+    httpd_resp_set_hdr(ctx->req, "ETag", ctx->etag.c_str());
+    httpd_resp_set_hdr(ctx->req, "Last-Modified", ctx->last_modified.c_str());
+  }
+
+  // L'ETag sert aussi de validateur au cache de contenu
+  std::string validator = ctx->etag;
+  if (use_cache) {
+    if (cached && !validator.empty() && cached->validator == validator) {
+      // Copie locale toujours à jour: inutile d'ouvrir un canal de données
+      cached->validated_at.store(esp_timer_get_time());
+      proxy->release_ftp_connection(ftp, true);
+      proxy->content_cache_.count_hit();
+      serve_cached_content(ctx, *cached);
+      return true;
+    }
+    if (cached) {
+      ESP_LOGD(TAG, "Copie en cache périmée: %s", cache_key.c_str());
+      proxy->content_cache_.invalidate(cache_key);
+      cached.reset();
+    }
+    proxy->content_cache_.count_miss();
+  }
+
+  // Requête partielle
+  bool partial = false;
+  int64_t range_start = 0;
+  int64_t range_length = -1;  // -1: jusqu'à la fin du fichier
+  if (!ctx->range_header.empty()) {
+    int64_t range_end = 0;
+    int range_status = file_size >= 0 ? parse_range_header(ctx->range_header, file_size, range_start, range_end) : 0;
+    if (range_status < 0) {
+      ESP_LOGW(TAG, "Plage non satisfaisable: %s (taille %lld)", ctx->range_header.c_str(), (long long)file_size);
+      proxy->release_ftp_connection(ftp, true);
+      snprintf(ctx->content_range, sizeof(ctx->content_range), "bytes */%lld", (long long)file_size);
+      httpd_resp_set_status(ctx->req, "416 Range Not Satisfiable");
+      httpd_resp_set_hdr(ctx->req, "Content-Range", ctx->content_range);
+      httpd_resp_send(ctx->req, NULL, 0);
+      return true;
+    }
+    if (range_status > 0) {
+      partial = true;
+      // Une plage qui va jusqu'à la fin du fichier se termine naturellement par le 226
+      if (range_end < file_size - 1) {
+        range_length = range_end - range_start + 1;
+      }
+      snprintf(ctx->content_range, sizeof(ctx->content_range), "bytes %lld-%lld/%lld",
+               (long long)range_start, (long long)range_end, (long long)file_size);
+      ESP_LOGI(TAG, "Requête partielle: %s", ctx->content_range);
+    } else {
+      ESP_LOGW(TAG, "En-tête Range ignoré: %s", ctx->range_header.c_str());
+    }
+  }
+
+  // Reprise d'un client détaché d'un téléchargement partagé: les en-têtes et le
+  // début du fichier ont déjà été envoyés, le serveur doit reprendre à cet octet
+  if (resuming) {
+    partial = true;
+    range_start = ctx->resume_offset;
+  }
+
+  // Gros fichier: blocs demandés en parallèle sur plusieurs sessions. Sans session
+  // libre ou sans PSRAM, repli sur le transfert ordinaire avec la même session.
+  if (!resuming && proxy->segment_connections_ > 1 && file_size >= (int64_t)proxy->segment_threshold_) {
+    int64_t length = range_length >= 0 ? range_length : file_size - range_start;
+    SegmentedTransfer segmented(ctx, range_start, length);
+    if (segmented.prepare(ftp)) {
+      if (segmented.run(partial, shared) && shared) {
+        shared_lease.set_complete();
+      }
+      return true;
+    }
+  }
+
+  // PASV, REST et RETR partent ensemble; la connexion au canal de données se fait
+  // dès la réponse 227, pendant que le serveur traite les commandes suivantes. Un
+  // REST refusé laisse le RETR partir du début du fichier.
+  bool rest = partial && range_start > 0;
+  int64_t command_start = esp_timer_get_time();
+  ftp->queue("PASV");
+  if (rest) {
+    ftp->queue("REST %lld", (long long)range_start);
+  }
+  ftp->queue("RETR %s", ctx->remote_path.c_str());
+  if (!ftp->flush()) {
+    ESP_LOGE(TAG, "Échec d'envoi des commandes de transfert: %d", errno);
+    proxy->release_ftp_connection(ftp, false);
+    fail_response(ctx, ErrorCause::FTP_PROTOCOL, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+    return true;
+  }
+
+  FtpReply reply = ftp->read_reply();
+  proxy->metrics_.pasv_ms.record(elapsed_ms(command_start));
+  data_sock = open_passive_data(reply, 32768);
+  if (data_sock < 0) {
+    proxy->release_ftp_connection(ftp, false);
+    fail_response(ctx, ErrorCause::FTP_PROTOCOL, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+    return true;
+  }
+
+  // Positionnement du serveur sur le début de la plage demandée
+  if (rest) {
+    reply = ftp->read_reply();
+    if (!reply.is(FtpReply::PENDING_FURTHER_INFO) && resuming) {
+      ESP_LOGE(TAG, "REST refusé par le serveur, reprise impossible (%d): %s", reply.code, reply.text.c_str());
+      close(data_sock);
+      proxy->release_ftp_connection(ftp, false);
+      fail_response(ctx, ErrorCause::FTP_PROTOCOL, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+      return true;
+    }
+    if (!reply.is(FtpReply::PENDING_FURTHER_INFO)) {
+      ESP_LOGW(TAG, "REST refusé par le serveur, envoi du fichier complet (%d): %s", reply.code, reply.text.c_str());
+      partial = false;
+      range_start = 0;
+      range_length = -1;
+    }
+  }
+
+  // Réponse au RETR
+  command_start = esp_timer_get_time();
+  reply = ftp->read_reply();
+  if (!reply.valid()) {
+    ESP_LOGE(TAG, "Échec de réception de la réponse RETR: %d", errno);
+    close(data_sock);
+    proxy->release_ftp_connection(ftp, false);
+    fail_response(ctx, ErrorCause::FTP_PROTOCOL, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+    return true;
+  }
+  proxy->metrics_.retr_ms.record(elapsed_ms(command_start));
+
+  if (!reply.transfer_starting()) {
+    ESP_LOGE(TAG, "Fichier non trouvé ou inaccessible (%d): %s", reply.code, reply.text.c_str());
+    close(data_sock);
+    proxy->release_ftp_connection(ftp, false);
+    fail_response(ctx, ErrorCause::NOT_FOUND, HTTPD_404_NOT_FOUND, "Fichier non trouvé ou inaccessible");
+    return true;
+  }
+  
+  ESP_LOGI(TAG, "Téléchargement du fichier %s démarré", ctx->remote_path.c_str());
+
+  // Taille connue: réponse avec Content-Length et corps écrit tel quel. Sans SIZE,
+  // repli sur le chunked, dont les en-têtes partent avec le premier morceau.
+  int64_t content_length = -1;
+  if (!resuming && file_size >= 0) {
+    content_length = range_length >= 0 ? range_length : file_size - range_start;
+    ctx->raw_body = true;
+    ctx->headers_sent = true;
+    if (!send_raw_headers(ctx, partial ? "206 Partial Content" : "200 OK", content_length,
+                          partial ? ctx->content_range : nullptr)) {
+      ESP_LOGE(TAG, "Échec d'envoi des en-têtes au client HTTP");
+      close(data_sock);
+      proxy->release_ftp_connection(ftp, false);
+      fail_response(ctx, ErrorCause::CLIENT_SEND, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+      return true;
+    }
+    if (shared) {
+      shared->set_content_length(content_length);
+    }
+  }
+  if (shared && content_length < 0) {
+    // Sans longueur annoncée, les clients rattachés devraient recevoir du chunked, qui
+    // ne se prête pas aux envois partiels sans attente
+    shared_lease.cancel();
+    shared = nullptr;
+  }
+
+  // Fichier complet et validable: une copie est conservée au fil de l'envoi
+  CachedContentPtr fill;
+  if (!partial && !validator.empty()) {
+    fill = proxy->content_cache_.allocate(file_size);
+    if (fill) {
+      fill->validator = validator;
+      fill->mtime = mtime;
+    }
+  }
+
+  // Boucle d'événements: le flux lui est confié et le worker redevient libre. Les
+  // transferts partagés ou copiés en cache, et le chunked, restent sur le worker.
+  if (!shared && !fill && ctx->raw_body &&
+      proxy->stream_mux_.add(ctx, httpd_req_to_sockfd(ctx->req), data_sock, ftp, content_length,
+                             range_length >= 0)) {
+    ESP_LOGD(TAG, "Transfert de %s confié à la boucle d'événements", ctx->remote_path.c_str());
+    return false;
+  }
+
+  // Transfert des données
+  size_t total_bytes_transferred = 0;
+  esp_err_t err = ESP_OK;
+  bool range_complete = false;
+  
+  // Pipeline: la tâche de lecture du worker remplit le tampon circulaire depuis
+  // le socket de données FTP pendant que cette tâche le vide vers le client HTTP
+  TransferPipeline pipeline;
+  pipeline.data_sock = data_sock;
+  pipeline.limit = range_length;
+  pipeline.data_counter = &proxy->metrics_.bytes_in;
+  pipeline.http_task = worker->sender;
+  pipeline.ftp_task = worker->reader;
+
+  bool ring_ready = pipeline.ring.init(proxy->transfer_buffers_);
+  pipeline.fill_limit.store(pipeline.ring.capacity());
+
+  if (!ring_ready) {
+    ESP_LOGE(TAG, "Échec d'allocation du tampon de transfert");
+    close(data_sock);
+    proxy->release_ftp_connection(ftp, false);
+    fail_response(ctx, ErrorCause::OUT_OF_MEMORY, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur mémoire");
+    return true;
+  }
+
+  // Confier le pipeline à la tâche de lecture du worker
+  worker->pipeline.store(&pipeline);
+  xTaskNotifyGive(worker->reader);
+
+  // Régulation: le rythme est donné par la place libre dans le tampon d'envoi
+  // du socket client et par le débit mesuré, sans pause fixe
+  int client_sock = httpd_req_to_sockfd(ctx->req);
+  size_t send_chunk = compute_send_chunk();
+  uint32_t drain_rate = 0;  // Débit vers le client (octets/s, moyenne glissante)
+  int64_t sample_start = esp_timer_get_time();
+  int64_t stream_start = sample_start;
+  size_t sample_bytes = 0;
+  
+  // Boucle d'envoi des données
+  while (true) {
+    // Réinitialiser le watchdog régulièrement
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+
+    const uint8_t *regions[2];
+    size_t lengths[2];
+    size_t available = pipeline.ring.read_regions(regions, lengths);
+    if (available == 0) {
+      if (!pipeline.ftp_done.load(std::memory_order_acquire)) {
+        // Attendre que le producteur signale de nouvelles données, en servant
+        // entre-temps les clients rattachés
+        if (shared) {
+          shared->pump(0, proxy->follower_sink_);
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        continue;
+      }
+      // Le producteur a terminé: dernière vérification avant de conclure
+      available = pipeline.ring.read_regions(regions, lengths);
+      if (available == 0) {
+        if (pipeline.io_error != 0) {
+          ESP_LOGE(TAG, "Erreur de réception des données: %d", pipeline.io_error);
+        } else {
+          ESP_LOGI(TAG, "Fin du transfert de données");
+        }
+        break;
+      }
+    }
+
+    size_t to_send = 0;
+    if (ctx->raw_body) {
+      // Chemin rapide: corps écrit directement sur le socket client, les deux zones
+      // du tampon en un seul appel, sans cadrage; l'attente de place n'a lieu que
+      // lorsque le socket est plein
+      int sent = pipeline.ring.send_to(client_sock, send_chunk, MSG_DONTWAIT);
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (!wait_socket_writable(client_sock, HTTP_SEND_STALL_TIMEOUT_MS)) {
+          ESP_LOGE(TAG, "Client HTTP bloqué, abandon du transfert");
+          err = ESP_ERR_TIMEOUT;
+          break;
+        }
+        continue;
+      }
+      if (sent <= 0) {
+        ESP_LOGE(TAG, "Échec d'envoi au client HTTP: %d", errno);
+        err = ESP_FAIL;
+        break;
+      }
+      to_send = (size_t)sent;
     } else {
-      ESP_LOGW(TAG, "Fin de transfert avec message inattendu: %s", buffer);
+      if (!wait_socket_writable(client_sock, HTTP_SEND_STALL_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Client HTTP bloqué, abandon du transfert");
+        err = ESP_ERR_TIMEOUT;
+        break;
+      }
+      to_send = std::min(lengths[0], send_chunk);
+      err = httpd_resp_send_chunk(ctx->req, (const char *)regions[0], to_send);
+      if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Échec d'envoi au client HTTP: %s", esp_err_to_name(err));
+        break;
+      }
+    }
+    ctx->headers_sent = true;
+    record_first_byte(ctx);
+    proxy->metrics_.bytes_out.add(to_send);
+
+    // Copies pour les clients rattachés et le cache, avant de rendre la place au producteur
+    for (size_t r = 0, copied = 0; r < 2 && copied < to_send; r++) {
+      size_t len = std::min(lengths[r], to_send - copied);
+      if (shared) {
+        shared->append(regions[r], len, proxy->follower_sink_);
+      }
+      if (fill) {
+        size_t offset = total_bytes_transferred + copied;
+        if (offset + len <= fill->size) {
+          memcpy(fill->data + offset, regions[r], len);
+        } else {
+          fill.reset();  // Fichier modifié pendant le transfert
+        }
+      }
+      copied += len;
+    }
+
+    // Libérer la place et réveiller le producteur s'il attendait
+    pipeline.ring.commit_read(to_send);
+    xTaskNotifyGive(pipeline.ftp_task);
+
+    if (shared) {
+      shared->pump(0, proxy->follower_sink_);
+    }
+
+    // Afficher le progrès périodiquement
+    size_t previous_total = total_bytes_transferred;
+    total_bytes_transferred += to_send;
+    if (total_bytes_transferred / (256 * 1024) != previous_total / (256 * 1024)) {
+      ESP_LOGI(TAG, "Transfert en cours: %.2f MB", total_bytes_transferred / (1024.0 * 1024.0));
+    }
+
+    // Mesurer le débit et ajuster l'avance du producteur et la taille des envois
+    sample_bytes += to_send;
+    int64_t now = esp_timer_get_time();
+    if (now - sample_start >= FLOW_SAMPLE_US) {
+      uint32_t sample_rate = (uint32_t)((uint64_t)sample_bytes * 1000000 / (now - sample_start));
+      drain_rate = drain_rate == 0 ? sample_rate : (drain_rate * 7 + sample_rate) / 8;
+      sample_start = now;
+      sample_bytes = 0;
+
+      size_t lead = (size_t)((uint64_t)drain_rate * TRANSFER_LEAD_MS / 1000);
+      lead = std::max(lead, TRANSFER_RING_MIN_SIZE);
+      pipeline.fill_limit.store(std::min(lead, pipeline.ring.capacity()), std::memory_order_relaxed);
+      send_chunk = compute_send_chunk();
+    }
+  }
+
+  // Arrêter le producteur (débloquer un recv en cours si le client est parti)
+  // et attendre sa sortie avant de libérer le pipeline
+  if (!pipeline.ftp_done.load(std::memory_order_acquire)) {
+    shutdown(data_sock, SHUT_RDWR);
+  }
+  pipeline.abort.store(true);
+  xTaskNotifyGive(pipeline.ftp_task);
+  xSemaphoreTake(worker->reader_done, portMAX_DELAY);
+  range_complete = pipeline.limit_reached && err == ESP_OK;
+  pipeline.ring.deinit();
+  
+  // Fermeture du socket de données
+  if (data_sock != -1) {
+    close(data_sock);
+    data_sock = -1;
+  }
+  
+  // Plage servie avant la fin du fichier: le RETR est interrompu côté serveur,
+  // la session de contrôle n'est donc pas remise dans le pool
+  bool reusable = true;
+  if (range_complete) {
+    ESP_LOGI(TAG, "Plage transférée: %.2f KB", total_bytes_transferred / 1024.0);
+    success = true;
+    reusable = false;
+  } else if (pipeline.io_error != 0) {
+    // Canal de données coupé ou muet: corps incomplet, même si le serveur répond 226
+    ESP_LOGW(TAG, "Canal de données interrompu (%d) après %u octets", pipeline.io_error,
+             (unsigned)total_bytes_transferred);
+  } else if ((reply = ftp->read_reply()).valid()) {
+    // Vérification de la fin du transfert FTP
+    if (reply.transfer_complete()) {
+      ESP_LOGI(TAG, "Transfert terminé avec succès: %.2f KB (%.2f MB)", 
+               total_bytes_transferred / 1024.0,
+               total_bytes_transferred / (1024.0 * 1024.0));
+      success = true;
+    } else {
+      ESP_LOGW(TAG, "Fin de transfert avec message inattendu (%d): %s", reply.code, reply.text.c_str());
+    }
+  } else {
+    ESP_LOGW(TAG, "Pas de réponse de fin de transfert du serveur FTP");
+  }
+
+  // Rendre la connexion au pool (fermée si le transfert s'est mal terminé)
+  if (ftp) {
+    proxy->release_ftp_connection(ftp, success && reusable);
+    ftp = nullptr;
+  }
+  
+  // Fichier modifié entre SIZE et RETR: la longueur annoncée est fausse
+  if (success && content_length >= 0 && (int64_t)total_bytes_transferred != content_length) {
+    ESP_LOGW(TAG, "Taille annoncée %lld, %u octets envoyés", (long long)content_length,
+             (unsigned)total_bytes_transferred);
+    success = false;
+  }
+
+  // Fichier vérifié: les clients rattachés et le cache peuvent s'y fier
+  if (success && !range_complete) {
+    if (shared) {
+      shared_lease.set_complete();
+    }
+    if (fill && total_bytes_transferred == fill->size) {
+      fill->validated_at.store(esp_timer_get_time());
+      proxy->content_cache_.put(cache_key, fill);
+    }
+  }
+
+  // Finalisation de la réponse HTTP
+  if (!success) {
+    ErrorCause cause = err == ESP_ERR_TIMEOUT ? ErrorCause::CLIENT_STALL
+                       : err != ESP_OK        ? ErrorCause::CLIENT_SEND
+                                              : ErrorCause::FTP_DATA;
+    fail_response(ctx, cause, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+    return true;
+  }
+
+  proxy->metrics_.transfers_completed.inc();
+  int64_t stream_us = esp_timer_get_time() - stream_start;
+  if (stream_us > 0) {
+    proxy->metrics_.throughput_kbps.record((uint32_t)((uint64_t)total_bytes_transferred * 1000000 / 1024 / stream_us));
+  }
+  if (!ctx->raw_body) {
+    // Terminer le mode chunked
+    httpd_resp_send_chunk(ctx->req, NULL, 0);
+  }
+  return true;
+}
+
+void FTPHTTPProxy::write_ftp_data(TransferPipeline* pipeline) {
+  while (!pipeline->abort.load()) {
+    size_t available = 0;
+    const uint8_t *src = pipeline->ring.read_ptr(available);
+    if (available == 0) {
+      if (pipeline->http_done.load(std::memory_order_acquire)) {
+        // Dernière vérification: des octets ont pu arriver avant la fin du corps
+        pipeline->ring.read_ptr(available);
+        if (available == 0) {
+          break;
+        }
+        continue;
+      }
+      // Attendre que l'étage HTTP fournisse des données
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+      continue;
+    }
+
+    int sent = send(pipeline->data_sock, src, available, 0);
+    if (sent <= 0) {
+      pipeline->io_error = sent < 0 ? errno : EPIPE;
+      break;
+    }
+    pipeline->ring.commit_read(sent);
+    pipeline->data_bytes += sent;
+    pipeline->data_counter->add(sent);
+    xTaskNotifyGive(pipeline->http_task);
+  }
+
+  pipeline->ftp_done.store(true, std::memory_order_release);
+  xTaskNotifyGive(pipeline->http_task);
+}
+
+// Envoi d'un fichier vers le serveur FTP: session de contrôle empruntée au pool,
+// canal de données alimenté par la tâche de lecture du worker depuis le tampon
+// circulaire, que la tâche du worker remplit avec le corps de la requête HTTP.
+// La mémoire utilisée ne dépend pas de la taille du fichier.
+class FTPHTTPProxy::UploadSession {
+ public:
+  UploadSession(TransferWorker *worker, FileTransferContext *ctx)
+      : proxy_(ctx->proxy), worker_(worker), ctx_(ctx) {
+    progress_.total = (int64_t)ctx->req->content_len;
+    progress_.offset = ctx->upload_offset;
+    progress_.started_at = esp_timer_get_time();
+  }
+
+  ~UploadSession() {
+    this->stop(true);
+    if (ftp_) {
+      proxy_->release_ftp_connection(ftp_, false);
+    }
+    if (registered_) {
+      xSemaphoreTake(proxy_->uploads_mutex_, portMAX_DELAY);
+      auto &uploads = proxy_->uploads_;
+      uploads.erase(std::remove(uploads.begin(), uploads.end(), &progress_), uploads.end());
+      xSemaphoreGive(proxy_->uploads_mutex_);
+    }
+  }
+
+  bool responded() const { return responded_; }
+  // Corps de la requête lu jusqu'au bout: la connexion HTTP peut être réutilisée
+  void set_body_read() { body_read_ = true; }
+
+  // PASV, REST et STOR, ou APPE, puis démarrage de l'étage FTP
+  bool open(const std::string &path) {
+    path_ = path;
+    xSemaphoreTake(proxy_->uploads_mutex_, portMAX_DELAY);
+    progress_.path = path;
+    proxy_->uploads_.push_back(&progress_);
+    registered_ = true;
+    xSemaphoreGive(proxy_->uploads_mutex_);
+
+    ftp_ = proxy_->acquire_ftp_connection();
+    if (!ftp_) {
+      this->fail(ErrorCause::FTP_CONNECT, "502 Bad Gateway", "Erreur de connexion au serveur FTP");
+      return false;
+    }
+
+    // PASV part avec REST, ou avec la commande d'envoi quand il n'y a pas de reprise.
+    // Le STOR d'une reprise attend l'accord du REST: refusé, il écraserait le fichier.
+    const char *store = ctx_->append ? "APPE" : "STOR";
+    bool rest = ctx_->upload_offset > 0;
+    ftp_->queue("PASV");
+    if (rest) {
+      ftp_->queue("REST %lld", (long long)ctx_->upload_offset);
+    } else {
+      ftp_->queue("%s %s", store, path.c_str());
+    }
+    if (!ftp_->flush()) {
+      this->fail(ErrorCause::FTP_PROTOCOL, "502 Bad Gateway", "Erreur de connexion au serveur FTP");
+      return false;
+    }
+
+    data_sock_ = open_passive_data(ftp_->read_reply(), 0);
+    if (data_sock_ < 0) {
+      this->fail(ErrorCause::FTP_PROTOCOL, "502 Bad Gateway", "Erreur de connexion au serveur FTP");
+      return false;
+    }
+
+    FtpReply reply;
+    if (rest) {
+      reply = ftp_->read_reply();
+      if (!reply.is(FtpReply::PENDING_FURTHER_INFO)) {
+        ESP_LOGW(TAG, "REST refusé par le serveur, reprise impossible (%d): %s", reply.code, reply.text.c_str());
+        this->fail(ErrorCause::FTP_PROTOCOL, upload_status_for(reply.code), "Reprise refusée par le serveur FTP");
+        return false;
+      }
+      ftp_->queue("%s %s", store, path.c_str());
+      if (!ftp_->flush()) {
+        this->fail(ErrorCause::FTP_PROTOCOL, "502 Bad Gateway", "Erreur de connexion au serveur FTP");
+        return false;
+      }
+    }
+
+    reply = ftp_->read_reply();
+    if (!reply.transfer_starting()) {
+      ESP_LOGE(TAG, "Envoi de %s refusé (%d): %s", path.c_str(), reply.code, reply.text.c_str());
+      this->fail(reply.is(FtpReply::FILE_UNAVAILABLE) ? ErrorCause::NOT_FOUND : ErrorCause::FTP_PROTOCOL,
+                 upload_status_for(reply.code), "Envoi refusé par le serveur FTP");
+      return false;
+    }
+
+    if (!pipeline_.ring.init(proxy_->transfer_buffers_)) {
+      ESP_LOGE(TAG, "Échec d'allocation du tampon d'envoi");
+      this->fail(ErrorCause::OUT_OF_MEMORY, "500 Internal Server Error", "Erreur mémoire");
+      return false;
+    }
+
+    pipeline_.upload = true;
+    pipeline_.data_sock = data_sock_;
+    pipeline_.data_counter = &proxy_->metrics_.bytes_uploaded;
+    pipeline_.http_task = worker_->sender;
+    pipeline_.ftp_task = worker_->reader;
+    worker_->pipeline.store(&pipeline_);
+    xTaskNotifyGive(worker_->reader);
+    started_ = true;
+    ESP_LOGI(TAG, "Envoi de %s démarré (%u octets%s)", path.c_str(), (unsigned)ctx_->req->content_len,
+             ctx_->append ? ", ajout" : "");
+    return true;
+  }
+
+  // Place libre dans le tampon, en attendant que l'étage FTP en libère.
+  // nullptr si l'étage FTP s'est arrêté (serveur parti).
+  uint8_t *reserve(size_t &len) {
+    while (true) {
+      if (pipeline_.ftp_done.load(std::memory_order_acquire)) {
+        return nullptr;
+      }
+      uint8_t *dst = pipeline_.ring.write_ptr(len);
+      if (len > 0) {
+        return dst;
+      }
+      ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    }
+  }
+
+  void commit(size_t len) {
+    pipeline_.ring.commit_write(len);
+    xTaskNotifyGive(pipeline_.ftp_task);
+
+    int64_t received = progress_.received + (int64_t)len;
+    xSemaphoreTake(proxy_->uploads_mutex_, portMAX_DELAY);
+    progress_.received = received;
+    xSemaphoreGive(proxy_->uploads_mutex_);
+    if (received / UPLOAD_LOG_INTERVAL != (received - (int64_t)len) / UPLOAD_LOG_INTERVAL) {
+      ESP_LOGI(TAG, "Envoi en cours: %.2f MB", received / (1024.0 * 1024.0));
+    }
+  }
+
+  // Copie depuis un tampon intermédiaire (corps multipart)
+  bool write(const uint8_t *data, size_t len) {
+    while (len > 0) {
+      size_t space = 0;
+      uint8_t *dst = this->reserve(space);
+      if (!dst) {
+        return false;
+      }
+      size_t n = std::min(space, len);
+      memcpy(dst, data, n);
+      this->commit(n);
+      data += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  // Fichier entièrement reçu: fin du canal de données, puis 226 du serveur
+  void finish() {
+    bool data_ok = this->stop(false);
+    close(data_sock_);
+    data_sock_ = -1;
+
+    FtpReply reply = ftp_->read_reply();
+    int code = reply.valid() ? reply.code : -1;
+    bool stored = data_ok && reply.transfer_complete();
+    proxy_->release_ftp_connection(ftp_, stored);
+    ftp_ = nullptr;
+
+    if (!stored) {
+      ESP_LOGE(TAG, "Envoi de %s non confirmé par le serveur (%d)", path_.c_str(), code);
+      this->fail(ErrorCause::FTP_DATA, data_ok ? upload_status_for(code) : "502 Bad Gateway",
+                 "Envoi interrompu par le serveur FTP");
+      return;
+    }
+
+    ESP_LOGI(TAG, "Envoi de %s terminé: %.2f KB", path_.c_str(), progress_.received / 1024.0);
+    proxy_->metrics_.uploads_completed.inc();
+    std::string body = "{\"path\":\"" + json_escape(path_) + "\"";
+    char tail[96];
+    snprintf(tail, sizeof(tail), ",\"bytes\":%lld,\"offset\":%lld,\"append\":%s}", (long long)progress_.received,
+             (long long)ctx_->upload_offset, ctx_->append ? "true" : "false");
+    body += tail;
+    // Nouveau fichier: 201; reprise ou ajout: le fichier existait déjà
+    bool created = !ctx_->append && ctx_->upload_offset == 0;
+    httpd_resp_set_status(ctx_->req, created ? "201 Created" : "200 OK");
+    httpd_resp_set_type(ctx_->req, "application/json");
+    httpd_resp_send(ctx_->req, body.data(), body.size());
+    responded_ = true;
+  }
+
+  // Réponse d'erreur; un corps pas entièrement lu impose de fermer la connexion
+  void fail(ErrorCause cause, const char *status, const char *message) {
+    this->stop(true);
+    if (responded_) {
+      return;
+    }
+    responded_ = true;
+    proxy_->metrics_.count_error(cause);
+    proxy_->metrics_.uploads_failed.inc();
+    if (!body_read_) {
+      httpd_resp_set_hdr(ctx_->req, "Connection", "close");
+    }
+    httpd_resp_set_status(ctx_->req, status);
+    httpd_resp_set_type(ctx_->req, "text/plain");
+    httpd_resp_sendstr(ctx_->req, message);
+    if (!body_read_) {
+      httpd_sess_trigger_close(ctx_->req->handle, httpd_req_to_sockfd(ctx_->req));
+    }
+  }
+
+ private:
+  // Arrête l'étage FTP (abandon: sans vider le tampon) et libère le tampon.
+  // Retourne true si tout le corps reçu a été écrit sur le canal de données.
+  bool stop(bool abort) {
+    if (!started_) {
+      if (data_sock_ >= 0) {
+        close(data_sock_);
+        data_sock_ = -1;
+      }
+      return false;
+    }
+    started_ = false;
+    if (abort) {
+      pipeline_.abort.store(true);
+      shutdown(data_sock_, SHUT_RDWR);  // Débloquer un send() en cours
+    }
+    pipeline_.http_done.store(true, std::memory_order_release);
+    xTaskNotifyGive(pipeline_.ftp_task);
+    xSemaphoreTake(worker_->reader_done, portMAX_DELAY);
+    bool complete = pipeline_.io_error == 0 && (int64_t)pipeline_.data_bytes == progress_.received;
+    pipeline_.ring.deinit();
+    if (abort) {
+      close(data_sock_);
+      data_sock_ = -1;
+    }
+    return complete;
+  }
+
+  FTPHTTPProxy *proxy_;
+  TransferWorker *worker_;
+  FileTransferContext *ctx_;
+  std::string path_;
+  FtpClient *ftp_{nullptr};
+  int data_sock_{-1};
+  TransferPipeline pipeline_;
+  bool started_{false};
+  bool responded_{false};
+  bool registered_{false};
+  bool body_read_{false};
+  UploadProgress progress_;
+};
+
+bool FTPHTTPProxy::run_upload(TransferWorker* worker, FileTransferContext* ctx) {
+  UploadSession session(worker, ctx);
+  httpd_req_t *req = ctx->req;
+  size_t remaining = req->content_len;
+
+  if (ctx->upload_boundary.empty()) {
+    // PUT: le corps est le fichier, reçu directement dans le tampon circulaire
+    if (!session.open(ctx->remote_path)) {
+      return true;
+    }
+    while (remaining > 0) {
+      size_t space = 0;
+      uint8_t *dst = session.reserve(space);
+      if (!dst) {
+        break;
+      }
+      int received = httpd_req_recv(req, (char *)dst, std::min(space, remaining));
+      if (received <= 0) {
+        ESP_LOGE(TAG, "Réception du corps interrompue (%d)", received);
+        session.fail(received == HTTPD_SOCK_ERR_TIMEOUT ? ErrorCause::CLIENT_STALL : ErrorCause::CLIENT_SEND,
+                     "408 Request Timeout", "Réception du fichier interrompue");
+        return true;
+      }
+      session.commit(received);
+      remaining -= received;
+    }
+  } else {
+    // POST multipart: le premier champ fichier est envoyé dans le répertoire demandé,
+    // les autres champs sont ignorés
+    SlabBlock chunk(ctx->proxy->scratch_buffers_);
+    if (!chunk) {
+      session.fail(ErrorCause::OUT_OF_MEMORY, "500 Internal Server Error", "Erreur mémoire");
+      return true;
+    }
+
+    bool in_file = false;
+    bool file_done = false;
+    ErrorCause error_cause = ErrorCause::CLIENT_SEND;
+    const char *error_status = "400 Bad Request";
+    const char *error_message = "Formulaire multipart invalide";
+    MultipartParser parser(ctx->upload_boundary);
+    MultipartParser::Handler handler;
+    handler.begin = [&](const std::string & /*name*/, const std::string &filename) {
+      if (filename.empty() || file_done) {
+        return true;
+      }
+      // Nom seul: aucun chemin ni caractère de contrôle ne passe dans la commande FTP
+      std::string base = filename.substr(filename.find_last_of("/\\") + 1);
+      if (base.empty() || base == "." || base == ".." ||
+          base.find_first_of("\r\n") != std::string::npos) {
+        error_message = "Nom de fichier invalide";
+        return false;
+      }
+      std::string path = ctx->remote_path;
+      if (!path.empty() && path.back() != '/') {
+        path += '/';
+      }
+      in_file = true;
+      return session.open(path + base);
+    };
+    handler.data = [&](const uint8_t *data, size_t len) {
+      if (!in_file || session.write(data, len)) {
+        return true;
+      }
+      error_cause = ErrorCause::FTP_DATA;
+      error_status = "502 Bad Gateway";
+      error_message = "Envoi interrompu par le serveur FTP";
+      return false;
+    };
+    handler.end = [&]() {
+      if (in_file) {
+        in_file = false;
+        file_done = true;
+      }
+      return true;
+    };
+
+    bool failed = false;
+    while (remaining > 0 && !failed) {
+      int received = httpd_req_recv(req, (char *)chunk.data(), std::min(remaining, chunk.size()));
+      if (received <= 0) {
+        ESP_LOGE(TAG, "Réception du formulaire interrompue (%d)", received);
+        error_cause = received == HTTPD_SOCK_ERR_TIMEOUT ? ErrorCause::CLIENT_STALL : ErrorCause::CLIENT_SEND;
+        error_status = "408 Request Timeout";
+        error_message = "Réception du fichier interrompue";
+        failed = true;
+        break;
+      }
+      remaining -= received;
+      failed = !parser.feed(chunk.data(), received, handler);
+      ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset());
+    }
+
+    if (remaining == 0) {
+      session.set_body_read();
+    }
+    if (session.responded()) {
+      return true;  // Refus du serveur FTP, déjà signalé
+    }
+    if (!failed && !file_done) {
+      failed = true;
+      if (parser.finished()) {
+        error_message = "Aucun fichier dans le formulaire";
+      }
+    }
+    if (failed) {
+      session.fail(error_cause, error_status, error_message);
+      return true;
+    }
+  }
+
+  if (remaining == 0) {
+    session.set_body_read();
+  } else {
+    // Serveur FTP parti pendant l'envoi
+    session.fail(ErrorCause::FTP_DATA, "502 Bad Gateway", "Envoi interrompu par le serveur FTP");
+    return true;
+  }
+  session.finish();
+  return true;
+}
+
+bool FTPHTTPProxy::start_event_loop() {
+  if (!stream_mux_.init(event_loop_streams_, EVENT_LOOP_STREAM_BUFFER, HTTP_SEND_STALL_TIMEOUT_MS,
+                        &metrics_.bytes_in, &metrics_.bytes_out)) {
+    ESP_LOGE(TAG, "Échec d'initialisation de la boucle d'événements");
+    return false;
+  }
+
+  stream_handler_.first_byte = [](FileTransferContext *ctx) { record_first_byte(ctx); };
+  stream_handler_.finish = [this](FileTransferContext *ctx, FtpClient *control, StreamMultiplexer::Outcome outcome,
+                                  size_t bytes_sent, int64_t started_at) {
+    this->finish_stream(ctx, control, outcome, bytes_sent, started_at);
+  };
+
+  if (xTaskCreatePinnedToCore(event_loop_task, "stream_loop", EVENT_LOOP_STACK, this, tskIDLE_PRIORITY + 1, NULL,
+                              tskNO_AFFINITY) != pdPASS) {
+    ESP_LOGE(TAG, "Échec de création de la boucle d'événements");
+    return false;
+  }
+
+  ESP_LOGI(TAG, "Boucle d'événements: %d flux simultanés", event_loop_streams_);
+  return true;
+}
+
+void FTPHTTPProxy::event_loop_task(void* param) {
+  auto *proxy = (FTPHTTPProxy *)param;
+  while (true) {
+    proxy->stream_mux_.run_once(EVENT_LOOP_POLL_MS, proxy->stream_handler_);
+  }
+}
+
+void FTPHTTPProxy::finish_stream(FileTransferContext *ctx, FtpClient *control, StreamMultiplexer::Outcome outcome,
+                                 size_t bytes_sent, int64_t started_at) {
+  using Outcome = StreamMultiplexer::Outcome;
+
+  // Session de contrôle réutilisable seulement après un 226 sur un fichier complet
+  release_ftp_connection(control, outcome == Outcome::COMPLETE);
+
+  if (outcome == Outcome::COMPLETE || outcome == Outcome::RANGE_DONE) {
+    ESP_LOGI(TAG, "Transfert de %s terminé avec succès: %.2f KB", ctx->remote_path.c_str(), bytes_sent / 1024.0);
+    metrics_.transfers_completed.inc();
+    int64_t stream_us = esp_timer_get_time() - started_at;
+    if (stream_us > 0) {
+      metrics_.throughput_kbps.record((uint32_t)((uint64_t)bytes_sent * 1000000 / 1024 / stream_us));
+    }
+  } else {
+    ErrorCause cause = outcome == Outcome::CLIENT_STALL   ? ErrorCause::CLIENT_STALL
+                       : outcome == Outcome::CLIENT_ERROR ? ErrorCause::CLIENT_SEND
+                                                          : ErrorCause::FTP_DATA;
+    ESP_LOGW(TAG, "Transfert de %s interrompu après %u octets", ctx->remote_path.c_str(), (unsigned)bytes_sent);
+    fail_response(ctx, cause, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
+  }
+
+  httpd_req_async_handler_complete(ctx->req);
+  contexts_.release(ctx);
+}
+
+bool FTPHTTPProxy::join_shared_download(FileTransferContext *ctx, bool lead, SharedDownload *&shared) {
+  shared = nullptr;
+  std::string key = FileMetadataStore::normalize_path(ctx->remote_path);
+  xSemaphoreTake(shared_downloads_mutex_, portMAX_DELAY);
+  auto it = shared_downloads_.find(key);
+  if (it != shared_downloads_.end()) {
+    // En-têtes posés avant le rattachement: le meneur peut envoyer dès l'appel suivant
+    set_content_headers(ctx);
+    bool attached = it->second->attach(ctx, httpd_req_to_sockfd(ctx->req));
+    xSemaphoreGive(shared_downloads_mutex_);
+    if (attached) {
+      ESP_LOGI(TAG, "Téléchargement de %s rattaché à un transfert en cours", key.c_str());
+      metrics_.shared_joins.inc();
+    }
+    return attached;
+  }
+
+  if (lead) {
+    SharedDownload *download = shared_pool_.acquire();
+    if (download->init(SHARED_DOWNLOAD_WINDOW)) {
+      download->start(key);
+      shared_downloads_[key] = download;
+      shared = download;
+    } else {
+      shared_pool_.release(download);  // Pas de PSRAM disponible: transfert non partagé
+    }
+  }
+  xSemaphoreGive(shared_downloads_mutex_);
+  return false;
+}
+
+void FTPHTTPProxy::finish_shared_download(SharedDownload *shared, bool complete) {
+  // Retirer du registre d'abord: plus aucun client ne peut s'y rattacher
+  xSemaphoreTake(shared_downloads_mutex_, portMAX_DELAY);
+  shared_downloads_.erase(shared->path());
+  xSemaphoreGive(shared_downloads_mutex_);
+
+  shared->finish(complete, FOLLOWER_DRAIN_MS, follower_sink_);
+  shared_pool_.release(shared);
+}
+
+void FTPHTTPProxy::resume_detached_transfer(FileTransferContext *ctx, size_t offset) {
+  // Rien d'envoyé: transfert ordinaire; sinon reprise à l'octet atteint
+  ctx->resume_offset = ctx->headers_sent ? (int64_t)offset : -1;
+  if (xQueueSend(transfer_queue_, &ctx, 0) == pdTRUE) {
+    ESP_LOGD(TAG, "Client détaché du téléchargement partagé de %s à l'octet %u", ctx->remote_path.c_str(),
+             (unsigned)offset);
+    return;
+  }
+
+  ESP_LOGW(TAG, "File des transferts pleine, client détaché abandonné: %s", ctx->remote_path.c_str());
+  metrics_.count_error(ErrorCause::QUEUE_FULL);
+  metrics_.transfers_failed.inc();
+  if (!ctx->headers_sent) {
+    httpd_resp_set_status(ctx->req, "503 Service Unavailable");
+    httpd_resp_set_hdr(ctx->req, "Retry-After", TRANSFER_RETRY_AFTER);
+    httpd_resp_sendstr(ctx->req, "Serveur occupé, réessayez plus tard");
+  }
+  httpd_req_async_handler_complete(ctx->req);
+  contexts_.release(ctx);
+}
+
+void FTPHTTPProxy::init_memory_pools() {
+  // Un tampon circulaire par worker: le budget est partagé entre eux, avec des blocs
+  // plus petits jusqu'au minimum si la mémoire manque pour l'arène
+  size_t ring_size = TRANSFER_RING_SIZE;
+  while (ring_size > TRANSFER_RING_MIN_SIZE && ring_size * max_transfers_ > TRANSFER_MEMORY_BUDGET) {
+    ring_size /= 2;
+  }
+  while (!transfer_buffers_.init(ring_size, max_transfers_) && ring_size > TRANSFER_RING_MIN_SIZE) {
+    ring_size /= 2;
+  }
+  if (!transfer_buffers_.enabled()) {
+    ESP_LOGW(TAG, "Réserve des tampons de transfert indisponible, allocation à chaque transfert");
+  }
+
+  // Un téléchargement segmenté à pleine largeur; les suivants en ont moins ou
+  // restent ordinaires
+  if (segment_connections_ > 1 &&
+      !segment_buffers_.init(segment_size_, segment_connections_, SlabPool::Placement::PSRAM_ONLY)) {
+    ESP_LOGW(TAG, "Réserve du téléchargement segmenté indisponible, allocation à chaque transfert");
+  }
+
+  // Corps multipart (un par worker) et listings
+  scratch_buffers_.init(SCRATCH_BLOCK_SIZE, max_transfers_ + LISTING_SCRATCH_BLOCKS);
+
+  // Contextes: file d'attente, workers et flux de la boucle d'événements. Les
+  // téléchargements partagés sont menés par les workers; leur fenêtre est allouée
+  // au premier usage puis gardée.
+  contexts_.init(transfer_queue_size_ + max_transfers_ + event_loop_streams_);
+  shared_pool_.init(max_transfers_);
+
+  ESP_LOGI(TAG, "Réserves de transfert: %d tampons de %u Ko, %u blocs de travail, %u contextes", max_transfers_,
+           (unsigned)(transfer_buffers_.block_size() / 1024), (unsigned)scratch_buffers_.capacity(),
+           (unsigned)contexts_.capacity());
+}
+
+bool FTPHTTPProxy::start_transfer_workers() {
+  transfer_queue_ = xQueueCreate(transfer_queue_size_, sizeof(FileTransferContext*));
+  if (!transfer_queue_) {
+    ESP_LOGE(TAG, "Échec de création de la file des transferts");
+    return false;
+  }
+
+  // Workers créés une fois pour toutes, sans affinité de cœur
+  transfer_workers_ = new TransferWorker[max_transfers_];
+  for (int i = 0; i < max_transfers_; i++) {
+    TransferWorker &worker = transfer_workers_[i];
+    worker.proxy = this;
+    worker.reader_done = xSemaphoreCreateBinary();
+    // max_transfers_ <= 8 (schéma): un indice sur un octet garde le nom dans la limite
+    unsigned index = (uint8_t)i;
+    char name[configMAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "ftp_reader_%u", index);
+    if (!worker.reader_done ||
+        xTaskCreatePinnedToCore(ftp_reader_task, name, FTP_READER_STACK, &worker, tskIDLE_PRIORITY + 1,
+                                &worker.reader, tskNO_AFFINITY) != pdPASS) {
+      ESP_LOGE(TAG, "Échec de création du worker de transfert %d", i);
+      return false;
+    }
+    snprintf(name, sizeof(name), "file_xfer_%u", index);
+    if (xTaskCreatePinnedToCore(transfer_worker_task, name, TRANSFER_WORKER_STACK, &worker, tskIDLE_PRIORITY + 1,
+                                &worker.sender, tskNO_AFFINITY) != pdPASS) {
+      ESP_LOGE(TAG, "Échec de création du worker de transfert %d", i);
+      return false;
+    }
+  }
+
+  ESP_LOGI(TAG, "%d workers de transfert, file de %d requêtes", max_transfers_, transfer_queue_size_);
+  return true;
+}
+
+void FTPHTTPProxy::transfer_worker_task(void* param) {
+  auto *worker = (TransferWorker *)param;
+  FTPHTTPProxy *proxy = worker->proxy;
+  FileTransferContext *ctx = nullptr;
+
+  while (true) {
+    if (xQueueReceive(proxy->transfer_queue_, &ctx, portMAX_DELAY) != pdTRUE || !ctx) {
+      continue;
+    }
+
+    proxy->active_transfers_++;
+    // S'inscrire au watchdog le temps du transfert
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_add(NULL));
+
+    bool owned = ctx->upload ? run_upload(worker, ctx) : run_transfer(worker, ctx);
+
+    // Se désinscrire du watchdog et rendre la requête au serveur HTTP, sauf si
+    // elle a été confiée à un téléchargement partagé ou à la boucle d'événements
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
+    if (owned) {
+      httpd_req_async_handler_complete(ctx->req);
+      proxy->contexts_.release(ctx);
+    }
+    ctx = nullptr;
+    proxy->active_transfers_--;
+  }
+}
+
+void FTPHTTPProxy::ftp_reader_task(void* param) {
+  auto *worker = (TransferWorker *)param;
+
+  while (true) {
+    // Attendre qu'un transfert confie son pipeline à ce worker
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    TransferPipeline *pipeline = worker->pipeline.load();
+    if (!pipeline) {
+      continue;  // Notification résiduelle d'un transfert précédent
+    }
+    read_ftp_data(pipeline);
+    worker->pipeline.store(nullptr);
+    xSemaphoreGive(worker->reader_done);
+  }
+}
+
+void FTPHTTPProxy::read_ftp_data(TransferPipeline* pipeline) {
+  while (!pipeline->abort.load()) {
+    // Ne pas lire au-delà de la fin de la plage demandée
+    int64_t remaining = -1;
+    if (pipeline->limit >= 0) {
+      remaining = pipeline->limit - (int64_t)pipeline->data_bytes;
+      if (remaining <= 0) {
+        pipeline->limit_reached = true;
+        break;
+      }
+    }
+
+    // Ne pas prendre plus d'avance que ce que le client peut absorber
+    size_t buffered = pipeline->ring.size();
+    size_t fill_limit = pipeline->fill_limit.load(std::memory_order_relaxed);
+    size_t space = pipeline->ring.free_space();
+    if (space == 0 || buffered >= fill_limit) {
+      // Attendre que l'étage HTTP libère de la place
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+      continue;
+    }
+    space = std::min(space, fill_limit - buffered);
+    if (remaining >= 0 && (int64_t)space > remaining) {
+      space = (size_t)remaining;
+    }
+
+    // Réception directe dans le tampon, fin du tampon franchie en un seul appel
+    int bytes_received = pipeline->ring.recv_from(pipeline->data_sock, space, 0);
+    if (bytes_received == 0) {
+      break;  // Fin de fichier: le serveur a fermé le canal de données
+    }
+    if (bytes_received < 0) {
+      // SO_RCVTIMEO écoulé: serveur muet, ce n'est pas une fin de fichier
+      pipeline->io_error = errno == EAGAIN || errno == EWOULDBLOCK ? ETIMEDOUT : errno;
+      break;
     }
-  } else {
-    ESP_LOGW(TAG, "Pas de réponse de fin de transfert du serveur FTP");
-  }
 
-  // Nettoyage des ressources
-  if (buffer) {
-    free(buffer);
-    buffer = nullptr;
+    pipeline->ring.commit_write(bytes_received);
+    pipeline->data_bytes += bytes_received;
+    pipeline->data_counter->add(bytes_received);
+    xTaskNotifyGive(pipeline->http_task);
   }
-  
-  if (ftp_sock != -1) {
-    send(ftp_sock, "QUIT\r\n", 6, 0);
-    close(ftp_sock);
-    ftp_sock = -1;
+
+  pipeline->ftp_done.store(true, std::memory_order_release);
+  xTaskNotifyGive(pipeline->http_task);
+}
+
+int FTPHTTPProxy::probe_ftp_features(FtpClient &ftp) {
+  int features = ftp_features_.load();
+  if (features >= 0) {
+    return features;
   }
-  
-  // Finalisation de la réponse HTTP
-  if (!success) {
-    httpd_resp_send_err(ctx->req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur de transfert de fichier");
-  } else {
-    // Terminer le mode chunked
-    httpd_resp_send_chunk(ctx->req, NULL, 0);
+
+  // Détection unique des extensions du serveur (RFC 2389)
+  features = 0;
+  FtpReply reply = ftp.command("FEAT");
+  if (reply.is(FtpReply::SYSTEM_STATUS)) {
+    const std::string &text = reply.text;
+    size_t pos = 0;
+    while (pos < text.size()) {
+      size_t eol = text.find('\n', pos);
+      if (eol == std::string::npos) eol = text.size();
+      std::string line = text.substr(pos, eol - pos);
+      pos = eol + 1;
+      if (line.empty() || line[0] != ' ') {
+        continue;
+      }
+      std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return std::toupper(c); });
+      if (line.compare(1, 4, "MLST") == 0 || line.compare(1, 4, "MLSD") == 0) features |= FTP_FEATURE_MLSD;
+      if (line.compare(1, 4, "SIZE") == 0) features |= FTP_FEATURE_SIZE;
+      if (line.compare(1, 4, "MDTM") == 0) features |= FTP_FEATURE_MDTM;
+      if (line.compare(1, 11, "REST STREAM") == 0) features |= FTP_FEATURE_REST;
+    }
   }
-  
-  // Libération sécurisée du contexte
-  delete ctx;
-  
-  // Se désinscrire du watchdog avant de terminer
-  ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_delete(NULL));
-  
-  vTaskDelete(NULL);
+
+  ESP_LOGI(TAG, "Extensions FTP: MLSD=%d SIZE=%d MDTM=%d REST=%d", (features & FTP_FEATURE_MLSD) != 0,
+           (features & FTP_FEATURE_SIZE) != 0, (features & FTP_FEATURE_MDTM) != 0, (features & FTP_FEATURE_REST) != 0);
+  ftp_features_.store(features);
+  return features;
 }
 
-bool FTPHTTPProxy::list_ftp_directory(const std::string &dir_path, httpd_req_t *req) {
-  int ftp_sock = -1;
+bool FTPHTTPProxy::fetch_ftp_listing(const std::string &dir_path, const ListingParser::EntryCallback &on_entry) {
+  FtpClient *ftp = nullptr;
   int data_sock = -1;
-  char buffer[1024];
-  int data_port = 0;
-  int ip[4], port[2];
   int bytes_received;
-  std::string file_list = "[";
-  bool first_file = true;
-  
-  if (!connect_to_ftp(ftp_sock, ftp_server_.c_str(), username_.c_str(), password_.c_str())) {
-    ESP_LOGE(TAG, "Échec de connexion FTP pour lister les fichiers");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
+
+  SlabBlock buffer(scratch_buffers_);
+  if (!buffer) {
+    ESP_LOGE(TAG, "Pas de tampon pour recevoir le listing");
     return false;
   }
-  
-  send(ftp_sock, "PASV\r\n", 6, 0);
-  bytes_received = recv(ftp_sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received <= 0 || !strstr(buffer, "227 ")) {
-    close(ftp_sock);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
+
+  ftp = acquire_ftp_connection();
+  if (!ftp) {
+    ESP_LOGE(TAG, "Échec de connexion FTP pour lister les fichiers");
     return false;
   }
-  buffer[bytes_received] = '\0';
-  
-  pasv_start = strchr(buffer, '(');
-  if (!pasv_start) {
-    close(ftp_sock);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
+
+  // MLSD donne des tailles, types et dates exacts; LIST reste la solution de repli
+  bool use_mlsd = (probe_ftp_features(*ftp) & FTP_FEATURE_MLSD) != 0;
+
+  // PASV et la commande de listing partent ensemble
+  const char *list_command = use_mlsd ? "MLSD" : "LIST";
+  ftp->queue("PASV");
+  if (dir_path.empty()) {
+    ftp->queue("%s", list_command);
+  } else {
+    ftp->queue("%s %s", list_command, dir_path.c_str());
+  }
+  if (!ftp->flush()) {
+    release_ftp_connection(ftp, false);
     return false;
   }
-  
-  sscanf(pasv_start, "(%d,%d,%d,%d,%d,%d)", &ip[0], &ip[1], &ip[2], &ip[3], &port[0], &port[1]);
-  data_port = port[0] * 256 + port[1];
-  
-  data_sock = socket(AF_INET, SOCK_STREAM, 0);
+
+  data_sock = open_passive_data(ftp->read_reply(), 0);
   if (data_sock < 0) {
-    close(ftp_sock);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
+    release_ftp_connection(ftp, false);
     return false;
   }
-  
-  struct sockaddr_in data_addr;
-  memset(&data_addr, 0, sizeof(data_addr));
-  data_addr.sin_family = AF_INET;
-  data_addr.sin_port = htons(data_port);
-  
-  // Corriger la connexion au port de données en utilisant inet_addr
-  char ip_str[16];
-  snprintf(ip_str, sizeof(ip_str), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
-  data_addr.sin_addr.s_addr = inet_addr(ip_str);
-  
-  if (connect(data_sock, (struct sockaddr *)&data_addr, sizeof(data_addr)) != 0) {
-    close(ftp_sock);
+
+  FtpReply reply = ftp->read_reply();
+  if (!reply.transfer_starting()) {
     close(data_sock);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
+    if (use_mlsd && reply.type() == FtpReply::Type::PERMANENT_ERROR && !reply.is(FtpReply::FILE_UNAVAILABLE)) {
+      // MLSD annoncé mais refusé: ne plus l'utiliser et reprendre avec LIST
+      ESP_LOGW(TAG, "MLSD refusé (%d), repli sur LIST", reply.code);
+      ftp_features_.fetch_and(~FTP_FEATURE_MLSD);
+      release_ftp_connection(ftp, true);
+      return fetch_ftp_listing(dir_path, on_entry);
+    }
+    release_ftp_connection(ftp, false);
     return false;
   }
   
-  if (dir_path.empty()) {
-    send(ftp_sock, "LIST\r\n", 6, 0);
-  } else {
-    snprintf(buffer, sizeof(buffer), "LIST %s\r\n", dir_path.c_str());
-    send(ftp_sock, buffer, strlen(buffer), 0);
+  // Analyse au fil de l'eau: chaque entrée est transmise dès que sa ligne est complète
+  ListingParser parser(use_mlsd ? ListingParser::Format::MLSD : ListingParser::Format::LIST,
+                       [&](const ListingEntry &entry) {
+                         this->record_file_metadata(dir_path, entry);
+                         on_entry(entry);
+                       });
+  while ((bytes_received = recv(data_sock, buffer.data(), buffer.size(), 0)) > 0) {
+    parser.feed((const char *)buffer.data(), bytes_received);
   }
+  parser.finish();
   
-  bytes_received = recv(ftp_sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received <= 0 || (!strstr(buffer, "150 ") && !strstr(buffer, "125 "))) {
-    close(ftp_sock);
-    close(data_sock);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, "[]", 2);
-    return false;
-  }
+  close(data_sock);
   
-  char entry_buffer[2048] = {0};
+  bool listing_complete = ftp->read_reply().transfer_complete();
+  release_ftp_connection(ftp, listing_complete);
   
-  while ((bytes_received = recv(data_sock, buffer, sizeof(buffer) - 1, 0)) > 0) {
-    buffer[bytes_received] = '\0';
-    strcat(entry_buffer, buffer);
+  return listing_complete;
+}
+
+bool FTPHTTPProxy::list_ftp_directory(const std::string &dir_path, httpd_req_t *req) {
+  int64_t start = esp_timer_get_time();
+  ListingPtr cached;
+  ListingCache::State state = listing_cache_.get(dir_path, cached);
+  (state == ListingCache::State::FRESH   ? metrics_.listing_fresh
+   : state == ListingCache::State::STALE ? metrics_.listing_stale
+                                         : metrics_.listing_miss).inc();
+
+  if (state == ListingCache::State::STALE) {
+    // Servir l'entrée périmée tout de suite et la rafraîchir en arrière-plan
+    this->schedule_listing_refresh(dir_path);
   }
-  
-  char *saveptr;
-  char *line = strtok_r(entry_buffer, "\r\n", &saveptr);
-  
-  while (line) {
-    char perms[11] = {0};
-    char filename[256] = {0};
-    unsigned long size = 0;
-    
-    if (sscanf(line, "%10s %*s %*s %*s %lu %*s %*s %*s %255s", perms, &size, filename) >= 2 ||
-        sscanf(line, "%10s %*s %*s %*s %lu %*s %*s %255s", perms, &size, filename) >= 2) {
-      
-      if (strcmp(filename, ".") != 0 && strcmp(filename, "..") != 0) {
-        bool known_file = false;
-        bool is_shareable = false;
-        
-        for (const auto &file : ftp_files_) {
-          if (file.path == filename) {
-            known_file = true;
-            is_shareable = file.shareable;
-            break;
-          }
-        }
-        
-        if (!known_file) {
-          FileEntry entry;
-          entry.path = filename;
-          entry.shareable = false;
-          ftp_files_.push_back(entry);
-        }
-        
-        if (!first_file) file_list += ",";
-        first_file = false; 
-      // Corriger la détection des répertoires
-        if (perms[0] == 'd') {
-          // C'est un répertoire
-          file_list += "{\"name\":\"" + std::string(filename) + "\",";
-          file_list += "\"path\":\"" + (dir_path.empty() ? "" : dir_path + "/") + std::string(filename) + "\",";
-          file_list += "\"type\":\"directory\",";
-          file_list += "\"size\":0,";
-          file_list += "\"shareable\":false}";
-        } else {
-          // C'est un fichier
-          file_list += "{\"name\":\"" + std::string(filename) + "\",";
-          file_list += "\"path\":\"" + (dir_path.empty() ? "" : dir_path + "/") + std::string(filename) + "\",";
-          file_list += "\"type\":\"file\",";
-          file_list += "\"size\":" + std::to_string(size) + ",";
-          file_list += "\"shareable\":" + std::string(is_shareable ? "true" : "false") + "}";
-        }
+
+  bool owner = false;
+  if (state == ListingCache::State::MISS) {
+    // Un seul LIST en vol par répertoire: les autres demandeurs attendent son résultat
+    owner = listing_cache_.begin_fetch(dir_path);
+    if (!owner && listing_cache_.wait_fetch(dir_path, LISTING_FETCH_WAIT_MS)) {
+      state = listing_cache_.get(dir_path, cached);
     }
-    
-    line = strtok_r(NULL, "\r\n", &saveptr);
   }
-  
-  file_list += "]";
-  
-  close(data_sock);
-  
-  bytes_received = recv(ftp_sock, buffer, sizeof(buffer) - 1, 0);
-  
-  send(ftp_sock, "QUIT\r\n", 6, 0);
-  close(ftp_sock);
-  
-  httpd_resp_set_type(req, "application/json");
-  httpd_resp_send(req, file_list.c_str(), file_list.length());
-  
+
+  SlabBlock scratch(scratch_buffers_);
+  if (!scratch) {
+    if (owner) {
+      listing_cache_.end_fetch(dir_path);
+    }
+    return false;
+  }
+  ListingJsonWriter writer(req, dir_path, scratch.data(), scratch.size());
+
+  if (state != ListingCache::State::MISS) {
+    for (const auto &entry : *cached) {
+      if (!writer.write(entry, is_shareable(dir_path + "/" + entry.name))) {
+        break;
+      }
+    }
+    writer.finish();
+    metrics_.listing_ms.record(elapsed_ms(start));
+    return true;
+  }
+
+  // Premier demandeur, attente expirée ou listing trop gros pour le cache: le
+  // LIST est relayé au client au fil de l'analyse. Les entrées sont aussi
+  // gardées pour le cache tant que le listing reste dans sa limite.
+  auto entries = std::make_shared<Listing>();
+  bool cacheable = true;
+  bool ok = fetch_ftp_listing(dir_path, [&](const ListingEntry &entry) {
+    writer.write(entry, is_shareable(dir_path + "/" + entry.name));
+    if (cacheable) {
+      if (entries->size() < LISTING_CACHE_MAX_ENTRIES) {
+        entries->push_back(entry);
+      } else {
+        cacheable = false;
+        Listing().swap(*entries);
+      }
+    }
+  });
+
+  if (ok && cacheable) {
+    listing_cache_.put(dir_path, entries);
+  }
+  if (owner) {
+    listing_cache_.end_fetch(dir_path);
+  }
+
+  if (!ok) {
+    metrics_.count_error(ErrorCause::FTP_PROTOCOL);
+  }
+  if (!writer.started() && !ok) {
+    // Rien n'a encore été envoyé: le gestionnaire peut répondre par une erreur
+    return false;
+  }
+  if (!ok) {
+    ESP_LOGW(TAG, "Listing de %s interrompu, réponse tronquée", dir_path.empty() ? "racine" : dir_path.c_str());
+  }
+  writer.finish();
+  metrics_.listing_ms.record(elapsed_ms(start));
   return true;
 }
 
+void FTPHTTPProxy::schedule_listing_refresh(const std::string &dir_path) {
+  if (!listing_cache_.begin_fetch(dir_path)) {
+    return;  // Rafraîchissement déjà en cours
+  }
+  auto *dir = new std::string(dir_path);
+  if (xQueueSend(listing_refresh_queue_, &dir, 0) != pdTRUE) {
+    delete dir;
+    listing_cache_.end_fetch(dir_path);
+  }
+}
+
+void FTPHTTPProxy::listing_refresh_task(void* param) {
+  auto *proxy = (FTPHTTPProxy *)param;
+  std::string *dir = nullptr;
+
+  while (true) {
+    if (xQueueReceive(proxy->listing_refresh_queue_, &dir, portMAX_DELAY) != pdTRUE || !dir) {
+      continue;
+    }
+    auto entries = std::make_shared<Listing>();
+    bool cacheable = true;
+    bool ok = proxy->fetch_ftp_listing(*dir, [&](const ListingEntry &entry) {
+      if (cacheable && entries->size() < LISTING_CACHE_MAX_ENTRIES) {
+        entries->push_back(entry);
+      } else if (cacheable) {
+        cacheable = false;
+        Listing().swap(*entries);
+      }
+    });
+    if (ok && cacheable) {
+      proxy->listing_cache_.put(*dir, entries);
+    } else if (ok) {
+      proxy->listing_cache_.invalidate(*dir);  // Devenu trop gros pour le cache
+    } else {
+      ESP_LOGW(TAG, "Échec du rafraîchissement du listing de %s", dir->c_str());
+    }
+    proxy->listing_cache_.end_fetch(*dir);
+    delete dir;
+    dir = nullptr;
+  }
+}
+
 esp_err_t FTPHTTPProxy::toggle_shareable_handler(httpd_req_t *req) {
   auto *proxy = (FTPHTTPProxy *)req->user_ctx;
   
@@ -787,41 +3018,19 @@ esp_err_t FTPHTTPProxy::toggle_shareable_handler(httpd_req_t *req) {
   // Analyser le JSON (implémentation basique)
   // Format attendu: {"path": "chemin/du/fichier", "shareable": true|false}
   std::string path;
-  bool shareable = false;
-  
-  char *token = strtok(content, "{},:\"");
-  while (token) {
-    if (strcmp(token, "path") == 0) {
-      token = strtok(NULL, "{},:\"");
-      if (token) path = token;
-    } else if (strcmp(token, "shareable") == 0) {
-      token = strtok(NULL, "{},:\"");
-      if (token) shareable = (strcmp(token, "true") == 0);
-    }
-    token = strtok(NULL, "{},:\"");
-  }
+  std::string shareable_value;
+  json_field(content, "path", path);
+  bool shareable = json_field(content, "shareable", shareable_value) && shareable_value == "true";
   
   if (path.empty()) {
     httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chemin de fichier manquant");
     return ESP_FAIL;
   }
   
-  // Mettre à jour notre liste de fichiers
-  bool found = false;
-  for (auto &file : proxy->ftp_files_) {
-    if (file.path == path) {
-      file.shareable = shareable;
-      found = true;
-      break;
-    }
-  }
-  
-  if (!found) {
-    // Ajouter un nouveau fichier
-    FileEntry entry;
-    entry.path = path;
-    entry.shareable = shareable;
-    proxy->ftp_files_.push_back(entry);
+  if (!proxy->set_shareable(path, shareable)) {
+    httpd_resp_set_status(req, PERSIST_FULL_STATUS);
+    httpd_resp_sendstr(req, "Capacité de persistance atteinte");
+    return ESP_OK;
   }
   
   ESP_LOGI(TAG, "Fichier %s marqué comme %s", 
@@ -851,13 +3060,11 @@ esp_err_t FTPHTTPProxy::http_req_handler(httpd_req_t *req) {
     std::string token = requested_path.substr(6);
     
     // Chercher le token dans les partages actifs
-    for (const auto &share : proxy->active_shares_) {
-      if (share.token == token) {
-        requested_path = share.path;
-        path_valid = true;
-        ESP_LOGI(TAG, "Accès via lien de partage: %s -> %s", token.c_str(), requested_path.c_str());
-        break;
-      }
+    ShareLink share;
+    if (proxy->find_share(token, share)) {
+      requested_path = share.path;
+      path_valid = true;
+      ESP_LOGI(TAG, "Accès via lien de partage: %s -> %s", token.c_str(), requested_path.c_str());
     }
   } else {
     // Vérifier si le fichier est dans la liste des fichiers connus
@@ -871,41 +3078,76 @@ esp_err_t FTPHTTPProxy::http_req_handler(httpd_req_t *req) {
     return ESP_FAIL;
   }
 
-  // Créer le contexte de transfert
-  FileTransferContext* ctx = new FileTransferContext;
+  // Contexte de transfert pris dans le pool
+  FileTransferContext* ctx = proxy->contexts_.acquire();
   if (!ctx) {
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur mémoire");
     return ESP_FAIL;
   }
   
+  ctx->proxy = proxy;
   ctx->remote_path = requested_path;
-  ctx->req = req;
-  ctx->ftp_server = proxy->ftp_server_;
-  ctx->username = proxy->username_;
-  ctx->password = proxy->password_;
-
-  // Créer une tâche dédiée pour le transfert de fichier pour éviter le blocage
-  BaseType_t task_created = xTaskCreatePinnedToCore(
-    file_transfer_task,           // Fonction de tâche
-    "file_transfer",              // Nom de tâche
-    8192,                         // Taille de la pile
-    ctx,                          // Paramètres de la tâche
-    tskIDLE_PRIORITY + 1,         // Priorité
-    NULL,                         // Handle (non nécessaire)
-    1                             // S'exécute sur le cœur 1 (laisse le cœur 0 pour l'interface WiFi)
-  );
-
-  if (task_created != pdPASS) {
-    ESP_LOGE(TAG, "Échec de création de la tâche de transfert");
-    delete ctx;
+  ctx->accepted_at = esp_timer_get_time();
+
+  // Conserver l'en-tête Range avant de détacher la requête
+  size_t range_len = httpd_req_get_hdr_value_len(req, "Range");
+  if (range_len > 0 && range_len < 128) {
+    char range_value[128];
+    if (httpd_req_get_hdr_value_str(req, "Range", range_value, sizeof(range_value)) == ESP_OK) {
+      ctx->range_header = range_value;
+    }
+  }
+
+  // En-têtes conditionnels
+  char conditional[128];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", conditional, sizeof(conditional)) == ESP_OK) {
+    ctx->if_none_match = conditional;
+  }
+  if (httpd_req_get_hdr_value_str(req, "If-Modified-Since", conditional, sizeof(conditional)) == ESP_OK) {
+    ctx->if_modified_since = conditional;
+  }
+
+  // Détacher la requête pour qu'elle reste valide après le retour du gestionnaire
+  if (httpd_req_async_handler_begin(req, &ctx->req) != ESP_OK) {
+    ESP_LOGE(TAG, "Impossible de détacher la requête de transfert");
+    proxy->contexts_.release(ctx);
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur serveur");
     return ESP_FAIL;
   }
 
-  // La tâche dédiée va gérer le transfert et la réponse HTTP
+  // Même fichier déjà en cours de téléchargement: s'y rattacher sans occuper de worker
+  SharedDownload *shared = nullptr;
+  if (ctx->range_header.empty() && !ctx->is_conditional() && proxy->join_shared_download(ctx, false, shared)) {
+    return ESP_OK;
+  }
+
+  // Un worker du pool va gérer le transfert et la réponse HTTP
+  proxy->admit_transfer(ctx);
   return ESP_OK;
 }
 
+bool FTPHTTPProxy::admit_transfer(FileTransferContext *ctx) {
+  // Admission: refuser tout de suite si la file d'attente est pleine
+  if (xQueueSend(transfer_queue_, &ctx, 0) == pdTRUE) {
+    return true;
+  }
+  ESP_LOGW(TAG, "File des transferts pleine (%d actifs), requête refusée", active_transfers_.load());
+  metrics_.count_error(ErrorCause::QUEUE_FULL);
+  httpd_resp_set_status(ctx->req, "503 Service Unavailable");
+  httpd_resp_set_hdr(ctx->req, "Retry-After", TRANSFER_RETRY_AFTER);
+  if (ctx->upload) {
+    // Corps non lu: fermer plutôt que de le laisser passer pour une requête suivante
+    httpd_resp_set_hdr(ctx->req, "Connection", "close");
+  }
+  httpd_resp_sendstr(ctx->req, "Serveur occupé, réessayez plus tard");
+  if (ctx->upload) {
+    httpd_sess_trigger_close(ctx->req->handle, httpd_req_to_sockfd(ctx->req));
+  }
+  httpd_req_async_handler_complete(ctx->req);
+  contexts_.release(ctx);
+  return false;
+}
+
 esp_err_t FTPHTTPProxy::file_list_handler(httpd_req_t *req) {
   auto *proxy = (FTPHTTPProxy *)req->user_ctx;
   
@@ -951,18 +3193,11 @@ esp_err_t FTPHTTPProxy::share_create_handler(httpd_req_t *req) {
   // Analyser le JSON (implémentation basique)
   // Format attendu: {"path": "chemin/du/fichier", "expiry": 24}
   std::string path;
+  std::string expiry_value;
   int expiry = 24;  // Par défaut 24h
-  
-  char *token = strtok(content, "{},:\"");
-  while (token) {
-    if (strcmp(token, "path") == 0) {
-      token = strtok(NULL, "{},:\"");
-      if (token) path = token;
-    } else if (strcmp(token, "expiry") == 0) {
-      token = strtok(NULL, "{},:\"");
-      if (token) expiry = atoi(token);
-    }
-    token = strtok(NULL, "{},:\"");
+  json_field(content, "path", path);
+  if (json_field(content, "expiry", expiry_value)) {
+    expiry = atoi(expiry_value.c_str());
   }
   
   // Vérifier si le chemin est valide et partageable
@@ -976,15 +3211,12 @@ esp_err_t FTPHTTPProxy::share_create_handler(httpd_req_t *req) {
   if (expiry > 72) expiry = 72;
   
   // Créer le lien de partage
-  proxy->create_share_link(path, expiry);
-  
-  // Trouver le token du lien qu'on vient de créer
-  std::string token_str;
-  for (const auto &share : proxy->active_shares_) {
-    if (share.path == path) {
-      token_str = share.token;
-      break;
-    }
+  // Le fichier est partageable: un échec vient de la capacité de persistance
+  std::string token_str = proxy->create_share_link(path, expiry);
+  if (token_str.empty()) {
+    httpd_resp_set_status(req, PERSIST_FULL_STATUS);
+    httpd_resp_sendstr(req, "Capacité de persistance atteinte");
+    return ESP_OK;
   }
   
   // Réponse avec le lien créé
@@ -1008,12 +3240,11 @@ esp_err_t FTPHTTPProxy::share_access_handler(httpd_req_t *req) {
     std::string token = requested_path.substr(7);
     
     // Chercher le token dans les partages actifs
-    for (const auto &share : proxy->active_shares_) {
-      if (share.token == token) {
-        // Redirige vers le gestionnaire de téléchargement normal
-        // en utilisant le chemin effectif
-        return http_req_handler(req);
-      }
+    ShareLink share;
+    if (proxy->find_share(token, share)) {
+      // Redirige vers le gestionnaire de téléchargement normal
+      // en utilisant le chemin effectif
+      return http_req_handler(req);
     }
   }
   
@@ -1021,16 +3252,251 @@ esp_err_t FTPHTTPProxy::share_access_handler(httpd_req_t *req) {
   return ESP_FAIL;
 }
 
+void FTPHTTPProxy::sample_memory() {
+  size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  size_t current = min_largest_block_.load(std::memory_order_relaxed);
+  while (largest < current && !min_largest_block_.compare_exchange_weak(current, largest)) {
+  }
+}
+
+void FTPHTTPProxy::collect_gauges(MetricsGauges &gauges) {
+  this->sample_memory();
+  gauges.active_transfers = active_transfers_.load();
+  gauges.queued_transfers = transfer_queue_ ? (int)uxQueueMessagesWaiting(transfer_queue_) : 0;
+  gauges.max_transfers = max_transfers_;
+  gauges.event_loop_streams = (int)stream_mux_.active();
+  xSemaphoreTake(shared_downloads_mutex_, portMAX_DELAY);
+  gauges.shared_downloads = (int)shared_downloads_.size();
+  xSemaphoreGive(shared_downloads_mutex_);
+  gauges.content_cache_hits = content_cache_.hits();
+  gauges.content_cache_misses = content_cache_.misses();
+  gauges.content_cache_used = content_cache_.used();
+  gauges.content_cache_budget = content_cache_.budget();
+  // La mémoire interne est celle qui se fragmente et manque aux sockets
+  gauges.free_heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  gauges.min_free_heap = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  gauges.largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  gauges.min_largest_block = min_largest_block_.load();
+  gauges.free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  const SlabPool *pools[] = {&transfer_buffers_, &segment_buffers_, &scratch_buffers_, &stream_mux_.buffers()};
+  for (const SlabPool *pool : pools) {
+    gauges.pool_blocks_free += pool->available();
+    gauges.pool_blocks_total += pool->capacity();
+    gauges.pool_fallbacks += pool->fallbacks();
+  }
+  gauges.pool_fallbacks += contexts_.fallbacks() + shared_pool_.fallbacks();
+  gauges.uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+esp_err_t FTPHTTPProxy::metrics_handler(httpd_req_t *req) {
+  auto *proxy = (FTPHTTPProxy *)req->user_ctx;
+
+  // JSON par défaut; format texte Prometheus sur ?format=prometheus ou si le
+  // client le demande (Accept: text/plain, envoyé par les collecteurs)
+  bool prometheus = false;
+  char query[64];
+  char format[16];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, "format", format, sizeof(format)) == ESP_OK) {
+    prometheus = strcmp(format, "prometheus") == 0;
+  } else {
+    char accept[128];
+    prometheus = httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept)) == ESP_OK &&
+                 strstr(accept, "text/plain") != nullptr && strstr(accept, "application/json") == nullptr;
+  }
+
+  MetricsGauges gauges;
+  proxy->collect_gauges(gauges);
+  std::string body;
+  body.reserve(prometheus ? 6144 : 2048);
+  if (prometheus) {
+    proxy->metrics_.write_prometheus(body, gauges);
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+  } else {
+    proxy->metrics_.write_json(body, gauges);
+    httpd_resp_set_type(req, "application/json");
+  }
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  return httpd_resp_send(req, body.data(), body.size());
+}
+
 esp_err_t FTPHTTPProxy::static_files_handler(httpd_req_t *req) {
-  // Interface principale
-  if (strcmp(req->uri, "/") == 0 || strcmp(req->uri, "/index.html") == 0) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, HTML_INDEX, strlen(HTML_INDEX));
+  auto *proxy = (FTPHTTPProxy *)req->user_ctx;
+
+  // Chemin sans la query string; index.html est servi sous "/"
+  std::string uri = req->uri;
+  size_t query_pos = uri.find('?');
+  if (query_pos != std::string::npos) {
+    uri.erase(query_pos);
+  }
+  if (uri == "/index.html") {
+    uri = "/";
+  }
+
+  const WebAsset *asset = nullptr;
+  for (const auto &candidate : proxy->web_assets_) {
+    if (uri == candidate.uri) {
+      asset = &candidate;
+      break;
+    }
+  }
+  if (!asset) {
+    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Fichier non trouvé");
+    return ESP_FAIL;
+  }
+
+  // Revalidation systématique, mais sans retransfert tant que le contenu n'a pas changé
+  httpd_resp_set_hdr(req, "ETag", asset->etag);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+  char if_none_match[128];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+      (strstr(if_none_match, asset->etag) || strcmp(if_none_match, "*") == 0)) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_send(req, NULL, 0);
     return ESP_OK;
   }
-  
-  httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Fichier non trouvé");
-  return ESP_FAIL;
+
+  httpd_resp_set_type(req, asset->content_type);
+  httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+  httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  httpd_resp_send(req, (const char *)asset->data, asset->length);
+  return ESP_OK;
+}
+
+// Options d'un envoi passées dans l'URL: ?offset=N (reprise par REST) ou ?append=1 (APPE)
+static bool parse_upload_query(httpd_req_t *req, FileTransferContext *ctx, std::string *dir) {
+  size_t query_len = httpd_req_get_url_query_len(req) + 1;
+  if (query_len <= 1) {
+    return true;
+  }
+  std::string query(query_len, '\0');
+  if (httpd_req_get_url_query_str(req, &query[0], query_len) != ESP_OK) {
+    return true;
+  }
+  char param[256];
+  if (httpd_query_key_value(query.c_str(), "offset", param, sizeof(param)) == ESP_OK) {
+    char *end = nullptr;
+    long long offset = strtoll(param, &end, 10);
+    if (end == param || *end != '\0' || offset < 0) {
+      return false;
+    }
+    ctx->upload_offset = offset;
+  }
+  if (httpd_query_key_value(query.c_str(), "append", param, sizeof(param)) == ESP_OK) {
+    ctx->append = strcmp(param, "1") == 0 || strcmp(param, "true") == 0;
+  }
+  if (dir && httpd_query_key_value(query.c_str(), "dir", param, sizeof(param)) == ESP_OK) {
+    *dir = param;
+  }
+  // APPE ajoute à la fin: une position explicite n'a pas de sens
+  return !(ctx->append && ctx->upload_offset > 0);
+}
+
+esp_err_t FTPHTTPProxy::upload_handler(httpd_req_t *req) {
+  auto *proxy = (FTPHTTPProxy *)req->user_ctx;
+
+  // Chemin sans le premier slash ni la chaîne de requête
+  std::string remote_path = req->uri;
+  size_t query_start = remote_path.find('?');
+  if (query_start != std::string::npos) {
+    remote_path.erase(query_start);
+  }
+  if (!remote_path.empty() && remote_path[0] == '/') {
+    remote_path.erase(0, 1);
+  }
+  if (remote_path.empty() || remote_path.back() == '/') {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Nom de fichier manquant");
+    return ESP_FAIL;
+  }
+
+  // Le serveur HTTP ne décode pas le chunked: la longueur doit être annoncée
+  if (httpd_req_get_hdr_value_len(req, "Transfer-Encoding") > 0) {
+    httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length requis");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "Envoi reçu: %s (%u octets)", remote_path.c_str(), (unsigned)req->content_len);
+  return queue_upload(proxy, req, remote_path, std::string());
+}
+
+esp_err_t FTPHTTPProxy::upload_form_handler(httpd_req_t *req) {
+  auto *proxy = (FTPHTTPProxy *)req->user_ctx;
+
+  char content_type[160];
+  std::string boundary;
+  if (httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type)) != ESP_OK ||
+      !MultipartParser::parse_boundary(content_type, boundary)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Formulaire multipart/form-data attendu");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "Formulaire d'envoi reçu (%u octets)", (unsigned)req->content_len);
+  return queue_upload(proxy, req, std::string(), boundary);
+}
+
+esp_err_t FTPHTTPProxy::queue_upload(FTPHTTPProxy *proxy, httpd_req_t *req, const std::string &remote_path,
+                                     const std::string &boundary) {
+  FileTransferContext *ctx = proxy->contexts_.acquire();
+  ctx->proxy = proxy;
+  ctx->upload = true;
+  ctx->remote_path = remote_path;
+  ctx->upload_boundary = boundary;
+  ctx->accepted_at = esp_timer_get_time();
+
+  // Formulaire: répertoire de destination dans ?dir=, racine par défaut
+  std::string dir;
+  if (!parse_upload_query(req, ctx, boundary.empty() ? nullptr : &dir)) {
+    proxy->contexts_.release(ctx);
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Paramètres offset/append invalides");
+    return ESP_FAIL;
+  }
+  if (!boundary.empty()) {
+    ctx->remote_path = dir;
+  }
+
+  // Aucun retour à la ligne ne doit atteindre la connexion de contrôle
+  if (ctx->remote_path.find_first_of("\r\n") != std::string::npos) {
+    proxy->contexts_.release(ctx);
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chemin invalide");
+    return ESP_FAIL;
+  }
+
+  if (httpd_req_async_handler_begin(req, &ctx->req) != ESP_OK) {
+    ESP_LOGE(TAG, "Impossible de détacher la requête d'envoi");
+    proxy->contexts_.release(ctx);
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Erreur serveur");
+    return ESP_FAIL;
+  }
+
+  // Un worker du pool lit le corps et l'envoie au serveur FTP
+  proxy->admit_transfer(ctx);
+  return ESP_OK;
+}
+
+esp_err_t FTPHTTPProxy::uploads_handler(httpd_req_t *req) {
+  auto *proxy = (FTPHTTPProxy *)req->user_ctx;
+  int64_t now = esp_timer_get_time();
+
+  std::string body = "[";
+  xSemaphoreTake(proxy->uploads_mutex_, portMAX_DELAY);
+  for (const UploadProgress *upload : proxy->uploads_) {
+    if (body.size() > 1) {
+      body += ',';
+    }
+    body += "{\"path\":\"" + json_escape(upload->path) + "\"";
+    char tail[160];
+    snprintf(tail, sizeof(tail), ",\"offset\":%lld,\"received\":%lld,\"total\":%lld,\"elapsed_ms\":%lld}",
+             (long long)upload->offset, (long long)upload->received, (long long)upload->total,
+             (long long)((now - upload->started_at) / 1000));
+    body += tail;
+  }
+  xSemaphoreGive(proxy->uploads_mutex_);
+  body += "]";
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  return httpd_resp_send(req, body.data(), body.size());
 }
 
 void FTPHTTPProxy::setup_http_server() {
@@ -1051,11 +3517,15 @@ void FTPHTTPProxy::setup_http_server() {
   // Optimisations pour ESP-IDF 5.1.5
   config.recv_wait_timeout = 30;    // 30 secondes
   config.send_wait_timeout = 30;    // 30 secondes
-  config.max_uri_handlers = 8;        
+  config.max_uri_handlers = 12;        
   config.max_resp_headers = 16;
   config.stack_size = 8192;         // Taille de pile suffisante
   config.lru_purge_enable = true;   // Activer la purge LRU
   config.core_id = 0;               // S'exécute sur le cœur 0
+  if (event_loop_streams_ > 0) {
+    // Un socket client par flux de la boucle, plus ceux des workers et de l'interface
+    config.max_open_sockets = std::max<int>(config.max_open_sockets, event_loop_streams_ + max_transfers_ + 3);
+  }
   
   esp_err_t ret = httpd_start(&server_, &config);
   if (ret != ESP_OK) {
@@ -1071,6 +3541,14 @@ void FTPHTTPProxy::setup_http_server() {
     .user_ctx  = this
   };
   ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_static));
+
+  const httpd_uri_t uri_ui_assets = {
+    .uri       = "/ui/*",
+    .method    = HTTP_GET,
+    .handler   = static_files_handler,
+    .user_ctx  = this
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_ui_assets));
   
   const httpd_uri_t uri_files_api = {
     .uri       = "/api/files",
@@ -1096,6 +3574,30 @@ void FTPHTTPProxy::setup_http_server() {
   };
   ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_share_api));
   
+  const httpd_uri_t uri_metrics = {
+    .uri       = "/api/metrics",
+    .method    = HTTP_GET,
+    .handler   = metrics_handler,
+    .user_ctx  = this
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_metrics));
+  
+  const httpd_uri_t uri_uploads = {
+    .uri       = "/api/uploads",
+    .method    = HTTP_GET,
+    .handler   = uploads_handler,
+    .user_ctx  = this
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_uploads));
+  
+  const httpd_uri_t uri_upload_form = {
+    .uri       = "/api/upload",
+    .method    = HTTP_POST,
+    .handler   = upload_form_handler,
+    .user_ctx  = this
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_upload_form));
+  
   const httpd_uri_t uri_share_access = {
     .uri       = "/share/*",
     .method    = HTTP_GET,
@@ -1111,6 +3613,14 @@ void FTPHTTPProxy::setup_http_server() {
     .user_ctx  = this
   };
   ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_download));
+  
+  const httpd_uri_t uri_upload = {
+    .uri       = "/*",
+    .method    = HTTP_PUT,
+    .handler   = upload_handler,
+    .user_ctx  = this
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server_, &uri_upload));
 
   ESP_LOGI(TAG, "Serveur HTTP démarré avec succès sur le port %d", local_port_);
   ESP_LOGI(TAG, "Interface utilisateur accessible à http://[ip-esp]:%d/", local_port_);
@@ -2,18 +2,97 @@
 
 #include "esphome/core/component.h"
 #include <esp_http_server.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "content_cache.h"
+#include "file_metadata_store.h"
+#include "listing_cache.h"
+#include "metrics.h"
+#include "persistent_store.h"
+#include "ring_buffer.h"
+#include "share_store.h"
+#include "shared_download.h"
+#include "slab_pool.h"
+#include "stream_multiplexer.h"
+#include "web.h"
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace esphome {
 namespace ftp_http_proxy {
 
+class FTPHTTPProxy;
+
+// Contexte d'une requête de transfert, pris dans le pool du proxy et rendu en fin
+// de réponse; les identifiants FTP restent dans le proxy
 struct FileTransferContext {
+  FTPHTTPProxy* proxy{nullptr};
   std::string remote_path;
-  httpd_req_t* req;
-  std::string ftp_server;
-  std::string username;
-  std::string password;
+  httpd_req_t* req{nullptr};
+  std::string range_header;   // En-tête Range de la requête (vide si absent)
+  char content_range[64];     // Doit rester valide jusqu'à l'envoi des en-têtes
+  std::string content_disposition;  // Idem
+  int64_t resume_offset{-1};        // >= 0: reprise d'un client détaché d'un téléchargement partagé
+  bool headers_sent{false};         // Statut et en-têtes partis: une erreur ne peut plus être signalée
+  bool raw_body{false};             // Corps de longueur annoncée écrit par httpd_send(), sans chunked
+  int64_t accepted_at{0};           // Réception de la requête (µs), remis à 0 au premier octet du corps
+  std::string if_none_match;        // En-têtes conditionnels de la requête
+  std::string if_modified_since;
+  std::string etag;                 // Validateurs de la réponse, valides jusqu'à l'envoi des en-têtes
+  std::string last_modified;
+  // Envoi vers le serveur FTP (PUT, ou POST multipart vers le répertoire remote_path)
+  bool upload{false};
+  bool append{false};               // APPE: ajout à la fin du fichier distant
+  int64_t upload_offset{0};         // REST avant STOR: reprise d'un envoi interrompu
+  std::string upload_boundary;      // Frontière multipart (vide: corps brut d'un PUT)
+
+  bool is_conditional() const { return !if_none_match.empty() || !if_modified_since.empty(); }
+  // Retour au pool: valeurs initiales, les chaînes gardent leur capacité
+  void reset();
+};
+
+// État partagé entre l'étage FTP (tâche de lecture du worker) et l'étage HTTP d'un
+// transfert. Téléchargement: l'étage FTP remplit le tampon, l'étage HTTP le vide;
+// envoi vers le serveur (upload): l'inverse.
+struct TransferPipeline {
+  RingBuffer ring;
+  int data_sock{-1};
+  bool upload{false};
+  int64_t limit{-1};              // Octets à lire (-1: jusqu'à la fin du fichier)
+  Counter *data_counter{nullptr}; // Octets passés sur le socket de données
+  TaskHandle_t http_task{nullptr};
+  TaskHandle_t ftp_task{nullptr};
+  std::atomic<bool> abort{false};
+  std::atomic<bool> ftp_done{false};
+  std::atomic<bool> http_done{false};  // Upload: corps de la requête entièrement reçu
+  std::atomic<size_t> fill_limit{0};  // Avance max du producteur, ajustée au débit mesuré
+  bool limit_reached{false};
+  int io_error{0};
+  size_t data_bytes{0};
+};
+
+// Worker de transfert permanent: une tâche d'envoi HTTP et sa tâche de lecture FTP
+struct TransferWorker {
+  FTPHTTPProxy* proxy{nullptr};
+  TaskHandle_t sender{nullptr};
+  TaskHandle_t reader{nullptr};
+  SemaphoreHandle_t reader_done{nullptr};
+  std::atomic<TransferPipeline*> pipeline{nullptr};
+};
+
+// Extensions FTP détectées via FEAT
+enum FtpFeature : int {
+  FTP_FEATURE_MLSD = 1 << 0,
+  FTP_FEATURE_SIZE = 1 << 1,
+  FTP_FEATURE_MDTM = 1 << 2,
+  FTP_FEATURE_REST = 1 << 3,
 };
 
 class FTPHTTPProxy : public Component {
@@ -22,9 +101,33 @@ class FTPHTTPProxy : public Component {
   void set_username(const std::string &username) { username_ = username; }
   void set_password(const std::string &password) { password_ = password; }
   void set_local_port(int port) { local_port_ = port; }
+  void set_pool_size(int size) { ftp_pool_size_ = size; }
+  void set_max_transfers(int count) { max_transfers_ = count; }
+  void set_transfer_queue_size(int size) { transfer_queue_size_ = size; }
+  void set_event_loop_streams(int count) { event_loop_streams_ = count; }
+  void set_segment_connections(int count) { segment_connections_ = count; }
+  void set_segment_threshold(uint32_t bytes) { segment_threshold_ = bytes; }
+  void set_segment_size(uint32_t bytes) { segment_size_ = bytes; }
+  void set_listing_cache_ttl(uint32_t ttl_ms) { listing_cache_ttl_ = ttl_ms; }
+  void set_listing_cache_size(int size) { listing_cache_size_ = size; }
+  void set_file_metadata_size(int size) { file_metadata_size_ = size; }
+  void set_content_cache_size(uint32_t bytes) { content_cache_size_ = bytes; }
+  void set_content_cache_max_file(uint32_t bytes) { content_cache_max_file_ = bytes; }
+  void set_persist_partition(const std::string &label) { persist_partition_ = label; }
+  void add_web_asset(const char *uri, const char *content_type, const uint8_t *data, size_t length,
+                     const char *etag) {
+    web_assets_.push_back(WebAsset{uri, content_type, data, length, etag});
+  }
   
   bool is_shareable(const std::string &path);
-  void create_share_link(const std::string &path, int expiry_hours);
+  // false si le nouveau statut ne tiendrait plus dans la partition de persistance
+  bool set_shareable(const std::string &path, bool shareable);
+  bool get_file_metadata(const std::string &path, FileMetadata &meta);
+  // Retourne le token du lien créé (vide en cas d'échec: fichier non partageable
+  // ou partition de persistance pleine)
+  std::string create_share_link(const std::string &path, int expiry_hours);
+  bool find_share(const std::string &token, ShareLink &share);
+  ProxyMetrics &metrics() { return metrics_; }
   
   void setup() override;
   void loop() override;
@@ -37,10 +140,71 @@ class FTPHTTPProxy : public Component {
   static esp_err_t share_access_handler(httpd_req_t *req);
   static esp_err_t static_files_handler(httpd_req_t *req);
   static esp_err_t toggle_shareable_handler(httpd_req_t *req);
+  static esp_err_t metrics_handler(httpd_req_t *req);
+  static esp_err_t upload_handler(httpd_req_t *req);
+  static esp_err_t upload_form_handler(httpd_req_t *req);
+  static esp_err_t uploads_handler(httpd_req_t *req);
+  static esp_err_t queue_upload(FTPHTTPProxy *proxy, httpd_req_t *req, const std::string &remote_path,
+                                const std::string &boundary);
   
-  static void file_transfer_task(void* param);
-  bool connect_to_ftp(int& sock, const char* server, const char* username, const char* password);
+  // Pool de workers de transfert alimenté par une file bornée
+  bool start_transfer_workers();
+  static void transfer_worker_task(void* param);
+  static void ftp_reader_task(void* param);
+  // Retourne false si la requête a été rattachée à un téléchargement partagé
+  // ou confiée à la boucle d'événements
+  static bool run_transfer(TransferWorker* worker, FileTransferContext* ctx);
+  static void read_ftp_data(TransferPipeline* pipeline);
+  // Confie une requête détachée aux workers; 503 si la file est pleine
+  bool admit_transfer(FileTransferContext *ctx);
+
+  // Envois PUT/POST vers le serveur FTP, sur les mêmes workers que les téléchargements
+  class UploadSession;
+  static bool run_upload(TransferWorker* worker, FileTransferContext* ctx);
+  static void write_ftp_data(TransferPipeline* pipeline);
+  // Tampons et contextes des transferts, alloués une fois au démarrage
+  void init_memory_pools();
+
+  // Boucle d'événements optionnelle pour la phase d'envoi des transferts
+  bool start_event_loop();
+  static void event_loop_task(void* param);
+  void finish_stream(FileTransferContext *ctx, FtpClient *control, StreamMultiplexer::Outcome outcome,
+                     size_t bytes_sent, int64_t started_at);
+  bool connect_to_ftp(FtpClient &ftp, const char* server, const char* username, const char* password);
   bool list_ftp_directory(const std::string &remote_dir, httpd_req_t *req);
+  int probe_ftp_features(FtpClient &ftp);
+  bool fetch_ftp_listing(const std::string &remote_dir, const std::function<void(const ListingEntry &)> &on_entry);
+  void schedule_listing_refresh(const std::string &remote_dir);
+  void record_file_metadata(const std::string &remote_dir, const ListingEntry &entry);
+
+  // Persistance des partages et statuts de partage
+  void restore_persistent_state();
+  void activate_restored_shares();
+  void persist_state();
+  // L'état persisté tiendrait-il avec ce partage et/ou ce statut en plus (vide: aucun)
+  bool persisted_state_fits(const std::string &share_path, const std::string &flag_path);
+  static void listing_refresh_task(void* param);
+
+  // Téléchargements complets partagés entre clients demandant le même fichier
+  class SharedDownloadLease;
+  // Gros fichiers: blocs récupérés en parallèle sur plusieurs sessions du pool
+  class SegmentedTransfer;
+  bool join_shared_download(FileTransferContext *ctx, bool lead, SharedDownload *&shared);
+  void finish_shared_download(SharedDownload *shared, bool complete);
+  void resume_detached_transfer(FileTransferContext *ctx, size_t offset);
+
+  // Métriques: relevé périodique de la mémoire et valeurs instantanées pour l'export
+  void sample_memory();
+  void collect_gauges(MetricsGauges &gauges);
+
+  // Pool de connexions de contrôle FTP déjà authentifiées
+  // Le client prêté reste celui de la session, de l'authentification à la remise:
+  // les octets déjà reçus ne sont jamais perdus. nullptr si aucune session.
+  // wait: attendre qu'une session se libère, sinon échec immédiat
+  FtpClient *acquire_ftp_connection(bool wait = true);
+  void release_ftp_connection(FtpClient *ftp, bool reusable);
+  static void ftp_pool_warm_task(void* param);
+  void maintain_ftp_pool();
 
   std::string ftp_server_;
   std::string username_;
@@ -48,23 +212,93 @@ class FTPHTTPProxy : public Component {
   int local_port_{8080};
   int sock_{-1};
   httpd_handle_t server_{nullptr};
+  std::vector<WebAsset> web_assets_;
   bool delayed_setup_{false};
-  
-  // Structure pour le partage de fichiers
-  struct ShareLink {
-    std::string path;
-    std::string token;
-    int64_t expiry;  // Timestamp d'expiration
+
+  struct PooledConnection {
+    FtpClient ftp;             // Socket -1 tant que la session n'est pas ouverte
+    bool in_use{false};
+    bool noop_pending{false};  // Réponse au NOOP de maintien pas encore lue
+    int64_t last_used{0};      // Dernière activité (µs, esp_timer)
   };
-  
-  struct FileEntry {
+
+  bool drain_ftp_replies(PooledConnection &conn);
+
+  std::vector<PooledConnection> ftp_pool_;
+  int ftp_pool_size_{2};
+  SemaphoreHandle_t ftp_pool_mutex_{nullptr};
+  SemaphoreHandle_t ftp_pool_slots_{nullptr};
+  int64_t last_pool_maintenance_{0};
+  std::atomic<int> ftp_features_{-1};  // Masque FtpFeature, -1 tant que FEAT n'a pas été envoyé
+
+  int max_transfers_{3};
+  int transfer_queue_size_{8};
+  TransferWorker* transfer_workers_{nullptr};
+  QueueHandle_t transfer_queue_{nullptr};
+  std::atomic<int> active_transfers_{0};
+
+  // Téléchargement segmenté (désactivé avec une seule session)
+  int segment_connections_{1};
+  uint32_t segment_threshold_{8 * 1024 * 1024};
+  uint32_t segment_size_{256 * 1024};
+
+  // Envois en cours, pour le suivi de progression (/api/uploads)
+  struct UploadProgress {
     std::string path;
-    bool shareable;
+    int64_t offset{0};      // Position de départ dans le fichier distant
+    int64_t received{0};
+    int64_t total{-1};      // Corps annoncé par le client
+    int64_t started_at{0};  // µs
   };
+  std::vector<UploadProgress*> uploads_;
+  SemaphoreHandle_t uploads_mutex_{nullptr};
+
+  // Flux servis sans tâche dédiée (désactivé si nul)
+  StreamMultiplexer stream_mux_;
+  StreamMultiplexer::Handler stream_handler_;
+  int event_loop_streams_{0};
+
+  // Cache des listings, rafraîchi en arrière-plan
+  ListingCache listing_cache_;
+  uint32_t listing_cache_ttl_{30000};
+  int listing_cache_size_{16};
+  QueueHandle_t listing_refresh_queue_{nullptr};
+
+  std::unordered_map<std::string, SharedDownload*> shared_downloads_;
+  SemaphoreHandle_t shared_downloads_mutex_{nullptr};
+  SharedDownload::Sink follower_sink_;
+
+  // Copies locales des fichiers souvent demandés (désactivé si taille nulle)
+  ContentCache content_cache_;
+  uint32_t content_cache_size_{0};
+  uint32_t content_cache_max_file_{1024 * 1024};
+
+  ProxyMetrics metrics_;
+  std::atomic<size_t> min_largest_block_{SIZE_MAX};  // Plus petit plus grand bloc interne relevé
+  int64_t last_memory_sample_{0};
+
+  // Mémoire des transferts, prise et rendue sans passer par le tas
+  SlabPool transfer_buffers_;  // Tampons circulaires, un par worker
+  SlabPool segment_buffers_;   // Blocs du téléchargement segmenté
+  SlabPool scratch_buffers_;   // Corps multipart et listings
+  ObjectPool<FileTransferContext> contexts_;
+  ObjectPool<SharedDownload> shared_pool_;
   
-  // Stockage des fichiers et paramètres de partage en mémoire
-  std::vector<FileEntry> ftp_files_;
-  std::vector<ShareLink> active_shares_;
+  // Métadonnées et statut de partage des fichiers, par chemin complet normalisé
+  FileMetadataStore file_metadata_;
+  int file_metadata_size_{2048};
+  SemaphoreHandle_t file_metadata_mutex_{nullptr};
+
+  // Partages actifs; partagés entre le serveur HTTP et la boucle principale
+  ShareStore active_shares_;
+  SemaphoreHandle_t shares_mutex_{nullptr};
+  std::atomic<int64_t> next_share_expiry_{INT64_MAX};
+
+  PersistentStore persistent_store_;
+  std::string persist_partition_{"ftp_proxy"};
+  // Partages rechargés (échéance en secondes Unix), activés dès que l'horloge est à l'heure
+  std::vector<ShareLink> restored_shares_;
+  int64_t last_persist_flush_{0};
 };
 
 }  // namespace ftp_http_proxy
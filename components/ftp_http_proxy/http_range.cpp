@@ -0,0 +1,45 @@
+#include "http_range.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+int parse_range_header(const std::string &header, int64_t file_size, int64_t &start, int64_t &end) {
+  if (header.compare(0, 6, "bytes=") != 0 || header.find(',') != std::string::npos) {
+    return 0;
+  }
+
+  const char *spec = header.c_str() + 6;
+  while (*spec == ' ') spec++;
+  char *endp = nullptr;
+
+  if (*spec == '-') {
+    // Plage suffixe: les N derniers octets
+    if (!isdigit((unsigned char)spec[1])) return 0;
+    int64_t suffix = strtoll(spec + 1, &endp, 10);
+    if (*endp != '\0') return 0;
+    if (suffix <= 0 || file_size <= 0) return -1;
+    start = suffix >= file_size ? 0 : file_size - suffix;
+    end = file_size - 1;
+    return 1;
+  }
+
+  if (!isdigit((unsigned char)*spec)) return 0;
+  start = strtoll(spec, &endp, 10);
+  if (*endp != '-') return 0;
+  const char *last = endp + 1;
+  if (*last == '\0') {
+    end = file_size - 1;
+  } else {
+    if (!isdigit((unsigned char)*last)) return 0;
+    end = strtoll(last, &endp, 10);
+    if (*endp != '\0' || end < start) return 0;
+    if (end >= file_size) end = file_size - 1;
+  }
+
+  return start < file_size ? 1 : -1;
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
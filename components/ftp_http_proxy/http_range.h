@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Analyse un en-tête "Range: bytes=..." pour un fichier de taille connue.
+// Retourne 1 si une plage valide est demandée, 0 si l'en-tête doit être ignoré
+// (absent, malformé ou multi-plages) et -1 si la plage n'est pas satisfaisable.
+// Les positions trop grandes pour un int64_t sont plafonnées: "bytes=N-" au-delà
+// de la fin n'est pas satisfaisable, un suffixe démesuré couvre tout le fichier.
+int parse_range_header(const std::string &header, int64_t file_size, int64_t &start, int64_t &end);
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
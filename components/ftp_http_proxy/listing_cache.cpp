@@ -0,0 +1,127 @@
+#include "listing_cache.h"
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+static const unsigned MAX_FETCH_WAITERS = 16;
+
+bool ListingCache::init(size_t max_dirs, size_t max_entries, uint32_t ttl_ms, uint32_t stale_ms) {
+  max_dirs_ = max_dirs;
+  max_entries_ = max_entries;
+  ttl_us_ = (int64_t)ttl_ms * 1000;
+  stale_us_ = (int64_t)stale_ms * 1000;
+  return mutex_.init();
+}
+
+ListingCache::State ListingCache::get(const std::string &dir, ListingPtr &listing) {
+  mutex_.lock();
+  auto it = index_.find(dir);
+  if (it == index_.end()) {
+    mutex_.unlock();
+    return State::MISS;
+  }
+
+  int64_t age = platform::monotonic_us() - it->second->fetched_at;
+  if (age > stale_us_) {
+    mutex_.unlock();
+    return State::MISS;
+  }
+
+  // Remonter l'entrée en tête de la liste LRU
+  lru_.splice(lru_.begin(), lru_, it->second);
+  listing = it->second->listing;
+  mutex_.unlock();
+  return age > ttl_us_ ? State::STALE : State::FRESH;
+}
+
+void ListingCache::put(const std::string &dir, ListingPtr listing) {
+  // Un listing plus gros que tout le cache n'y entre pas
+  if (listing->size() > max_entries_) {
+    invalidate(dir);
+    return;
+  }
+
+  mutex_.lock();
+  auto it = index_.find(dir);
+  if (it != index_.end()) {
+    total_entries_ -= it->second->listing->size();
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_.push_front(Node{dir, listing, platform::monotonic_us()});
+  index_[dir] = lru_.begin();
+  total_entries_ += listing->size();
+  evict_if_needed();
+  mutex_.unlock();
+}
+
+void ListingCache::invalidate(const std::string &dir) {
+  mutex_.lock();
+  auto it = index_.find(dir);
+  if (it != index_.end()) {
+    total_entries_ -= it->second->listing->size();
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  mutex_.unlock();
+}
+
+void ListingCache::evict_if_needed() {
+  while (!lru_.empty() && (lru_.size() > max_dirs_ || total_entries_ > max_entries_)) {
+    Node &oldest = lru_.back();
+    total_entries_ -= oldest.listing->size();
+    index_.erase(oldest.dir);
+    lru_.pop_back();
+  }
+}
+
+bool ListingCache::begin_fetch(const std::string &dir) {
+  mutex_.lock();
+  if (in_flight_.count(dir)) {
+    mutex_.unlock();
+    return false;
+  }
+  auto flight = std::make_shared<InFlight>();
+  if (!flight->done.init(MAX_FETCH_WAITERS, 0)) {
+    // Sans sémaphore, l'appelant récupère simplement le listing sans regroupement
+    mutex_.unlock();
+    return true;
+  }
+  in_flight_[dir] = flight;
+  mutex_.unlock();
+  return true;
+}
+
+void ListingCache::end_fetch(const std::string &dir) {
+  mutex_.lock();
+  auto it = in_flight_.find(dir);
+  if (it != in_flight_.end()) {
+    // Réveiller chaque appelant en attente; le sémaphore est libéré avec la dernière référence
+    for (int i = 0; i < it->second->waiters; i++) {
+      it->second->done.give();
+    }
+    in_flight_.erase(it);
+  }
+  mutex_.unlock();
+}
+
+bool ListingCache::wait_fetch(const std::string &dir, uint32_t timeout_ms) {
+  mutex_.lock();
+  auto it = in_flight_.find(dir);
+  if (it == in_flight_.end()) {
+    mutex_.unlock();
+    return true;
+  }
+  std::shared_ptr<InFlight> flight = it->second;
+  if (flight->waiters >= (int)MAX_FETCH_WAITERS) {
+    mutex_.unlock();
+    return false;
+  }
+  flight->waiters++;
+  mutex_.unlock();
+
+  return flight->done.take(timeout_ms);
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
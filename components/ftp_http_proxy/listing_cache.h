@@ -0,0 +1,73 @@
+#pragma once
+
+#include "platform.h"
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Entrée d'un listing FTP déjà analysé
+struct ListingEntry {
+  std::string name;
+  bool is_dir{false};
+  uint64_t size{0};
+  int64_t mtime{0};     // Dernière modification (secondes Unix UTC, 0 si inconnue)
+  bool exact_mtime{false};  // Date MLSD à la seconde (celle d'un LIST est approximative)
+  std::string unique;   // Fait MLSD "unique" (vide si non fourni)
+};
+
+using Listing = std::vector<ListingEntry>;
+using ListingPtr = std::shared_ptr<const Listing>;
+
+// Cache LRU des listings par répertoire, avec durée de vie, service des entrées
+// périmées pendant leur rafraîchissement et regroupement des LIST concurrents.
+class ListingCache {
+ public:
+  enum class State { MISS, FRESH, STALE };
+
+  bool init(size_t max_dirs, size_t max_entries, uint32_t ttl_ms, uint32_t stale_ms);
+
+  // Cherche un listing; une entrée trop ancienne même pour être servie périmée est un MISS
+  State get(const std::string &dir, ListingPtr &listing);
+  void put(const std::string &dir, ListingPtr listing);
+  void invalidate(const std::string &dir);
+
+  // Un seul LIST en vol par répertoire: begin_fetch() retourne true pour
+  // l'appelant chargé de la récupération, les autres attendent avec wait_fetch().
+  bool begin_fetch(const std::string &dir);
+  void end_fetch(const std::string &dir);
+  bool wait_fetch(const std::string &dir, uint32_t timeout_ms);
+
+ private:
+  struct Node {
+    std::string dir;
+    ListingPtr listing;
+    int64_t fetched_at;  // µs
+  };
+
+  struct InFlight {
+    platform::Semaphore done;
+    int waiters{0};
+  };
+
+  void evict_if_needed();
+
+  platform::Mutex mutex_;
+  std::list<Node> lru_;  // Le plus récent en tête
+  std::unordered_map<std::string, std::list<Node>::iterator> index_;
+  std::map<std::string, std::shared_ptr<InFlight>> in_flight_;
+  size_t max_dirs_{16};
+  size_t max_entries_{2048};
+  size_t total_entries_{0};
+  int64_t ttl_us_{0};
+  int64_t stale_us_{0};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,244 @@
+#include "listing_parser.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+static const int MAX_LIST_TOKENS = 12;
+
+// Nombre de jours depuis le 1970-01-01 (calendrier grégorien proleptique)
+static int64_t days_from_civil(int year, int month, int day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t yoe = year - era * 400;
+  int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static int64_t make_epoch(int year, int month, int day, int hour, int minute, int second) {
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return 0;
+  }
+  return days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+static int parse_month_name(const char *token) {
+  static const char *const MONTHS[] = {"jan", "feb", "mar", "apr", "may", "jun",
+                                       "jul", "aug", "sep", "oct", "nov", "dec"};
+  for (int i = 0; i < 12; i++) {
+    if (strncasecmp(token, MONTHS[i], 3) == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static bool is_number(const char *token, size_t len) {
+  if (len == 0) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (!isdigit((unsigned char)token[i])) return false;
+  }
+  return true;
+}
+
+void ListingParser::feed(const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    if (c == '\n' || c == '\r') {
+      if (!overflow_ && len_ > 0) {
+        process_line();
+      }
+      len_ = 0;
+      overflow_ = false;
+      continue;
+    }
+    if (len_ + 1 >= sizeof(line_)) {
+      overflow_ = true;
+      continue;
+    }
+    if (!overflow_) {
+      line_[len_++] = c;
+    }
+  }
+}
+
+void ListingParser::finish() {
+  if (!overflow_ && len_ > 0) {
+    process_line();
+  }
+  len_ = 0;
+  overflow_ = false;
+}
+
+void ListingParser::process_line() {
+  line_[len_] = '\0';
+  ListingEntry entry;
+  bool parsed = format_ == Format::MLSD ? parse_mlsd_line(line_, entry) : parse_list_line(line_, entry);
+  if (parsed && entry.name != "." && entry.name != "..") {
+    callback_(entry);
+  }
+}
+
+int64_t ListingParser::parse_ftp_timestamp(const char *value) {
+  int year, month, day, hour, minute, second;
+  if (strlen(value) < 14 || sscanf(value, "%4d%2d%2d%2d%2d%2d", &year, &month, &day, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+  return make_epoch(year, month, day, hour, minute, second);
+}
+
+bool ListingParser::parse_mlsd_line(const char *line, ListingEntry &entry) {
+  // Les faits se terminent au premier espace; le nom peut lui-même contenir des espaces
+  const char *name = strchr(line, ' ');
+  if (!name || name[1] == '\0') {
+    return false;
+  }
+
+  bool has_type = false;
+  const char *fact = line;
+  while (fact < name) {
+    const char *fact_end = (const char *)memchr(fact, ';', name - fact);
+    if (!fact_end) fact_end = name;
+    const char *eq = (const char *)memchr(fact, '=', fact_end - fact);
+    if (eq) {
+      size_t key_len = eq - fact;
+      const char *value = eq + 1;
+      size_t value_len = fact_end - value;
+
+      if (key_len == 4 && strncasecmp(fact, "type", 4) == 0) {
+        // cdir/pdir désignent le répertoire courant et son parent
+        if ((value_len == 4 && strncasecmp(value, "cdir", 4) == 0) ||
+            (value_len == 4 && strncasecmp(value, "pdir", 4) == 0)) {
+          return false;
+        }
+        entry.is_dir = value_len == 3 && strncasecmp(value, "dir", 3) == 0;
+        has_type = true;
+      } else if (key_len == 4 && strncasecmp(fact, "size", 4) == 0) {
+        entry.size = strtoull(value, nullptr, 10);
+      } else if (key_len == 6 && strncasecmp(fact, "modify", 6) == 0) {
+        char stamp[24];
+        size_t n = value_len < sizeof(stamp) - 1 ? value_len : sizeof(stamp) - 1;
+        memcpy(stamp, value, n);
+        stamp[n] = '\0';
+        entry.mtime = parse_ftp_timestamp(stamp);
+        entry.exact_mtime = entry.mtime != 0;
+      } else if (key_len == 6 && strncasecmp(fact, "unique", 6) == 0) {
+        entry.unique.assign(value, value_len);
+      }
+    }
+    fact = fact_end + 1;
+  }
+
+  entry.name = name + 1;
+  if (entry.is_dir) {
+    entry.size = 0;
+  }
+  return has_type;
+}
+
+bool ListingParser::parse_list_line(const char *line, ListingEntry &entry) {
+  // Découpage en jetons en gardant leur position pour récupérer le nom intact
+  const char *tokens[MAX_LIST_TOKENS];
+  size_t lengths[MAX_LIST_TOKENS];
+  int count = 0;
+  const char *p = line;
+  while (*p && count < MAX_LIST_TOKENS) {
+    while (*p == ' ' || *p == '\t') p++;
+    if (!*p) break;
+    tokens[count] = p;
+    while (*p && *p != ' ' && *p != '\t') p++;
+    lengths[count] = p - tokens[count];
+    count++;
+  }
+  if (count < 4) {
+    return false;
+  }
+
+  // Format DOS/IIS: "01-15-24  10:30AM  <DIR>  Nom" ou "01-15-24  10:30AM  1234  Nom"
+  int dos_month, dos_day, dos_year, dos_hour, dos_minute;
+  char ampm[3] = {0};
+  if (isdigit((unsigned char)tokens[0][0]) &&
+      sscanf(tokens[0], "%d-%d-%d", &dos_month, &dos_day, &dos_year) == 3 &&
+      sscanf(tokens[1], "%d:%d%2s", &dos_hour, &dos_minute, ampm) >= 2) {
+    if (lengths[2] == 5 && strncmp(tokens[2], "<DIR>", 5) == 0) {
+      entry.is_dir = true;
+      entry.size = 0;
+    } else if (is_number(tokens[2], lengths[2])) {
+      entry.is_dir = false;
+      entry.size = strtoull(tokens[2], nullptr, 10);
+    } else {
+      return false;
+    }
+    if (dos_year < 70) dos_year += 2000;
+    else if (dos_year < 100) dos_year += 1900;
+    if (strncasecmp(ampm, "PM", 2) == 0 && dos_hour < 12) dos_hour += 12;
+    if (strncasecmp(ampm, "AM", 2) == 0 && dos_hour == 12) dos_hour = 0;
+    entry.mtime = make_epoch(dos_year, dos_month, dos_day, dos_hour, dos_minute, 0);
+    entry.name = tokens[3];
+    return !entry.name.empty();
+  }
+
+  // Format Unix: permissions, liens, propriétaire, [groupe,] taille, trois jetons de date, nom.
+  // Le groupe est absent sur certains serveurs; la taille est repérée comme le jeton
+  // numérique suivi d'assez de jetons pour la date et le nom.
+  if (strchr("-dlbcps", tokens[0][0]) == nullptr || lengths[0] < 10) {
+    return false;
+  }
+  int size_index = -1;
+  if (count >= 9 && is_number(tokens[4], lengths[4])) {
+    size_index = 4;
+  } else if (count >= 8 && is_number(tokens[3], lengths[3])) {
+    size_index = 3;
+  }
+  if (size_index < 0) {
+    return false;
+  }
+
+  int name_index = size_index + 4;
+  if (name_index >= count) {
+    return false;
+  }
+
+  entry.is_dir = tokens[0][0] == 'd';
+  entry.size = entry.is_dir ? 0 : strtoull(tokens[size_index], nullptr, 10);
+  entry.name = tokens[name_index];  // Le reste de la ligne, espaces compris
+
+  // Lien symbolique: "nom -> cible"
+  if (tokens[0][0] == 'l') {
+    size_t arrow = entry.name.find(" -> ");
+    if (arrow != std::string::npos) {
+      entry.name.erase(arrow);
+    }
+  }
+
+  // Date "Mon JJ HH:MM" ou "Mon JJ AAAA"; les dates localisées restent sans horodatage
+  int month = parse_month_name(tokens[size_index + 1]);
+  int day = atoi(tokens[size_index + 2]);
+  const char *when = tokens[size_index + 3];
+  if (month > 0 && day > 0) {
+    int hour = 0, minute = 0;
+    if (sscanf(when, "%d:%d", &hour, &minute) == 2) {
+      // Sans année: les douze derniers mois
+      time_t now = time(nullptr);
+      struct tm now_tm;
+      gmtime_r(&now, &now_tm);
+      int year = now_tm.tm_year + 1900;
+      if (now_tm.tm_year >= 100 && month > now_tm.tm_mon + 1) {
+        year--;
+      }
+      entry.mtime = make_epoch(year, month, day, hour, minute, 0);
+    } else {
+      entry.mtime = make_epoch(atoi(when), month, day, 0, 0, 0);
+    }
+  }
+
+  return !entry.name.empty();
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "listing_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Analyseur incrémental du flux de données d'un LIST ou d'un MLSD: les lignes
+// sont reconstituées à travers les frontières des recv() et chaque entrée est
+// transmise au rappel dès qu'elle est complète, en mémoire constante.
+class ListingParser {
+ public:
+  enum class Format { LIST, MLSD };
+  using EntryCallback = std::function<void(const ListingEntry &)>;
+
+  ListingParser(Format format, EntryCallback callback) : format_(format), callback_(std::move(callback)) {}
+
+  void feed(const char *data, size_t len);
+  // Traite une éventuelle dernière ligne sans fin de ligne
+  void finish();
+
+  // Ligne MLSD: "fact=valeur;fact=valeur; nom" (RFC 3659)
+  static bool parse_mlsd_line(const char *line, ListingEntry &entry);
+  // Ligne LIST au format Unix (ls -l) ou DOS/IIS
+  static bool parse_list_line(const char *line, ListingEntry &entry);
+  // Horodatage MLSD/MDTM "YYYYMMDDHHMMSS[.sss]" (UTC) en secondes Unix, 0 si invalide
+  static int64_t parse_ftp_timestamp(const char *value);
+
+ private:
+  void process_line();
+
+  Format format_;
+  EntryCallback callback_;
+  char line_[1024];
+  size_t len_{0};
+  bool overflow_{false};  // Ligne trop longue: ignorée jusqu'à la fin de ligne
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,219 @@
+#include "metrics.h"
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Bornes des histogrammes (ms, sauf débit en Ko/s)
+static const uint32_t FTP_LATENCY_BOUNDS_MS[] = {5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+static const uint32_t TTFB_BOUNDS_MS[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+static const uint32_t LISTING_BOUNDS_MS[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+static const uint32_t THROUGHPUT_BOUNDS_KBPS[] = {16, 64, 128, 256, 512, 768, 1024, 1536, 2048, 3072, 4096};
+
+template<size_t N> static constexpr size_t bound_count(const uint32_t (&)[N]) { return N; }
+
+static const char *const ERROR_CAUSE_NAMES[] = {
+    "ftp_connect", "ftp_protocol", "not_found", "ftp_data", "client_send", "client_stall", "out_of_memory", "queue_full",
+};
+static_assert(sizeof(ERROR_CAUSE_NAMES) / sizeof(ERROR_CAUSE_NAMES[0]) == (size_t)ErrorCause::COUNT,
+              "Nom manquant pour une cause d'erreur");
+
+uint64_t Counter::value() const {
+  uint32_t high, low;
+  do {
+    high = high_.load(std::memory_order_relaxed);
+    low = low_.load(std::memory_order_relaxed);
+  } while (high != high_.load(std::memory_order_relaxed));
+  return ((uint64_t)high << 32) | low;
+}
+
+Histogram::Histogram(const uint32_t *bounds, size_t count)
+    : bounds_(bounds), bound_count_(count < MAX_BOUNDS ? count : MAX_BOUNDS) {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::record(uint32_t value) {
+  size_t i = 0;
+  while (i < bound_count_ && value > bounds_[i]) {
+    i++;
+  }
+  buckets_[i].fetch_add(1, std::memory_order_relaxed);
+  count_.inc();
+  sum_.add(value);
+}
+
+ProxyMetrics::ProxyMetrics()
+    : ftp_login_ms(FTP_LATENCY_BOUNDS_MS, bound_count(FTP_LATENCY_BOUNDS_MS)),
+      pasv_ms(FTP_LATENCY_BOUNDS_MS, bound_count(FTP_LATENCY_BOUNDS_MS)),
+      retr_ms(FTP_LATENCY_BOUNDS_MS, bound_count(FTP_LATENCY_BOUNDS_MS)),
+      ttfb_ms(TTFB_BOUNDS_MS, bound_count(TTFB_BOUNDS_MS)),
+      listing_ms(LISTING_BOUNDS_MS, bound_count(LISTING_BOUNDS_MS)),
+      throughput_kbps(THROUGHPUT_BOUNDS_KBPS, bound_count(THROUGHPUT_BOUNDS_KBPS)) {}
+
+static void append_format(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void append_format(std::string &out, const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (len > 0) {
+    out.append(buffer, (size_t)len < sizeof(buffer) ? len : sizeof(buffer) - 1);
+  }
+}
+
+static double ratio(uint64_t hits, uint64_t total) { return total ? (double)hits / total : 0.0; }
+
+static void json_histogram(std::string &out, const char *name, const Histogram &histogram) {
+  append_format(out, "\"%s\":{\"bounds\":[", name);
+  for (size_t i = 0; i < histogram.bound_count(); i++) {
+    append_format(out, "%s%" PRIu32, i ? "," : "", histogram.bound(i));
+  }
+  out += "],\"buckets\":[";
+  for (size_t i = 0; i <= histogram.bound_count(); i++) {
+    append_format(out, "%s%" PRIu32, i ? "," : "", histogram.bucket(i));
+  }
+  append_format(out, "],\"count\":%" PRIu64 ",\"sum\":%" PRIu64 "}", histogram.count(), histogram.sum());
+}
+
+void ProxyMetrics::write_json(std::string &out, const MetricsGauges &g) const {
+  uint64_t listing_total = listing_fresh.value() + listing_stale.value() + listing_miss.value();
+  uint32_t content_total = g.content_cache_hits + g.content_cache_misses;
+
+  append_format(out, "{\"uptime_s\":%" PRIu32 ",", g.uptime_s);
+  append_format(out, "\"transfers\":{\"active\":%d,\"queued\":%d,\"max\":%d,\"shared_downloads\":%d,"
+                "\"event_loop\":%d,",
+                g.active_transfers, g.queued_transfers, g.max_transfers, g.shared_downloads, g.event_loop_streams);
+  append_format(out, "\"completed\":%" PRIu64 ",\"failed\":%" PRIu64 ",\"shared_joins\":%" PRIu64
+                ",\"not_modified\":%" PRIu64 "},",
+                transfers_completed.value(), transfers_failed.value(), shared_joins.value(), not_modified.value());
+  append_format(out, "\"uploads\":{\"completed\":%" PRIu64 ",\"failed\":%" PRIu64 "},", uploads_completed.value(),
+                uploads_failed.value());
+  append_format(out, "\"bytes\":{\"in\":%" PRIu64 ",\"out\":%" PRIu64 ",\"uploaded\":%" PRIu64 "},", bytes_in.value(),
+                bytes_out.value(), bytes_uploaded.value());
+  append_format(out, "\"cache\":{\"content\":{\"hits\":%" PRIu32 ",\"misses\":%" PRIu32 ",\"hit_ratio\":%.3f,"
+                "\"used\":%u,\"budget\":%u},",
+                g.content_cache_hits, g.content_cache_misses, ratio(g.content_cache_hits, content_total),
+                (unsigned)g.content_cache_used, (unsigned)g.content_cache_budget);
+  append_format(out, "\"listing\":{\"fresh\":%" PRIu64 ",\"stale\":%" PRIu64 ",\"miss\":%" PRIu64
+                ",\"hit_ratio\":%.3f}},",
+                listing_fresh.value(), listing_stale.value(), listing_miss.value(),
+                ratio(listing_fresh.value() + listing_stale.value(), listing_total));
+
+  out += "\"errors\":{";
+  for (size_t i = 0; i < (size_t)ErrorCause::COUNT; i++) {
+    append_format(out, "%s\"%s\":%" PRIu64, i ? "," : "", ERROR_CAUSE_NAMES[i], errors_[i].value());
+  }
+  out += "},";
+
+  append_format(out, "\"memory\":{\"free_heap\":%u,\"min_free_heap\":%u,\"largest_block\":%u,"
+                "\"min_largest_block\":%u,\"free_psram\":%u,\"pool\":{\"free\":%u,\"total\":%u,"
+                "\"fallbacks\":%" PRIu32 "}},",
+                (unsigned)g.free_heap, (unsigned)g.min_free_heap, (unsigned)g.largest_block,
+                (unsigned)g.min_largest_block, (unsigned)g.free_psram, (unsigned)g.pool_blocks_free,
+                (unsigned)g.pool_blocks_total, g.pool_fallbacks);
+
+  out += "\"histograms\":{";
+  json_histogram(out, "ftp_login_ms", ftp_login_ms);
+  out += ",";
+  json_histogram(out, "pasv_ms", pasv_ms);
+  out += ",";
+  json_histogram(out, "retr_ms", retr_ms);
+  out += ",";
+  json_histogram(out, "ttfb_ms", ttfb_ms);
+  out += ",";
+  json_histogram(out, "listing_ms", listing_ms);
+  out += ",";
+  json_histogram(out, "throughput_kbps", throughput_kbps);
+  out += "}}";
+}
+
+static void prometheus_header(std::string &out, const char *name, const char *type, const char *help) {
+  append_format(out, "# HELP ftp_proxy_%s %s\n# TYPE ftp_proxy_%s %s\n", name, help, name, type);
+}
+
+static void prometheus_value(std::string &out, const char *name, const char *type, const char *help,
+                             uint64_t value) {
+  prometheus_header(out, name, type, help);
+  append_format(out, "ftp_proxy_%s %" PRIu64 "\n", name, value);
+}
+
+// Les bornes sont converties en unités de base Prometheus (secondes, octets/s)
+static void prometheus_histogram(std::string &out, const char *name, const char *help, const Histogram &histogram,
+                                 double scale) {
+  prometheus_header(out, name, "histogram", help);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < histogram.bound_count(); i++) {
+    cumulative += histogram.bucket(i);
+    append_format(out, "ftp_proxy_%s_bucket{le=\"%g\"} %" PRIu64 "\n", name, histogram.bound(i) * scale,
+                  cumulative);
+  }
+  cumulative += histogram.bucket(histogram.bound_count());
+  append_format(out, "ftp_proxy_%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", name, cumulative);
+  append_format(out, "ftp_proxy_%s_sum %.10g\nftp_proxy_%s_count %" PRIu64 "\n", name, histogram.sum() * scale, name,
+                cumulative);
+}
+
+void ProxyMetrics::write_prometheus(std::string &out, const MetricsGauges &g) const {
+  prometheus_value(out, "uptime_seconds", "gauge", "Temps depuis le démarrage", g.uptime_s);
+  prometheus_value(out, "transfers_active", "gauge", "Transferts en cours", g.active_transfers);
+  prometheus_value(out, "transfers_queued", "gauge", "Transferts en attente d'un worker", g.queued_transfers);
+  prometheus_value(out, "transfers_max", "gauge", "Workers de transfert", g.max_transfers);
+  prometheus_value(out, "shared_downloads_active", "gauge", "Téléchargements partagés en cours", g.shared_downloads);
+  prometheus_value(out, "event_loop_streams", "gauge", "Flux servis par la boucle d'événements",
+                   g.event_loop_streams);
+  prometheus_value(out, "transfers_completed_total", "counter", "Transferts terminés", transfers_completed.value());
+  prometheus_value(out, "transfers_failed_total", "counter", "Transferts échoués", transfers_failed.value());
+  prometheus_value(out, "shared_joins_total", "counter", "Clients rattachés à un téléchargement partagé",
+                   shared_joins.value());
+  prometheus_value(out, "not_modified_total", "counter", "Réponses 304", not_modified.value());
+  prometheus_value(out, "ftp_received_bytes_total", "counter", "Octets reçus du serveur FTP", bytes_in.value());
+  prometheus_value(out, "http_sent_bytes_total", "counter", "Octets de fichiers envoyés aux clients",
+                   bytes_out.value());
+  prometheus_value(out, "uploads_completed_total", "counter", "Envois stockés sur le serveur FTP",
+                   uploads_completed.value());
+  prometheus_value(out, "uploads_failed_total", "counter", "Envois échoués", uploads_failed.value());
+  prometheus_value(out, "ftp_uploaded_bytes_total", "counter", "Octets envoyés au serveur FTP", bytes_uploaded.value());
+
+  prometheus_value(out, "content_cache_hits_total", "counter", "Succès du cache de contenu", g.content_cache_hits);
+  prometheus_value(out, "content_cache_misses_total", "counter", "Échecs du cache de contenu",
+                   g.content_cache_misses);
+  prometheus_value(out, "content_cache_used_bytes", "gauge", "Occupation du cache de contenu", g.content_cache_used);
+  prometheus_header(out, "listing_cache_requests_total", "counter", "Listings par état du cache");
+  append_format(out, "ftp_proxy_listing_cache_requests_total{state=\"fresh\"} %" PRIu64 "\n", listing_fresh.value());
+  append_format(out, "ftp_proxy_listing_cache_requests_total{state=\"stale\"} %" PRIu64 "\n", listing_stale.value());
+  append_format(out, "ftp_proxy_listing_cache_requests_total{state=\"miss\"} %" PRIu64 "\n", listing_miss.value());
+
+  prometheus_header(out, "errors_total", "counter", "Erreurs par cause");
+  for (size_t i = 0; i < (size_t)ErrorCause::COUNT; i++) {
+    append_format(out, "ftp_proxy_errors_total{cause=\"%s\"} %" PRIu64 "\n", ERROR_CAUSE_NAMES[i],
+                  errors_[i].value());
+  }
+
+  prometheus_value(out, "free_heap_bytes", "gauge", "Mémoire libre", g.free_heap);
+  prometheus_value(out, "min_free_heap_bytes", "gauge", "Mémoire libre minimale depuis le démarrage",
+                   g.min_free_heap);
+  prometheus_value(out, "largest_free_block_bytes", "gauge", "Plus grand bloc libre", g.largest_block);
+  prometheus_value(out, "min_largest_free_block_bytes", "gauge", "Plus petit des plus grands blocs libres relevés",
+                   g.min_largest_block);
+  prometheus_value(out, "free_psram_bytes", "gauge", "PSRAM libre", g.free_psram);
+  prometheus_value(out, "pool_blocks_free", "gauge", "Blocs libres dans les réserves de tampons", g.pool_blocks_free);
+  prometheus_value(out, "pool_blocks", "gauge", "Blocs des réserves de tampons", g.pool_blocks_total);
+  prometheus_value(out, "pool_fallbacks_total", "counter", "Allocations sur le tas faute de bloc ou de contexte libre",
+                   g.pool_fallbacks);
+
+  prometheus_histogram(out, "ftp_login_seconds", "Connexion et authentification FTP", ftp_login_ms, 0.001);
+  prometheus_histogram(out, "ftp_pasv_seconds", "Latence de PASV", pasv_ms, 0.001);
+  prometheus_histogram(out, "ftp_retr_seconds", "Latence de RETR jusqu'à la réponse 150", retr_ms, 0.001);
+  prometheus_histogram(out, "time_to_first_byte_seconds", "Requête jusqu'au premier octet du corps", ttfb_ms, 0.001);
+  prometheus_histogram(out, "listing_seconds", "Durée des listings", listing_ms, 0.001);
+  prometheus_histogram(out, "transfer_throughput_bytes_per_second", "Débit moyen des transferts terminés",
+                       throughput_kbps, 1024);
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Compteur 64 bits sans verrou: l'ESP32 n'a pas d'atomique 64 bits natif, le mot
+// haut est incrémenté au débordement du mot bas. Une lecture concurrente d'un
+// débordement peut voir la valeur sous-estimée une fois tous les 4 Go.
+class Counter {
+ public:
+  void add(uint32_t n) {
+    uint32_t old = low_.fetch_add(n, std::memory_order_relaxed);
+    if (old + n < old) {
+      high_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  void inc() { add(1); }
+  uint64_t value() const;
+
+ private:
+  std::atomic<uint32_t> low_{0};
+  std::atomic<uint32_t> high_{0};
+};
+
+// Histogramme à seaux fixes; record() ne coûte que trois additions atomiques
+class Histogram {
+ public:
+  static const size_t MAX_BOUNDS = 12;
+
+  // bounds: bornes supérieures croissantes, à durée de vie statique
+  Histogram(const uint32_t *bounds, size_t count);
+
+  void record(uint32_t value);
+
+  size_t bound_count() const { return bound_count_; }
+  uint32_t bound(size_t i) const { return bounds_[i]; }
+  // Valeurs <= bound(i) et > bound(i - 1); i == bound_count(): au-delà de la dernière borne
+  uint32_t bucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+  uint64_t count() const { return count_.value(); }
+  uint64_t sum() const { return sum_.value(); }
+
+ private:
+  const uint32_t *bounds_;
+  size_t bound_count_;
+  std::atomic<uint32_t> buckets_[MAX_BOUNDS + 1];
+  Counter count_;
+  Counter sum_;
+};
+
+enum class ErrorCause : uint8_t {
+  FTP_CONNECT,     // Connexion ou authentification FTP
+  FTP_PROTOCOL,    // PASV, REST, RETR ou LIST refusés ou sans réponse
+  NOT_FOUND,       // Fichier absent du serveur
+  FTP_DATA,        // Canal de données interrompu ou transfert incomplet
+  CLIENT_SEND,     // Client HTTP parti
+  CLIENT_STALL,    // Client HTTP bloqué
+  OUT_OF_MEMORY,
+  QUEUE_FULL,      // Requête refusée (503)
+  COUNT,
+};
+
+// Valeurs instantanées relevées par le proxy au moment de l'export
+struct MetricsGauges {
+  int active_transfers{0};
+  int queued_transfers{0};
+  int max_transfers{0};
+  int shared_downloads{0};
+  int event_loop_streams{0};      // Flux confiés à la boucle d'événements
+  uint32_t content_cache_hits{0};
+  uint32_t content_cache_misses{0};
+  size_t content_cache_used{0};
+  size_t content_cache_budget{0};
+  size_t free_heap{0};
+  size_t min_free_heap{0};        // Minimum depuis le démarrage
+  size_t largest_block{0};
+  size_t min_largest_block{0};    // Minimum relevé depuis le démarrage
+  size_t free_psram{0};
+  size_t pool_blocks_free{0};     // Réserves de tampons préparées au démarrage
+  size_t pool_blocks_total{0};
+  uint32_t pool_fallbacks{0};     // Tampons et contextes alloués sur le tas, réserve vide
+  uint32_t uptime_s{0};
+};
+
+// Métriques du proxy, enregistrées sans verrou depuis toutes les tâches
+class ProxyMetrics {
+ public:
+  ProxyMetrics();
+
+  void count_error(ErrorCause cause) { errors_[(size_t)cause].inc(); }
+
+  void write_json(std::string &out, const MetricsGauges &gauges) const;
+  void write_prometheus(std::string &out, const MetricsGauges &gauges) const;
+
+  Counter bytes_in;               // Reçus des connexions de données FTP
+  Counter bytes_out;              // Corps de fichiers envoyés aux clients HTTP
+  Counter transfers_completed;
+  Counter transfers_failed;
+  Counter shared_joins;           // Clients rattachés à un téléchargement partagé
+  Counter not_modified;           // Réponses 304
+  Counter listing_fresh;          // Listings servis depuis le cache
+  Counter listing_stale;          // Servis périmés pendant leur rafraîchissement
+  Counter listing_miss;
+  Counter uploads_completed;      // Envois PUT/POST stockés sur le serveur FTP
+  Counter uploads_failed;
+  Counter bytes_uploaded;         // Envoyés au serveur FTP
+
+  Histogram ftp_login_ms;         // Connexion et authentification d'une session FTP
+  Histogram pasv_ms;
+  Histogram retr_ms;              // RETR jusqu'à la réponse 150
+  Histogram ttfb_ms;              // Réception de la requête jusqu'au premier octet du corps
+  Histogram listing_ms;
+  Histogram throughput_kbps;      // Débit moyen des transferts terminés (Ko/s)
+
+ protected:
+  Counter errors_[(size_t)ErrorCause::COUNT];
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
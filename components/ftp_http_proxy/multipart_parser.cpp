@@ -0,0 +1,163 @@
+#include "multipart_parser.h"
+#include <cstring>
+#include <strings.h>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Valeur d'un paramètre 'key="valeur"' ou 'key=valeur' d'un en-tête
+static bool header_param(const char *header, const char *key, std::string &value) {
+  size_t key_len = strlen(key);
+  const char *p = header;
+  while ((p = strcasestr(p, key)) != nullptr) {
+    // Le paramètre doit commencer après un séparateur: "filename" ne répond pas à "name"
+    bool delimited = p == header || p[-1] == ';' || p[-1] == ' ' || p[-1] == '\t';
+    if (!delimited || p[key_len] != '=') {
+      p += key_len;
+      continue;
+    }
+    p += key_len + 1;
+    if (*p == '"') {
+      const char *end = strchr(p + 1, '"');
+      if (!end) return false;
+      value.assign(p + 1, end - p - 1);
+    } else {
+      size_t len = strcspn(p, "; \t");
+      value.assign(p, len);
+    }
+    return true;
+  }
+  return false;
+}
+
+bool MultipartParser::parse_boundary(const char *content_type, std::string &boundary) {
+  if (strncasecmp(content_type, "multipart/form-data", 19) != 0) {
+    return false;
+  }
+  // RFC 2046: 1 à 70 caractères
+  return header_param(content_type, "boundary", boundary) && !boundary.empty() && boundary.size() <= 70;
+}
+
+MultipartParser::MultipartParser(const std::string &boundary) : delimiter_("\r\n--" + boundary) {
+  // Le premier délimiteur ouvre le corps sans fin de ligne devant
+  match_ = 2;
+}
+
+bool MultipartParser::header_line(const Handler &handler) {
+  line_[line_len_] = '\0';
+  if (line_len_ == 0) {
+    // Fin des en-têtes de la partie
+    state_ = State::BODY;
+    match_ = 0;
+    return handler.begin(name_, filename_);
+  }
+  if (strncasecmp(line_, "Content-Disposition:", 20) == 0) {
+    header_param(line_ + 20, "name", name_);
+    header_param(line_ + 20, "filename", filename_);
+  }
+  return true;
+}
+
+bool MultipartParser::feed(const uint8_t *data, size_t len, const Handler &handler) {
+  size_t i = 0;
+  while (i < len) {
+    switch (state_) {
+      case State::PREAMBLE:
+        // Préambule ignoré jusqu'au premier délimiteur
+        if (data[i] == (uint8_t)delimiter_[match_]) {
+          if (++match_ == delimiter_.size()) {
+            state_ = State::AFTER_DELIM;
+            after_len_ = 0;
+          }
+        } else {
+          match_ = data[i] == '\r' ? 1 : 0;
+        }
+        i++;
+        break;
+
+      case State::AFTER_DELIM:
+        // Espaces de bourrage tolérés avant la fin de ligne
+        if (after_len_ == 0 && (data[i] == ' ' || data[i] == '\t')) {
+          i++;
+          break;
+        }
+        after_[after_len_++] = (char)data[i++];
+        if (after_len_ == 2) {
+          if (after_[0] == '-' && after_[1] == '-') {
+            state_ = State::DONE;
+          } else if (after_[0] == '\r' && after_[1] == '\n') {
+            state_ = State::HEADERS;
+            line_len_ = 0;
+            name_.clear();
+            filename_.clear();
+          } else {
+            return false;
+          }
+        }
+        break;
+
+      case State::HEADERS: {
+        char c = (char)data[i++];
+        if (c == '\n') {
+          if (line_len_ > 0 && line_[line_len_ - 1] == '\r') {
+            line_len_--;
+          }
+          if (!header_line(handler)) {
+            return false;
+          }
+          line_len_ = 0;
+        } else if (line_len_ + 1 < sizeof(line_)) {
+          line_[line_len_++] = c;
+        }
+        break;
+      }
+
+      case State::BODY: {
+        // Contenu transmis par tranches; les octets qui commencent peut-être un
+        // délimiteur sont retenus jusqu'à ce que la suite tranche. La frontière ne
+        // contient pas de CR: un échec de correspondance ne peut cacher un début
+        // de délimiteur que sur l'octet courant.
+        size_t run = i;
+        while (i < len) {
+          if (data[i] == (uint8_t)delimiter_[match_]) {
+            if (match_ == 0 && i > run && !handler.data(data + run, i - run)) {
+              return false;
+            }
+            i++;
+            if (++match_ == delimiter_.size()) {
+              state_ = State::AFTER_DELIM;
+              after_len_ = 0;
+              if (!handler.end()) {
+                return false;
+              }
+              break;
+            }
+            run = i;
+            continue;
+          }
+          if (match_ > 0) {
+            // Faux départ: les octets retenus faisaient partie du contenu
+            if (!handler.data((const uint8_t *)delimiter_.data(), match_)) {
+              return false;
+            }
+            match_ = 0;
+            run = i;
+            continue;  // L'octet courant peut commencer un délimiteur
+          }
+          i++;
+        }
+        if (state_ == State::BODY && match_ == 0 && i > run && !handler.data(data + run, i - run)) {
+          return false;
+        }
+        break;
+      }
+
+      case State::DONE:
+        return true;  // Épilogue ignoré
+    }
+  }
+  return true;
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Analyseur incrémental d'un corps multipart/form-data (RFC 7578): les frontières
+// sont reconnues à travers les découpages de httpd_req_recv() et le contenu des
+// parties est transmis au fil de l'eau, sans jamais conserver une partie entière.
+class MultipartParser {
+ public:
+  struct Handler {
+    // Début d'une partie (filename vide pour un simple champ de formulaire)
+    std::function<bool(const std::string &name, const std::string &filename)> begin;
+    std::function<bool(const uint8_t *data, size_t len)> data;
+    std::function<bool()> end;
+  };
+
+  // Frontière lue dans l'en-tête Content-Type; false si ce n'est pas du multipart
+  static bool parse_boundary(const char *content_type, std::string &boundary);
+
+  explicit MultipartParser(const std::string &boundary);
+
+  // false: corps malformé ou partie refusée par le gestionnaire
+  bool feed(const uint8_t *data, size_t len, const Handler &handler);
+  // Délimiteur final "--frontière--" atteint
+  bool finished() const { return state_ == State::DONE; }
+
+ private:
+  enum class State : uint8_t {
+    PREAMBLE,     // Avant le premier délimiteur
+    AFTER_DELIM,  // "--" final ou fin de ligne avant les en-têtes
+    HEADERS,
+    BODY,
+    DONE,
+  };
+
+  bool header_line(const Handler &handler);
+
+  std::string delimiter_;  // "\r\n--frontière"
+  State state_{State::PREAMBLE};
+  size_t match_;           // Octets du délimiteur reconnus
+  char after_[2];
+  size_t after_len_{0};
+  char line_[512];
+  size_t line_len_{0};
+  std::string name_;
+  std::string filename_;
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
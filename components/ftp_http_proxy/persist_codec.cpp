@@ -0,0 +1,189 @@
+#include "persist_codec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+static const uint8_t CHUNK_MAGIC[2] = {'F', 'P'};
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+  return p + 4;
+}
+
+static uint8_t *put_bytes(uint8_t *p, const std::string &s) {
+  memcpy(p, s.data(), s.size());
+  return p + s.size();
+}
+
+static uint16_t get_u16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t *PersistEncoder::reserve(size_t record_len) {
+  if (HEADER_SIZE + record_len > chunk_size_) {
+    return nullptr;
+  }
+  if (!current_.empty() && current_.size() + record_len > chunk_size_) {
+    seal_current();
+  }
+  if (current_.empty()) {
+    current_.reserve(chunk_size_);
+    current_.resize(HEADER_SIZE);
+  }
+  size_t offset = current_.size();
+  current_.resize(offset + record_len);
+  return current_.data() + offset;
+}
+
+void PersistSizer::add(size_t record_len) {
+  if (PersistEncoder::HEADER_SIZE + record_len > chunk_size_) {
+    return;  // Refusé par l'encodeur
+  }
+  if (current_ && current_ + record_len > chunk_size_) {
+    chunks_++;
+    current_ = 0;
+  }
+  if (!current_) {
+    current_ = PersistEncoder::HEADER_SIZE;
+  }
+  current_ += record_len;
+}
+
+bool PersistEncoder::add_share(const std::string &path, const std::string &token, int64_t expiry) {
+  if (path.size() > MAX_PATH || token.size() > 255) {
+    return false;
+  }
+  // type | longueur token u8 | token | longueur chemin u16 | chemin | échéance i64
+  uint8_t *p = reserve(share_size(path, token));
+  if (!p) {
+    return false;
+  }
+  *p++ = PersistRecord::SHARE;
+  *p++ = (uint8_t)token.size();
+  p = put_bytes(p, token);
+  p = put_u16(p, (uint16_t)path.size());
+  p = put_bytes(p, path);
+  p = put_u32(p, (uint32_t)((uint64_t)expiry & 0xFFFFFFFF));
+  put_u32(p, (uint32_t)((uint64_t)expiry >> 32));
+  return true;
+}
+
+bool PersistEncoder::add_shareable(const std::string &path, bool shareable) {
+  if (path.size() > MAX_PATH) {
+    return false;
+  }
+  // type | longueur chemin u16 | chemin | drapeau u8
+  uint8_t *p = reserve(shareable_size(path));
+  if (!p) {
+    return false;
+  }
+  *p++ = PersistRecord::SHAREABLE;
+  p = put_u16(p, (uint16_t)path.size());
+  p = put_bytes(p, path);
+  *p = shareable ? 1 : 0;
+  return true;
+}
+
+void PersistEncoder::seal_current() {
+  if (current_.empty()) {
+    return;
+  }
+  uint8_t *header = current_.data();
+  header[0] = CHUNK_MAGIC[0];
+  header[1] = CHUNK_MAGIC[1];
+  header[2] = VERSION;
+  header[3] = 0;
+  put_u32(header + 4, crc32(current_.data() + HEADER_SIZE, current_.size() - HEADER_SIZE));
+  chunks_.push_back(std::move(current_));
+  current_.clear();
+}
+
+std::vector<std::vector<uint8_t>> PersistEncoder::take_chunks() {
+  seal_current();
+  std::vector<std::vector<uint8_t>> chunks;
+  chunks.swap(chunks_);
+  return chunks;
+}
+
+void PersistEncoder::restore_chunks(std::vector<std::vector<uint8_t>> &&older) {
+  // Plus anciens que tout ce qui a été encodé depuis: l'ordre de rejeu est conservé
+  older.insert(older.end(), std::make_move_iterator(chunks_.begin()), std::make_move_iterator(chunks_.end()));
+  chunks_.swap(older);
+}
+
+size_t PersistEncoder::drop_oldest(size_t max_chunks) {
+  size_t total = chunks_.size() + (current_.empty() ? 0 : 1);
+  if (total <= max_chunks) {
+    return 0;
+  }
+  // Le bloc en cours, le plus récent, est toujours gardé
+  size_t dropped = std::min(total - max_chunks, chunks_.size());
+  chunks_.erase(chunks_.begin(), chunks_.begin() + dropped);
+  return dropped;
+}
+
+bool PersistEncoder::decode_chunk(const uint8_t *data, size_t len,
+                                  const std::function<void(const PersistRecord &)> &on_record) {
+  if (len < HEADER_SIZE || data[0] != CHUNK_MAGIC[0] || data[1] != CHUNK_MAGIC[1] || data[2] != VERSION) {
+    return false;
+  }
+  const uint8_t *p = data + HEADER_SIZE;
+  const uint8_t *end = data + len;
+  if (get_u32(data + 4) != crc32(p, end - p)) {
+    return false;
+  }
+
+  PersistRecord record;
+  while (p < end) {
+    record.type = (PersistRecord::Type)*p++;
+    if (record.type == PersistRecord::SHARE) {
+      if (end - p < 1 || end - p < 1 + p[0] + 2) return false;
+      size_t token_len = *p++;
+      record.token.assign((const char *)p, token_len);
+      p += token_len;
+      size_t path_len = get_u16(p);
+      p += 2;
+      if ((size_t)(end - p) < path_len + 8) return false;
+      record.path.assign((const char *)p, path_len);
+      p += path_len;
+      record.expiry = (int64_t)((uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32));
+      p += 8;
+    } else if (record.type == PersistRecord::SHAREABLE) {
+      if (end - p < 2) return false;
+      size_t path_len = get_u16(p);
+      p += 2;
+      if ((size_t)(end - p) < path_len + 1) return false;
+      record.path.assign((const char *)p, path_len);
+      p += path_len;
+      record.shareable = *p++ != 0;
+    } else {
+      return false;  // Type inconnu: format plus récent ou bloc corrompu
+    }
+    on_record(record);
+  }
+  return true;
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
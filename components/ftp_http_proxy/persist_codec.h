@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Enregistrement de l'état persistant (partages et statuts de partage)
+struct PersistRecord {
+  enum Type : uint8_t {
+    SHARE = 1,      // Lien de partage: token, chemin, échéance (secondes Unix)
+    SHAREABLE = 2,  // Statut partageable d'un fichier
+  };
+
+  Type type{SHARE};
+  std::string path;
+  std::string token;
+  int64_t expiry{0};
+  bool shareable{false};
+};
+
+// Encode des enregistrements en blocs binaires autonomes de taille bornée.
+// Format d'un bloc (little-endian):
+//   'F' 'P' | version u8 | réservé u8 | crc32 u32 de la charge | enregistrements
+// Un enregistrement ne chevauche jamais deux blocs: chaque bloc se vérifie et
+// se rejoue seul, un bloc corrompu ne fait perdre que son propre contenu.
+class PersistEncoder {
+ public:
+  static const uint8_t VERSION = 1;
+  static const size_t HEADER_SIZE = 8;
+  static const size_t MAX_PATH = 1024;
+
+  explicit PersistEncoder(size_t chunk_size) : chunk_size_(chunk_size) {}
+
+  // Taille encodée d'un enregistrement
+  static size_t share_size(const std::string &path, const std::string &token) {
+    return 1 + 1 + token.size() + 2 + path.size() + 8;
+  }
+  static size_t shareable_size(const std::string &path) { return 1 + 2 + path.size() + 1; }
+
+  // Retournent false si l'enregistrement est trop grand pour être persisté
+  bool add_share(const std::string &path, const std::string &token, int64_t expiry);
+  bool add_shareable(const std::string &path, bool shareable);
+
+  bool empty() const { return chunks_.empty() && current_.empty(); }
+  // Termine le bloc courant et transfère tous les blocs encodés
+  std::vector<std::vector<uint8_t>> take_chunks();
+  // Remet en tête des blocs rendus par take_chunks() et non écrits
+  void restore_chunks(std::vector<std::vector<uint8_t>> &&older);
+  // Ne garde que les max_chunks blocs les plus récents; retourne le nombre de
+  // blocs abandonnés
+  size_t drop_oldest(size_t max_chunks);
+
+  // Vérifie un bloc et appelle on_record pour chacun de ses enregistrements
+  static bool decode_chunk(const uint8_t *data, size_t len,
+                           const std::function<void(const PersistRecord &)> &on_record);
+
+ private:
+  uint8_t *reserve(size_t record_len);
+  void seal_current();
+
+  size_t chunk_size_;
+  std::vector<uint8_t> current_;
+  std::vector<std::vector<uint8_t>> chunks_;
+};
+
+// Nombre de blocs qu'occuperait un état, sans l'encoder: mêmes règles de
+// remplissage que PersistEncoder, pour refuser un ajout qui ne tiendrait plus
+class PersistSizer {
+ public:
+  explicit PersistSizer(size_t chunk_size) : chunk_size_(chunk_size) {}
+
+  void add_share(const std::string &path, const std::string &token) {
+    add(PersistEncoder::share_size(path, token));
+  }
+  void add_shareable(const std::string &path) { add(PersistEncoder::shareable_size(path)); }
+  size_t chunks() const { return chunks_ + (current_ ? 1 : 0); }
+
+ private:
+  void add(size_t record_len);
+
+  size_t chunk_size_;
+  size_t chunks_{0};   // Blocs complets
+  size_t current_{0};  // Octets du bloc en cours, en-tête compris (0: aucun)
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,353 @@
+#include "persistent_store.h"
+#include "esphome/core/log.h"
+#include "nvs_flash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+static const char *TAG = "ftp_proxy.persist";
+static const uint8_t META_VERSION = 1;
+
+// Géométrie NVS: pages de 4 Ko de 126 entrées de 32 octets
+static const size_t NVS_ENTRIES_PER_PAGE = 126;
+static const size_t NVS_ENTRY_SIZE = 32;
+// Une page libre pour le ramasse-miettes, une de marge ("meta", fragmentation)
+static const size_t NVS_RESERVED_PAGES = 2;
+// Entrées d'un bloc plein: index, en-tête et 124 de données, plus un en-tête
+// s'il chevauche deux pages
+static const size_t ENTRIES_PER_CHUNK = 127;
+
+static void chunk_key(char *key, size_t len, uint8_t slot, uint32_t index) {
+  snprintf(key, len, "s%c%u", slot ? 'b' : 'a', (unsigned)index);
+}
+
+static void journal_key(char *key, size_t len, uint32_t seq) {
+  snprintf(key, len, "j%u", (unsigned)seq);
+}
+
+PersistentStore::~PersistentStore() {
+  if (opened_) {
+    nvs_close(handle_);
+  }
+  if (pending_mutex_) {
+    vSemaphoreDelete(pending_mutex_);
+  }
+}
+
+bool PersistentStore::open(const char *partition, const char *name_space) {
+  pending_mutex_ = xSemaphoreCreateMutex();
+  if (!pending_mutex_) {
+    return false;
+  }
+  partition_ = partition;
+  esp_err_t err = nvs_flash_init_partition(partition);
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    ESP_LOGW(TAG, "Partition %s illisible, effacée", partition);
+    nvs_flash_erase_partition(partition);
+    err = nvs_flash_init_partition(partition);
+  }
+  if (err != ESP_OK) {
+    // Déjà initialisée par ESPHome
+    ESP_LOGW(TAG, "Partition %s indisponible (%s), repli sur \"%s\"", partition, esp_err_to_name(err),
+             NVS_DEFAULT_PART_NAME);
+    partition_ = NVS_DEFAULT_PART_NAME;
+  }
+  name_space_ = name_space;
+  err = nvs_open_from_partition(partition_.c_str(), name_space, NVS_READWRITE, &handle_);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Ouverture NVS impossible: %s", esp_err_to_name(err));
+    return false;
+  }
+  opened_ = true;
+
+  size_t len = sizeof(meta_);
+  err = nvs_get_blob(handle_, "meta", &meta_, &len);
+  if (err != ESP_OK || len != sizeof(meta_) || meta_.version != META_VERSION) {
+    if (err == ESP_OK) {
+      ESP_LOGW(TAG, "Format persistant inconnu, état réinitialisé");
+      nvs_erase_all(handle_);
+    }
+    meta_ = Meta{META_VERSION, 0, 0, 0, 0};
+  }
+
+  if (!this->compute_budget(this->erase_orphans())) {
+    nvs_close(handle_);
+    opened_ = false;
+    return false;
+  }
+  return true;
+}
+
+size_t PersistentStore::erase_orphans() {
+  // Clés relevées d'abord: le parcours ne survit pas aux effacements
+  std::vector<std::string> keys;
+  nvs_iterator_t it = nullptr;
+  esp_err_t err = nvs_entry_find(partition_.c_str(), name_space_.c_str(), NVS_TYPE_BLOB, &it);
+  while (err == ESP_OK) {
+    nvs_entry_info_t info;
+    nvs_entry_info(it, &info);
+    keys.push_back(info.key);
+    err = nvs_entry_next(&it);
+  }
+  nvs_release_iterator(it);
+
+  size_t own_entries = 0;
+  uint32_t orphans = 0;
+  for (const auto &key : keys) {
+    bool used = key == "meta";
+    if (key.size() > 2 && key[0] == 's' && (key[1] == 'a' || key[1] == 'b')) {
+      uint32_t index = strtoul(key.c_str() + 2, nullptr, 10);
+      used = (key[1] == 'b') == (meta_.slot == 1) && index < meta_.snap_chunks;
+    } else if (key.size() > 1 && key[0] == 'j') {
+      uint32_t seq = strtoul(key.c_str() + 1, nullptr, 10);
+      used = seq - meta_.journal_start < meta_.journal_end - meta_.journal_start;
+    }
+    if (!used) {
+      nvs_erase_key(handle_, key.c_str());
+      orphans++;
+      continue;
+    }
+    size_t len = 0;
+    if (nvs_get_blob(handle_, key.c_str(), nullptr, &len) == ESP_OK) {
+      own_entries += 2 + (len + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+    }
+  }
+  if (orphans) {
+    nvs_commit(handle_);
+    ESP_LOGW(TAG, "%u bloc(s) orphelin(s) effacé(s)", (unsigned)orphans);
+  }
+  return own_entries;
+}
+
+bool PersistentStore::compute_budget(size_t own_entries) {
+  nvs_stats_t stats;
+  esp_err_t err = nvs_get_stats(partition_.c_str(), &stats);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Statistiques NVS indisponibles: %s", esp_err_to_name(err));
+    return false;
+  }
+  // Place libre plus celle que l'état occupe déjà: sur la partition par défaut,
+  // les autres composants gardent la leur
+  size_t available = stats.free_entries + own_entries;
+  size_t reserved = NVS_RESERVED_PAGES * NVS_ENTRIES_PER_PAGE;
+  size_t slots = available > reserved ? (available - reserved) / ENTRIES_PER_CHUNK : 0;
+  // Pendant une compaction: ancien instantané, nouveau, et le journal
+  journal_max_chunks_ = std::max<size_t>(1, std::min<size_t>(MAX_JOURNAL_CHUNKS, slots / 4));
+  if (slots < journal_max_chunks_ + 2) {
+    ESP_LOGW(TAG, "Partition %s trop petite pour la persistance (%u entrées libres)", partition_.c_str(),
+             (unsigned)stats.free_entries);
+    return false;
+  }
+  snapshot_max_chunks_ = (slots - journal_max_chunks_) / 2;
+  ESP_LOGI(TAG, "Persistance sur \"%s\": instantané de %u bloc(s), journal de %u", partition_.c_str(),
+           (unsigned)snapshot_max_chunks_, (unsigned)journal_max_chunks_);
+  return true;
+}
+
+void PersistentStore::erase_chunks(uint8_t slot, uint32_t from, uint32_t to) {
+  char key[16];
+  for (uint32_t i = from; i < to; i++) {
+    chunk_key(key, sizeof(key), slot, i);
+    nvs_erase_key(handle_, key);
+  }
+}
+
+void PersistentStore::erase_journal(uint32_t from, uint32_t to) {
+  char key[16];
+  for (uint32_t seq = from; seq != to; seq++) {
+    journal_key(key, sizeof(key), seq);
+    nvs_erase_key(handle_, key);
+  }
+}
+
+bool PersistentStore::read_key(const char *key, std::vector<uint8_t> &buf) {
+  size_t len = 0;
+  if (nvs_get_blob(handle_, key, nullptr, &len) != ESP_OK) {
+    return false;
+  }
+  buf.resize(len);
+  return nvs_get_blob(handle_, key, buf.data(), &len) == ESP_OK;
+}
+
+bool PersistentStore::load(const std::function<void(const PersistRecord &)> &apply) {
+  if (!opened_) {
+    return false;
+  }
+  std::vector<uint8_t> buf;
+  buf.reserve(CHUNK_SIZE);
+  char key[16];
+  uint32_t bad = 0;
+
+  for (uint32_t i = 0; i < meta_.snap_chunks; i++) {
+    chunk_key(key, sizeof(key), meta_.slot, i);
+    if (!read_key(key, buf) || !PersistEncoder::decode_chunk(buf.data(), buf.size(), apply)) {
+      bad++;
+    }
+  }
+  for (uint32_t seq = meta_.journal_start; seq != meta_.journal_end; seq++) {
+    journal_key(key, sizeof(key), seq);
+    if (!read_key(key, buf) || !PersistEncoder::decode_chunk(buf.data(), buf.size(), apply)) {
+      bad++;
+    }
+  }
+
+  if (bad) {
+    ESP_LOGW(TAG, "%u bloc(s) persistant(s) illisible(s) ignoré(s)", (unsigned)bad);
+  }
+  ESP_LOGD(TAG, "État chargé: %u bloc(s) d'instantané, %u de journal", (unsigned)meta_.snap_chunks,
+           (unsigned)(meta_.journal_end - meta_.journal_start));
+  return true;
+}
+
+void PersistentStore::record_share(const std::string &path, const std::string &token, int64_t expiry) {
+  xSemaphoreTake(pending_mutex_, portMAX_DELAY);
+  bool ok = pending_.add_share(path, token, expiry);
+  xSemaphoreGive(pending_mutex_);
+  if (!ok) {
+    ESP_LOGW(TAG, "Partage non persisté (chemin trop long): %s", path.c_str());
+  }
+}
+
+void PersistentStore::record_shareable(const std::string &path, bool shareable) {
+  xSemaphoreTake(pending_mutex_, portMAX_DELAY);
+  bool ok = pending_.add_shareable(path, shareable);
+  xSemaphoreGive(pending_mutex_);
+  if (!ok) {
+    ESP_LOGW(TAG, "Statut non persisté (chemin trop long): %s", path.c_str());
+  }
+}
+
+bool PersistentStore::has_pending() {
+  xSemaphoreTake(pending_mutex_, portMAX_DELAY);
+  bool pending = !pending_.empty();
+  xSemaphoreGive(pending_mutex_);
+  return pending;
+}
+
+bool PersistentStore::write_meta(const Meta &meta) {
+  if (nvs_set_blob(handle_, "meta", &meta, sizeof(meta)) != ESP_OK || nvs_commit(handle_) != ESP_OK) {
+    return false;
+  }
+  meta_ = meta;
+  return true;
+}
+
+std::vector<std::vector<uint8_t>> PersistentStore::take_pending() {
+  xSemaphoreTake(pending_mutex_, portMAX_DELAY);
+  auto chunks = pending_.take_chunks();
+  xSemaphoreGive(pending_mutex_);
+  return chunks;
+}
+
+void PersistentStore::restore_pending(std::vector<std::vector<uint8_t>> &&chunks) {
+  // Bornées à un journal: au-delà, seule la compaction peut les écrire, et elle
+  // les reprend de l'état complet
+  xSemaphoreTake(pending_mutex_, portMAX_DELAY);
+  pending_.restore_chunks(std::move(chunks));
+  size_t dropped = pending_.drop_oldest(journal_max_chunks_);
+  xSemaphoreGive(pending_mutex_);
+  if (dropped) {
+    ESP_LOGW(TAG, "%u bloc(s) en attente abandonné(s), repris par la prochaine compaction", (unsigned)dropped);
+  }
+}
+
+bool PersistentStore::flush() {
+  if (!opened_) {
+    return false;
+  }
+  auto chunks = this->take_pending();
+  if (chunks.empty()) {
+    return true;
+  }
+
+  // Journal plein: la compaction réécrira l'état complet
+  if (meta_.journal_end - meta_.journal_start + chunks.size() > journal_max_chunks_) {
+    this->restore_pending(std::move(chunks));
+    compaction_forced_ = true;
+    return false;
+  }
+
+  // Les blocs au-delà de journal_end ne comptent qu'une fois "meta" mis à jour
+  Meta meta = meta_;
+  char key[16];
+  bool written = true;
+  for (const auto &chunk : chunks) {
+    journal_key(key, sizeof(key), meta.journal_end);
+    esp_err_t err = nvs_set_blob(handle_, key, chunk.data(), chunk.size());
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "Écriture du journal impossible: %s", esp_err_to_name(err));
+      written = false;
+      break;
+    }
+    meta.journal_end++;
+  }
+  if (written && write_meta(meta)) {
+    return true;
+  }
+  // Rien n'est validé sans "meta": tout le lot sera réécrit
+  this->erase_journal(meta_.journal_end, meta.journal_end);
+  nvs_commit(handle_);
+  this->restore_pending(std::move(chunks));
+  compaction_forced_ = true;
+  return false;
+}
+
+bool PersistentStore::needs_compaction() const {
+  return opened_ && (compaction_forced_ || meta_.journal_end - meta_.journal_start >= journal_max_chunks_);
+}
+
+bool PersistentStore::compact(const std::function<void(PersistEncoder &)> &fill) {
+  if (!opened_) {
+    return false;
+  }
+  // Retirées avant fill: tout ce qu'elles décrivent figure déjà dans l'état complet
+  auto pending = this->take_pending();
+  PersistEncoder encoder(CHUNK_SIZE);
+  fill(encoder);
+  auto chunks = encoder.take_chunks();
+  if (chunks.size() > snapshot_max_chunks_) {
+    ESP_LOGE(TAG, "État trop grand pour la partition: %u bloc(s) pour %u", (unsigned)chunks.size(),
+             (unsigned)snapshot_max_chunks_);
+    this->restore_pending(std::move(pending));
+    return false;
+  }
+
+  // Nouvel instantané dans l'emplacement inactif, puis bascule via "meta"
+  Meta old = meta_;
+  Meta meta = old;
+  meta.slot = old.slot ^ 1;
+  meta.snap_chunks = chunks.size();
+  meta.journal_start = old.journal_end;
+  char key[16];
+  size_t written = 0;
+  for (; written < chunks.size(); written++) {
+    chunk_key(key, sizeof(key), meta.slot, written);
+    esp_err_t err = nvs_set_blob(handle_, key, chunks[written].data(), chunks[written].size());
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "Écriture de l'instantané impossible: %s", esp_err_to_name(err));
+      break;
+    }
+  }
+  if (written < chunks.size() || !write_meta(meta)) {
+    // Blocs partiels de l'emplacement inactif: la place revient au journal
+    this->erase_chunks(meta.slot, 0, written);
+    nvs_commit(handle_);
+    this->restore_pending(std::move(pending));
+    return false;
+  }
+  compaction_forced_ = false;
+
+  // Nettoyage: ancien instantané et journal désormais inclus dans le nouveau
+  this->erase_chunks(old.slot, 0, old.snap_chunks);
+  this->erase_journal(old.journal_start, old.journal_end);
+  nvs_commit(handle_);
+  ESP_LOGD(TAG, "Instantané réécrit: %u bloc(s)", (unsigned)chunks.size());
+  return true;
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
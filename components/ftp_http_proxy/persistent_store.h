@@ -0,0 +1,95 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "persist_codec.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Persistance de l'état en NVS: un instantané complet plus un journal de blocs
+// ajoutés au fil des modifications. Les modifications sont regroupées en mémoire
+// et écrites par flush(); compact() réécrit l'instantané quand le journal s'allonge.
+//
+// L'état vit dans une partition NVS dédiée (README): la partition "nvs" par défaut,
+// partagée avec ESPHome, ne sert que de repli. Les tailles max de l'instantané et
+// du journal sont calculées à l'ouverture depuis la place disponible, de sorte
+// que deux instantanés et le journal tiennent ensemble pendant une compaction;
+// fits() permet de refuser un ajout qui dépasserait l'instantané.
+//
+// Clés du namespace:
+//   "meta"           emplacement actif de l'instantané, nombre de blocs, bornes du journal
+//   "sa<n>", "sb<n>" blocs de l'instantané (deux emplacements alternés)
+//   "j<n>"           blocs du journal, numérotés en séquence
+// L'écriture de "meta" valide chaque étape: une coupure au milieu d'un flush ou
+// d'une compaction laisse l'état précédent intact.
+class PersistentStore {
+ public:
+  // Taille max d'un bloc: tient dans une page NVS de 4 Ko
+  static const size_t CHUNK_SIZE = 3968;
+  // Au-delà, le journal est replié dans un nouvel instantané
+  static const uint32_t MAX_JOURNAL_CHUNKS = 16;
+
+  ~PersistentStore();
+
+  // Retombe sur la partition par défaut si partition est absente de la table
+  bool open(const char *partition, const char *name_space);
+  bool is_open() const { return opened_; }
+  // L'état mesuré tient-il dans un instantané (toujours vrai si fermé)
+  bool fits(const PersistSizer &state) const { return !opened_ || state.chunks() <= snapshot_max_chunks_; }
+
+  // Rejoue l'instantané puis le journal, dans l'ordre d'écriture
+  bool load(const std::function<void(const PersistRecord &)> &apply);
+
+  // Modifications en attente, appelables depuis n'importe quelle tâche
+  void record_share(const std::string &path, const std::string &token, int64_t expiry);
+  void record_shareable(const std::string &path, bool shareable);
+
+  bool has_pending();
+  // Ajoute les modifications en attente au journal. En cas d'échec elles restent en
+  // attente et une compaction est demandée: elle réécrit l'état complet et libère
+  // la place occupée par le journal.
+  bool flush();
+  bool needs_compaction() const;
+  // Réécrit l'instantané à partir de l'état complet fourni par fill, puis vide le
+  // journal; les modifications en attente, couvertes par fill, sont abandonnées
+  bool compact(const std::function<void(PersistEncoder &)> &fill);
+
+ protected:
+  struct Meta {
+    uint8_t version;
+    uint8_t slot;          // 0: "sa", 1: "sb"
+    uint16_t snap_chunks;
+    uint32_t journal_start;
+    uint32_t journal_end;  // Exclu
+  };
+
+  bool write_meta(const Meta &meta);
+  bool read_key(const char *key, std::vector<uint8_t> &buf);
+  // Efface les blocs que "meta" ne référence pas (écriture interrompue) et
+  // retourne les entrées NVS occupées par les autres
+  size_t erase_orphans();
+  bool compute_budget(size_t own_entries);
+  void erase_chunks(uint8_t slot, uint32_t from, uint32_t to);
+  void erase_journal(uint32_t from, uint32_t to);
+  std::vector<std::vector<uint8_t>> take_pending();
+  void restore_pending(std::vector<std::vector<uint8_t>> &&chunks);
+
+  nvs_handle_t handle_{0};
+  bool opened_{false};
+  std::string partition_;
+  std::string name_space_;
+  uint32_t snapshot_max_chunks_{0};
+  uint32_t journal_max_chunks_{0};
+  Meta meta_{};
+  bool compaction_forced_{false};  // Un flush a échoué
+  SemaphoreHandle_t pending_mutex_{nullptr};
+  PersistEncoder pending_{CHUNK_SIZE};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,160 @@
+#pragma once
+
+// Couche d'abstraction de la plateforme pour les modules indépendants d'ESPHome
+// (caches, analyse des listings, partages, téléchargements partagés): ESP-IDF sur
+// la cible, POSIX sur un poste de développement pour le profilage et les sanitizers.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <lwip/sockets.h>
+#else
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#endif
+
+namespace esphome {
+namespace ftp_http_proxy {
+namespace platform {
+
+#ifdef ESP_PLATFORM
+
+// Horloge monotone en µs
+inline int64_t monotonic_us() { return esp_timer_get_time(); }
+
+// Grand tampon en PSRAM uniquement (nullptr si indisponible)
+inline void *alloc_psram(size_t size) { return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); }
+
+// Grand tampon en PSRAM en priorité, mémoire interne en secours
+inline void *alloc_buffer(size_t size) {
+  void *data = alloc_psram(size);
+  return data ? data : heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+// Tampon aligné (puissance de deux), PSRAM en priorité, mémoire interne en secours
+inline void *alloc_aligned_buffer(size_t size, size_t alignment) {
+  void *data = heap_caps_aligned_alloc(alignment, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return data ? data : heap_caps_aligned_alloc(alignment, size, MALLOC_CAP_8BIT);
+}
+
+// Tampon aligné en PSRAM uniquement (nullptr si indisponible)
+inline void *alloc_aligned_psram(size_t size, size_t alignment) {
+  return heap_caps_aligned_alloc(alignment, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+// Libère aussi les tampons alignés
+inline void free_buffer(void *data) { heap_caps_free(data); }
+
+// Boucles longues hors de la boucle principale
+inline void feed_watchdog() { ESP_ERROR_CHECK_WITHOUT_ABORT(esp_task_wdt_reset()); }
+
+class Mutex {
+ public:
+  Mutex() = default;
+  Mutex(const Mutex &) = delete;
+  Mutex &operator=(const Mutex &) = delete;
+  ~Mutex() {
+    if (handle_) vSemaphoreDelete(handle_);
+  }
+
+  bool init() {
+    if (!handle_) handle_ = xSemaphoreCreateMutex();
+    return handle_ != nullptr;
+  }
+  void lock() { xSemaphoreTake(handle_, portMAX_DELAY); }
+  void unlock() { xSemaphoreGive(handle_); }
+
+ private:
+  SemaphoreHandle_t handle_{nullptr};
+};
+
+class Semaphore {
+ public:
+  Semaphore() = default;
+  Semaphore(const Semaphore &) = delete;
+  Semaphore &operator=(const Semaphore &) = delete;
+  ~Semaphore() {
+    if (handle_) vSemaphoreDelete(handle_);
+  }
+
+  bool init(unsigned max_count, unsigned initial) {
+    handle_ = xSemaphoreCreateCounting(max_count, initial);
+    return handle_ != nullptr;
+  }
+  void give() { xSemaphoreGive(handle_); }
+  bool take(uint32_t timeout_ms) { return xSemaphoreTake(handle_, pdMS_TO_TICKS(timeout_ms)) == pdTRUE; }
+
+ private:
+  SemaphoreHandle_t handle_{nullptr};
+};
+
+#else
+
+inline int64_t monotonic_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline void *alloc_psram(size_t size) { return malloc(size); }
+inline void *alloc_buffer(size_t size) { return malloc(size); }
+inline void *alloc_aligned_buffer(size_t size, size_t alignment) {
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+inline void *alloc_aligned_psram(size_t size, size_t alignment) { return alloc_aligned_buffer(size, alignment); }
+inline void free_buffer(void *data) { free(data); }
+inline void feed_watchdog() {}
+
+class Mutex {
+ public:
+  bool init() { return true; }
+  void lock() { mutex_.lock(); }
+  void unlock() { mutex_.unlock(); }
+
+ private:
+  std::mutex mutex_;
+};
+
+class Semaphore {
+ public:
+  bool init(unsigned max_count, unsigned initial) {
+    max_count_ = max_count;
+    count_ = initial;
+    return true;
+  }
+  void give() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ < max_count_) count_++;
+    cond_.notify_one();
+  }
+  bool take(uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return count_ > 0; })) {
+      return false;
+    }
+    count_--;
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  unsigned max_count_{1};
+  unsigned count_{0};
+};
+
+#endif
+
+}  // namespace platform
+}  // namespace ftp_http_proxy
+}  // namespace esphome
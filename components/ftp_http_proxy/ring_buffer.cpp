@@ -0,0 +1,147 @@
+#include "ring_buffer.h"
+#include "platform.h"
+#ifndef ESP_PLATFORM
+#include <sys/uio.h>
+#endif
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Alignement du tampon: copies de lwIP par mots entiers, lignes de cache de la PSRAM
+static const size_t RING_BUFFER_ALIGNMENT = 64;
+
+// Remplit jusqu'à deux iovec avec au plus max_len octets des zones données
+static int build_iov(struct iovec iov[2], uint8_t *const regions[2], const size_t lengths[2], size_t max_len) {
+  int count = 0;
+  for (int i = 0; i < 2 && max_len > 0; i++) {
+    size_t len = lengths[i] < max_len ? lengths[i] : max_len;
+    if (len == 0) {
+      continue;
+    }
+    iov[count].iov_base = regions[i];
+    iov[count].iov_len = len;
+    count++;
+    max_len -= len;
+  }
+  return count;
+}
+
+bool RingBuffer::init(size_t capacity) {
+  deinit();
+
+  size_t pow2 = 1;
+  while (pow2 * 2 <= capacity) pow2 *= 2;
+
+  // PSRAM en priorité, mémoire interne en secours
+  data_ = (uint8_t *)platform::alloc_aligned_buffer(pow2, RING_BUFFER_ALIGNMENT);
+  if (!data_) {
+    return false;
+  }
+
+  reset(pow2);
+  return true;
+}
+
+bool RingBuffer::init(SlabPool &pool) {
+  deinit();
+
+  size_t pow2 = 1;
+  while (pow2 * 2 <= pool.block_size()) pow2 *= 2;
+
+  data_ = (uint8_t *)pool.acquire_or_alloc();
+  if (!data_) {
+    return false;
+  }
+
+  pool_ = &pool;
+  reset(pow2);
+  return true;
+}
+
+void RingBuffer::reset(size_t capacity) {
+  capacity_ = capacity;
+  head_.store(0);
+  tail_.store(0);
+}
+
+void RingBuffer::deinit() {
+  if (data_) {
+    if (pool_) {
+      pool_->release(data_);
+    } else {
+      platform::free_buffer(data_);
+    }
+    data_ = nullptr;
+  }
+  pool_ = nullptr;
+  capacity_ = 0;
+}
+
+uint8_t *RingBuffer::write_ptr(size_t &len) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  size_t tail = tail_.load(std::memory_order_acquire);
+  size_t offset = head & (capacity_ - 1);
+  size_t free_total = capacity_ - (head - tail);
+  len = free_total < capacity_ - offset ? free_total : capacity_ - offset;
+  return data_ + offset;
+}
+
+const uint8_t *RingBuffer::read_ptr(size_t &len) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t head = head_.load(std::memory_order_acquire);
+  size_t offset = tail & (capacity_ - 1);
+  size_t used = head - tail;
+  len = used < capacity_ - offset ? used : capacity_ - offset;
+  return data_ + offset;
+}
+
+size_t RingBuffer::read_regions(const uint8_t *regions[2], size_t lengths[2]) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t head = head_.load(std::memory_order_acquire);
+  size_t offset = tail & (capacity_ - 1);
+  size_t used = head - tail;
+  lengths[0] = used < capacity_ - offset ? used : capacity_ - offset;
+  lengths[1] = used - lengths[0];
+  regions[0] = data_ + offset;
+  regions[1] = data_;
+  return used;
+}
+
+int RingBuffer::recv_from(int sock, size_t max_len, int flags) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  size_t tail = tail_.load(std::memory_order_acquire);
+  size_t offset = head & (capacity_ - 1);
+  size_t free_total = capacity_ - (head - tail);
+  uint8_t *regions[2] = {data_ + offset, data_};
+  size_t lengths[2];
+  lengths[0] = free_total < capacity_ - offset ? free_total : capacity_ - offset;
+  lengths[1] = free_total - lengths[0];
+
+  struct iovec iov[2];
+  struct msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = build_iov(iov, regions, lengths, max_len);
+  if (msg.msg_iovlen == 0) {
+    return 0;
+  }
+  return recvmsg(sock, &msg, flags);
+}
+
+int RingBuffer::send_to(int sock, size_t max_len, int flags) {
+  const uint8_t *regions[2];
+  size_t lengths[2];
+  read_regions(regions, lengths);
+  uint8_t *writable[2] = {(uint8_t *)regions[0], (uint8_t *)regions[1]};
+
+  struct iovec iov[2];
+  struct msghdr msg = {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = build_iov(iov, writable, lengths, max_len);
+  if (msg.msg_iovlen == 0) {
+    return 0;
+  }
+  return sendmsg(sock, &msg, flags);
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "slab_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Tampon circulaire lock-free à un seul producteur et un seul consommateur.
+// Les zones contiguës sont exposées directement pour que recv()/send()
+// lisent et écrivent dans le tampon sans copie intermédiaire; recv_from() et
+// send_to() franchissent la fin du tampon en un seul appel (scatter/gather).
+class RingBuffer {
+ public:
+  RingBuffer() = default;
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+  ~RingBuffer() { deinit(); }
+
+  // La capacité est arrondie à la puissance de deux inférieure
+  bool init(size_t capacity);
+  // Stockage emprunté à une réserve (blocs en puissance de deux), rendu par deinit();
+  // le tas prend le relais si la réserve est vide
+  bool init(SlabPool &pool);
+  void deinit();
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  size_t free_space() const { return capacity_ - size(); }
+
+  // Côté producteur: zone libre contiguë, puis validation des octets écrits
+  uint8_t *write_ptr(size_t &len);
+  void commit_write(size_t len) { head_.store(head_.load(std::memory_order_relaxed) + len, std::memory_order_release); }
+
+  // Côté consommateur: zone remplie contiguë, puis libération des octets lus
+  const uint8_t *read_ptr(size_t &len);
+  void commit_read(size_t len) { tail_.store(tail_.load(std::memory_order_relaxed) + len, std::memory_order_release); }
+  // Les deux zones remplies, la seconde vide si les données ne franchissent pas la
+  // fin du tampon; retourne le total
+  size_t read_regions(const uint8_t *regions[2], size_t lengths[2]);
+
+  // Réception directe dans les zones libres, au plus max_len octets à valider par
+  // commit_write(). Résultat de recvmsg().
+  int recv_from(int sock, size_t max_len, int flags);
+  // Envoi direct des zones remplies, au plus max_len octets à libérer par
+  // commit_read(). Résultat de sendmsg().
+  int send_to(int sock, size_t max_len, int flags);
+
+ private:
+  void reset(size_t capacity);
+
+  uint8_t *data_{nullptr};
+  size_t capacity_{0};
+  SlabPool *pool_{nullptr};  // Propriétaire de data_, nullptr: allocation propre
+  std::atomic<size_t> head_{0};  // Total des octets écrits
+  std::atomic<size_t> tail_{0};  // Total des octets lus
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,70 @@
+#include "share_store.h"
+#include <climits>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+bool ShareStore::add(const std::string &path, const std::string &token, int64_t expiry) {
+  if (!shares_.emplace(token, ShareLink{path, token, expiry}).second) {
+    return false;
+  }
+  deadlines_.emplace(expiry, token);
+  return true;
+}
+
+bool ShareStore::remove(const std::string &token) {
+  if (shares_.erase(token) == 0) {
+    return false;
+  }
+  // Reconstruire le tas s'il est encombré d'entrées obsolètes
+  if (deadlines_.size() > 2 * shares_.size() + 16) {
+    compact_heap();
+  }
+  return true;
+}
+
+bool ShareStore::find(const std::string &token, int64_t now, ShareLink &out) const {
+  auto it = shares_.find(token);
+  if (it == shares_.end() || it->second.expiry < now) {
+    return false;
+  }
+  out = it->second;
+  return true;
+}
+
+size_t ShareStore::expire(int64_t now) {
+  size_t removed = 0;
+  while (!deadlines_.empty() && deadlines_.top().first < now) {
+    const Deadline &top = deadlines_.top();
+    auto it = shares_.find(top.second);
+    if (it != shares_.end() && it->second.expiry == top.first) {
+      shares_.erase(it);
+      removed++;
+    }
+    deadlines_.pop();
+  }
+  return removed;
+}
+
+int64_t ShareStore::next_expiry() const {
+  return deadlines_.empty() ? INT64_MAX : deadlines_.top().first;
+}
+
+void ShareStore::for_each(const std::function<void(const ShareLink &)> &callback) const {
+  for (const auto &entry : shares_) {
+    callback(entry.second);
+  }
+}
+
+void ShareStore::compact_heap() {
+  std::vector<Deadline> live;
+  live.reserve(shares_.size());
+  for (const auto &entry : shares_) {
+    live.emplace_back(entry.second.expiry, entry.first);
+  }
+  deadlines_ = std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>(
+      std::greater<Deadline>(), std::move(live));
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
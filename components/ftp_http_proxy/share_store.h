@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Lien de partage d'un fichier
+struct ShareLink {
+  std::string path;
+  std::string token;
+  int64_t expiry;  // Timestamp d'expiration (secondes)
+};
+
+// Table des partages indexée par token, avec un tas des échéances pour que
+// l'expiration ne coûte rien tant qu'aucun lien n'arrive à terme.
+// Non synchronisée: l'appelant sérialise les accès.
+class ShareStore {
+ public:
+  // Retourne false si le token existe déjà
+  bool add(const std::string &path, const std::string &token, int64_t expiry);
+  bool remove(const std::string &token);
+  // Recherche O(1); un lien échu mais pas encore purgé n'est pas retourné
+  bool find(const std::string &token, int64_t now, ShareLink &out) const;
+  bool contains(const std::string &token) const { return shares_.count(token) != 0; }
+
+  // Supprime les liens échus et retourne leur nombre
+  size_t expire(int64_t now);
+  // Prochaine échéance (INT64_MAX si aucun lien)
+  int64_t next_expiry() const;
+
+  size_t size() const { return shares_.size(); }
+  void for_each(const std::function<void(const ShareLink &)> &callback) const;
+
+ private:
+  using Deadline = std::pair<int64_t, std::string>;
+
+  void compact_heap();
+
+  std::unordered_map<std::string, ShareLink> shares_;
+  // Les entrées du tas devenues obsolètes (lien supprimé) sont ignorées au dépilage
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,176 @@
+#include "shared_download.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Envoi max par client et par passage: un client lent ne retient pas longtemps le meneur
+static const size_t FOLLOWER_SEND_CHUNK = 4096;
+// Passages successifs max par appel à pump()
+static const int FOLLOWER_PUMP_ROUNDS = 8;
+
+SharedDownload::~SharedDownload() {
+  if (window_) {
+    platform::free_buffer(window_);
+  }
+}
+
+bool SharedDownload::init(size_t window_size) {
+  if (!window_) {
+    window_ = (uint8_t *)platform::alloc_psram(window_size);
+    capacity_ = window_ ? window_size : 0;
+  }
+  return mutex_.init() && window_;
+}
+
+void SharedDownload::start(const std::string &path) {
+  this->reset();
+  path_ = path;
+}
+
+void SharedDownload::reset() {
+  path_.clear();
+  written_ = 0;
+  content_length_ = -1;
+  accepting_ = true;
+  pending_.clear();
+  followers_.clear();
+}
+
+bool SharedDownload::attach(FileTransferContext *ctx, int sock) {
+  mutex_.lock();
+  bool attached = accepting_;
+  if (attached) {
+    pending_.push_back(Follower{ctx, sock, 0, false});
+  }
+  mutex_.unlock();
+  return attached;
+}
+
+void SharedDownload::take_pending() {
+  mutex_.lock();
+  if (!pending_.empty()) {
+    followers_.insert(followers_.end(), pending_.begin(), pending_.end());
+    pending_.clear();
+  }
+  mutex_.unlock();
+}
+
+void SharedDownload::append(const uint8_t *data, size_t len, const Sink &sink) {
+  take_pending();
+
+  // Ces octets vont écraser le début de la fenêtre: détacher les clients qui ne l'ont pas lu
+  size_t oldest_kept = written_ + len > capacity_ ? written_ + len - capacity_ : 0;
+  for (auto it = followers_.begin(); it != followers_.end();) {
+    if (it->cursor < oldest_kept) {
+      sink.detach(it->ctx, it->cursor);
+      it = followers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  while (len > 0) {
+    size_t pos = written_ % capacity_;
+    size_t n = std::min(len, capacity_ - pos);
+    memcpy(window_ + pos, data, n);
+    data += n;
+    len -= n;
+    written_ += n;
+  }
+
+  // Le début du fichier est écrasé: plus aucun nouveau client ne peut s'y rattacher
+  if (written_ > capacity_) {
+    mutex_.lock();
+    accepting_ = false;
+    mutex_.unlock();
+  }
+}
+
+bool SharedDownload::send_some(Follower &follower, const Sink &sink) {
+  if (!follower.started) {
+    if (!sink.begin(follower.ctx, content_length_)) {
+      return false;
+    }
+    follower.started = true;
+  }
+  size_t pos = follower.cursor % capacity_;
+  size_t n = std::min({written_ - follower.cursor, capacity_ - pos, FOLLOWER_SEND_CHUNK});
+  int sent = sink.send(follower.ctx, window_ + pos, n);
+  if (sent < 0) {
+    return false;
+  }
+  follower.cursor += sent;
+  return true;
+}
+
+void SharedDownload::pump(uint32_t timeout_ms, const Sink &sink) {
+  take_pending();
+
+  for (int round = 0; round < FOLLOWER_PUMP_ROUNDS; round++) {
+    fd_set write_fds;
+    FD_ZERO(&write_fds);
+    int max_fd = -1;
+    for (const auto &follower : followers_) {
+      if (follower.cursor < written_) {
+        FD_SET(follower.sock, &write_fds);
+        max_fd = std::max(max_fd, follower.sock);
+      }
+    }
+    if (max_fd < 0) {
+      return;  // Tous les clients sont à jour
+    }
+
+    struct timeval tv = {.tv_sec = (time_t)(timeout_ms / 1000), .tv_usec = (suseconds_t)((timeout_ms % 1000) * 1000)};
+    if (select(max_fd + 1, NULL, &write_fds, NULL, &tv) <= 0) {
+      return;
+    }
+    timeout_ms = 0;  // Les passages suivants ne font que profiter des sockets déjà prêts
+
+    for (auto it = followers_.begin(); it != followers_.end();) {
+      if (it->cursor < written_ && FD_ISSET(it->sock, &write_fds) && !send_some(*it, sink)) {
+        sink.finish(it->ctx, false);  // Client parti
+        it = followers_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void SharedDownload::finish(bool complete, uint32_t drain_ms, const Sink &sink) {
+  mutex_.lock();
+  accepting_ = false;
+  mutex_.unlock();
+  take_pending();
+
+  // Servir les retardataires avec ce qui reste dans la fenêtre, le temps imparti
+  int64_t deadline = platform::monotonic_us() + (int64_t)drain_ms * 1000;
+  while (complete && !followers_.empty()) {
+    for (auto it = followers_.begin(); it != followers_.end();) {
+      if (it->cursor == written_) {
+        // Fichier vide: la réponse n'a pas encore commencé
+        bool started = it->started || sink.begin(it->ctx, content_length_);
+        sink.finish(it->ctx, started);
+        it = followers_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    int64_t remaining_us = deadline - platform::monotonic_us();
+    if (followers_.empty() || remaining_us <= 0) {
+      break;
+    }
+    pump((uint32_t)((remaining_us + 999) / 1000), sink);
+  }
+
+  // Les autres reprennent avec leur propre transfert à l'octet atteint
+  for (auto &follower : followers_) {
+    sink.detach(follower.ctx, follower.cursor);
+  }
+  followers_.clear();
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "platform.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+struct FileTransferContext;
+
+// Téléchargement complet d'un fichier, partagé entre plusieurs clients HTTP.
+// Le transfert meneur lit le fichier une seule fois et conserve une fenêtre
+// des derniers octets reçus; les clients rattachés y lisent chacun à leur
+// rythme via leur propre curseur. Un client qui prend plus d'une fenêtre de
+// retard est rendu à l'appelant pour reprendre avec son propre transfert FTP.
+//
+// attach() est appelable depuis n'importe quelle tâche; toutes les autres
+// méthodes sont réservées à la tâche du meneur.
+class SharedDownload {
+ public:
+  // Actions sur un client rattaché, fournies par le proxy
+  struct Sink {
+    // Début de réponse d'un client, avant son premier envoi
+    std::function<bool(FileTransferContext *ctx, int64_t content_length)> begin;
+    // Un seul envoi sans attente: octets acceptés (0 si le socket est plein), -1 si
+    // le client est parti. L'attente de place est laissée au select() de pump().
+    std::function<int(FileTransferContext *ctx, const uint8_t *data, size_t len)> send;
+    // Reprendre le client avec son propre transfert à partir de offset
+    std::function<void(FileTransferContext *ctx, size_t offset)> detach;
+    // Terminer la réponse du client (complete: fichier entièrement envoyé)
+    std::function<void(FileTransferContext *ctx, bool complete)> finish;
+  };
+
+  SharedDownload() = default;
+  SharedDownload(const SharedDownload &) = delete;
+  SharedDownload &operator=(const SharedDownload &) = delete;
+  ~SharedDownload();
+
+  // Fenêtre allouée au premier appel et gardée d'un téléchargement à l'autre
+  bool init(size_t window_size);
+  // Nouveau téléchargement du fichier path
+  void start(const std::string &path);
+  // Retour au pool: plus aucun client, la fenêtre reste allouée
+  void reset();
+  const std::string &path() const { return path_; }
+  // Taille annoncée aux clients rattachés; à fixer avant le premier append(), le
+  // partage n'est possible qu'avec une taille connue
+  void set_content_length(int64_t length) { content_length_ = length; }
+
+  // Rattache un client tant que le début du fichier est encore dans la fenêtre
+  bool attach(FileTransferContext *ctx, int sock);
+
+  // Ajoute des octets reçus du serveur; les clients qu'ils écraseraient sont détachés
+  void append(const uint8_t *data, size_t len, const Sink &sink);
+  // Envoie aux clients prêts à recevoir, en attendant au plus timeout_ms qu'un socket le soit
+  void pump(uint32_t timeout_ms, const Sink &sink);
+  // Fin du meneur: si le fichier est complet, les clients sont servis pendant au plus
+  // drain_ms; ceux qui restent, comme tous si le fichier est incomplet, sont détachés
+  // et ne retiennent pas la tâche du meneur
+  void finish(bool complete, uint32_t drain_ms, const Sink &sink);
+
+ protected:
+  struct Follower {
+    FileTransferContext *ctx;
+    int sock;
+    size_t cursor;
+    bool started;  // En-têtes envoyés
+  };
+
+  void take_pending();
+  bool send_some(Follower &follower, const Sink &sink);
+
+  std::string path_;
+  uint8_t *window_{nullptr};
+  size_t capacity_{0};
+  size_t written_{0};  // Octets reçus depuis le début du fichier
+  int64_t content_length_{-1};
+
+  platform::Mutex mutex_;  // Protège accepting_ et pending_
+  bool accepting_{true};
+  std::vector<Follower> pending_;     // Rattachés, pas encore pris en charge par le meneur
+  std::vector<Follower> followers_;
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
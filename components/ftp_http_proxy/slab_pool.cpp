@@ -0,0 +1,83 @@
+#include "slab_pool.h"
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Lignes de cache de la PSRAM, copies de lwIP par mots entiers
+static const size_t SLAB_ALIGNMENT = 64;
+
+static void *alloc_block(size_t size, SlabPool::Placement placement) {
+  return placement == SlabPool::Placement::PSRAM_ONLY ? platform::alloc_aligned_psram(size, SLAB_ALIGNMENT)
+                                                      : platform::alloc_aligned_buffer(size, SLAB_ALIGNMENT);
+}
+
+SlabPool::~SlabPool() {
+  if (arena_) {
+    platform::free_buffer(arena_);
+  }
+}
+
+bool SlabPool::init(size_t block_size, size_t block_count, Placement placement) {
+  block_size_ = (block_size + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+  placement_ = placement;
+  if (!mutex_.init() || block_count == 0) {
+    return false;
+  }
+
+  arena_ = (uint8_t *)alloc_block(block_size_ * block_count, placement);
+  if (!arena_) {
+    return false;
+  }
+  block_count_ = block_count;
+
+  // Chaînage dans l'ordre des adresses: les premiers blocs servis sont contigus
+  free_ = nullptr;
+  for (size_t i = block_count; i > 0; i--) {
+    auto *block = (FreeBlock *)(arena_ + (i - 1) * block_size_);
+    block->next = free_;
+    free_ = block;
+  }
+  free_count_.store(block_count);
+  return true;
+}
+
+void *SlabPool::acquire() {
+  mutex_.lock();
+  FreeBlock *block = free_;
+  if (block) {
+    free_ = block->next;
+    free_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  mutex_.unlock();
+  return block;
+}
+
+void *SlabPool::acquire_or_alloc() {
+  void *block = this->acquire();
+  if (!block && block_size_ > 0) {
+    block = alloc_block(block_size_, placement_);
+    if (block) {
+      fallbacks_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return block;
+}
+
+void SlabPool::release(void *block) {
+  if (!block) {
+    return;
+  }
+  if (!owns(block)) {
+    platform::free_buffer(block);
+    return;
+  }
+  auto *free_block = (FreeBlock *)block;
+  mutex_.lock();
+  free_block->next = free_;
+  free_ = free_block;
+  free_count_.fetch_add(1, std::memory_order_relaxed);
+  mutex_.unlock();
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "platform.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Réserve de blocs de même taille découpés dans une seule allocation faite au
+// démarrage. Prise et remise en O(1) par une liste libre chaînée dans les blocs
+// eux-mêmes: les transferts ne passent plus par le tas et ne le fragmentent plus
+// au fil des jours. Réserve vide ou arène impossible à allouer: acquire_or_alloc()
+// retombe sur le tas, compté dans fallbacks().
+class SlabPool {
+ public:
+  enum class Placement : uint8_t {
+    PSRAM_FIRST,  // PSRAM en priorité, mémoire interne en secours
+    PSRAM_ONLY,   // Gros tampons qui n'ont pas leur place en mémoire interne
+  };
+
+  SlabPool() = default;
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+  ~SlabPool();
+
+  // block_size est arrondi à l'alignement; false si l'arène n'a pu être allouée (la
+  // taille des blocs reste retenue pour les allocations de secours)
+  bool init(size_t block_size, size_t block_count, Placement placement = Placement::PSRAM_FIRST);
+  bool enabled() const { return arena_ != nullptr; }
+
+  // Bloc de la réserve, nullptr si elle est vide
+  void *acquire();
+  // Bloc de la réserve, ou du tas si elle est vide
+  void *acquire_or_alloc();
+  // Rend un bloc pris par l'une ou l'autre méthode
+  void release(void *block);
+  bool owns(const void *block) const {
+    return arena_ && (const uint8_t *)block >= arena_ && (const uint8_t *)block < arena_ + block_size_ * block_count_;
+  }
+
+  size_t block_size() const { return block_size_; }
+  size_t capacity() const { return block_count_; }
+  size_t available() const { return free_count_.load(std::memory_order_relaxed); }
+  uint32_t fallbacks() const { return fallbacks_.load(std::memory_order_relaxed); }
+
+ private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  uint8_t *arena_{nullptr};
+  size_t block_size_{0};
+  size_t block_count_{0};
+  Placement placement_{Placement::PSRAM_FIRST};
+  platform::Mutex mutex_;  // Protège free_
+  FreeBlock *free_{nullptr};
+  std::atomic<size_t> free_count_{0};
+  std::atomic<uint32_t> fallbacks_{0};
+};
+
+// Bloc emprunté à une réserve pour la durée d'une portée
+class SlabBlock {
+ public:
+  explicit SlabBlock(SlabPool &pool) : pool_(pool), data_((uint8_t *)pool.acquire_or_alloc()) {}
+  SlabBlock(const SlabBlock &) = delete;
+  SlabBlock &operator=(const SlabBlock &) = delete;
+  ~SlabBlock() {
+    if (data_) pool_.release(data_);
+  }
+
+  uint8_t *data() const { return data_; }
+  size_t size() const { return pool_.block_size(); }
+  explicit operator bool() const { return data_ != nullptr; }
+
+ private:
+  SlabPool &pool_;
+  uint8_t *data_;
+};
+
+// Objets construits une fois au démarrage et recyclés: les chaînes qu'ils
+// contiennent gardent leur capacité d'une requête à l'autre. T fournit reset(),
+// appelé à la remise. Au-delà de la capacité, acquire() retombe sur new.
+template<typename T> class ObjectPool {
+ public:
+  bool init(size_t count) {
+    if (!mutex_.init()) {
+      return false;
+    }
+    objects_.reset(new T[count]);
+    count_ = count;
+    free_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      free_.push_back(&objects_[i]);
+    }
+    return true;
+  }
+
+  T *acquire() {
+    T *object = nullptr;
+    mutex_.lock();
+    if (!free_.empty()) {
+      object = free_.back();
+      free_.pop_back();
+    }
+    mutex_.unlock();
+    if (!object) {
+      fallbacks_.fetch_add(1, std::memory_order_relaxed);
+      object = new T();
+    }
+    return object;
+  }
+
+  void release(T *object) {
+    if (!owns(object)) {
+      delete object;
+      return;
+    }
+    object->reset();
+    mutex_.lock();
+    free_.push_back(object);
+    mutex_.unlock();
+  }
+
+  bool owns(const T *object) const { return objects_ && object >= &objects_[0] && object < &objects_[0] + count_; }
+  size_t capacity() const { return count_; }
+  uint32_t fallbacks() const { return fallbacks_.load(std::memory_order_relaxed); }
+
+ private:
+  std::unique_ptr<T[]> objects_;
+  size_t count_{0};
+  platform::Mutex mutex_;  // Protège free_
+  std::vector<T *> free_;
+  std::atomic<uint32_t> fallbacks_{0};
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,289 @@
+#include "stream_multiplexer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#ifndef ESP_PLATFORM
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#endif
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+// Envoi max par flux et par passage: les flux se partagent équitablement les tampons lwIP
+static const size_t STREAM_SEND_CHUNK = 8192;
+// Attente max de la réponse de fin de transfert après la fermeture du canal de données
+static const int64_t FINAL_REPLY_TIMEOUT_US = 15 * 1000000LL;
+
+static bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+
+StreamMultiplexer::~StreamMultiplexer() {
+  if (wake_rx_ >= 0) close(wake_rx_);
+  if (wake_tx_ >= 0) close(wake_tx_);
+}
+
+bool StreamMultiplexer::init(size_t max_streams, size_t buffer_size, uint32_t stall_timeout_ms, Counter *bytes_in,
+                             Counter *bytes_out) {
+  if (!mutex_.init()) {
+    return false;
+  }
+
+  // Socket de réveil sur la boucle locale, port choisi par la pile
+  wake_rx_ = socket(AF_INET, SOCK_DGRAM, 0);
+  wake_tx_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (wake_rx_ < 0 || wake_tx_ < 0) {
+    return false;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addr_len = sizeof(addr);
+  if (bind(wake_rx_, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      getsockname(wake_rx_, (struct sockaddr *)&addr, &addr_len) != 0) {
+    return false;
+  }
+  wake_port_ = addr.sin_port;
+
+  // Tampons et flux préparés une fois pour toutes: aucune allocation par flux.
+  // Sans la place pour la réserve, chaque flux alloue son tampon.
+  buffers_.init(buffer_size, max_streams);
+  pending_.reserve(max_streams);
+  streams_.reserve(max_streams);
+  spare_.reserve(max_streams);
+  for (size_t i = 0; i < max_streams; i++) {
+    spare_.emplace_back(new Stream());
+  }
+
+  stall_timeout_us_ = (int64_t)stall_timeout_ms * 1000;
+  bytes_in_ = bytes_in;
+  bytes_out_ = bytes_out;
+  max_streams_ = max_streams;
+  return true;
+}
+
+bool StreamMultiplexer::add(FileTransferContext *ctx, int client_sock, int data_sock, FtpClient *control,
+                            int64_t content_length, bool range) {
+  if (!enabled()) {
+    return false;
+  }
+  if (active_.fetch_add(1) >= max_streams_) {
+    active_.fetch_sub(1);
+    return false;
+  }
+
+  mutex_.lock();
+  StreamPtr stream = std::move(spare_.back());
+  spare_.pop_back();
+  mutex_.unlock();
+  if (!stream->ring.init(buffers_)) {
+    mutex_.lock();
+    spare_.push_back(std::move(stream));
+    mutex_.unlock();
+    active_.fetch_sub(1);
+    return false;
+  }
+  stream->ctx = ctx;
+  stream->client_sock = client_sock;
+  stream->data_sock = data_sock;
+  stream->control = control;
+  stream->expected = content_length;
+  stream->remaining = range ? content_length : -1;
+  stream->state = State::STREAMING;
+  stream->data_eof = false;
+  stream->bytes_sent = 0;
+  stream->started_at = platform::monotonic_us();
+  stream->last_progress = stream->started_at;
+  stream->deadline = 0;
+
+  mutex_.lock();
+  pending_.push_back(std::move(stream));
+  wake();
+  mutex_.unlock();
+  return true;
+}
+
+void StreamMultiplexer::wake() {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = wake_port_;
+  char signal = 1;
+  sendto(wake_tx_, &signal, 1, MSG_DONTWAIT, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+void StreamMultiplexer::take_pending() {
+  mutex_.lock();
+  for (auto &stream : pending_) {
+    streams_.push_back(std::move(stream));
+  }
+  pending_.clear();
+  mutex_.unlock();
+}
+
+void StreamMultiplexer::run_once(uint32_t timeout_ms, const Handler &handler) {
+  take_pending();
+
+  // Lecture des données tant que le tampon a de la place, écriture vers le client
+  // tant qu'il contient des octets, réponse de contrôle en fin de flux
+  fd_set read_fds, write_fds;
+  FD_ZERO(&read_fds);
+  FD_ZERO(&write_fds);
+  FD_SET(wake_rx_, &read_fds);
+  int max_fd = wake_rx_;
+  for (auto &stream : streams_) {
+    if (stream->state == State::STREAMING) {
+      if (!stream->data_eof && stream->ring.free_space() > 0) {
+        FD_SET(stream->data_sock, &read_fds);
+        max_fd = std::max(max_fd, stream->data_sock);
+      }
+      if (stream->ring.size() > 0) {
+        FD_SET(stream->client_sock, &write_fds);
+        max_fd = std::max(max_fd, stream->client_sock);
+      }
+    } else {
+      FD_SET(stream->control->sock(), &read_fds);
+      max_fd = std::max(max_fd, stream->control->sock());
+    }
+  }
+
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, &tv);
+  if (ready < 0) {
+    return;
+  }
+  if (ready > 0 && FD_ISSET(wake_rx_, &read_fds)) {
+    char drain[16];
+    while (recv(wake_rx_, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+    }
+  }
+
+  int64_t now = platform::monotonic_us();
+  for (size_t i = 0; i < streams_.size();) {
+    Stream &stream = *streams_[i];
+    bool alive = true;
+    if (stream.state == State::STREAMING) {
+      if (ready > 0 && FD_ISSET(stream.data_sock, &read_fds)) {
+        alive = receive(stream, handler);
+      }
+      if (alive && ready > 0 && FD_ISSET(stream.client_sock, &write_fds)) {
+        alive = transmit(stream, handler);
+      }
+      if (alive && stream.data_eof && stream.ring.size() == 0) {
+        // Tout est envoyé: une plage s'arrête là, un fichier complet attend le 226
+        close(stream.data_sock);
+        stream.data_sock = -1;
+        if (stream.remaining == 0) {
+          close_stream(stream, Outcome::RANGE_DONE, handler);
+          alive = false;
+        } else {
+          // La réponse de fin a pu arriver avec celle du RETR: pas d'attente de select()
+          stream.state = State::FINALIZE;
+          stream.deadline = now + FINAL_REPLY_TIMEOUT_US;
+          alive = read_final_reply(stream, handler);
+        }
+      }
+      if (alive && now - stream.last_progress > stall_timeout_us_) {
+        // Tampon plein: le client ne lit plus; tampon vide: le serveur n'envoie plus
+        close_stream(stream, stream.ring.size() > 0 ? Outcome::CLIENT_STALL : Outcome::DATA_ERROR, handler);
+        alive = false;
+      }
+    } else {
+      if (ready > 0 && FD_ISSET(stream.control->sock(), &read_fds)) {
+        alive = read_final_reply(stream, handler);
+      }
+      if (alive && now > stream.deadline) {
+        close_stream(stream, Outcome::DATA_ERROR, handler);
+        alive = false;
+      }
+    }
+
+    if (alive) {
+      i++;
+    } else {
+      mutex_.lock();
+      spare_.push_back(std::move(streams_[i]));
+      mutex_.unlock();
+      streams_.erase(streams_.begin() + i);
+      active_.fetch_sub(1);
+    }
+  }
+}
+
+bool StreamMultiplexer::receive(Stream &stream, const Handler &handler) {
+  size_t len = stream.ring.free_space();
+  if (stream.remaining >= 0 && (int64_t)len > stream.remaining) {
+    len = (size_t)stream.remaining;
+  }
+  ssize_t n = stream.ring.recv_from(stream.data_sock, len, MSG_DONTWAIT);
+  if (n > 0) {
+    stream.ring.commit_write((size_t)n);
+    bytes_in_->add((uint32_t)n);
+    stream.last_progress = platform::monotonic_us();
+    if (stream.remaining >= 0) {
+      stream.remaining -= n;
+      stream.data_eof = stream.remaining == 0;
+    }
+    return true;
+  }
+  if (n == 0) {
+    stream.data_eof = true;
+    return true;
+  }
+  if (would_block()) {
+    return true;
+  }
+  close_stream(stream, Outcome::DATA_ERROR, handler);
+  return false;
+}
+
+bool StreamMultiplexer::transmit(Stream &stream, const Handler &handler) {
+  ssize_t n = stream.ring.send_to(stream.client_sock, STREAM_SEND_CHUNK, MSG_DONTWAIT);
+  if (n > 0) {
+    if (stream.bytes_sent == 0) {
+      handler.first_byte(stream.ctx);
+    }
+    stream.ring.commit_read((size_t)n);
+    stream.bytes_sent += (size_t)n;
+    bytes_out_->add((uint32_t)n);
+    stream.last_progress = platform::monotonic_us();
+    return true;
+  }
+  if (n < 0 && would_block()) {
+    return true;
+  }
+  close_stream(stream, Outcome::CLIENT_ERROR, handler);
+  return false;
+}
+
+bool StreamMultiplexer::read_final_reply(Stream &stream, const Handler &handler) {
+  FtpReply reply;
+  FtpClient::Poll poll = stream.control->poll_reply(reply);
+  if (poll == FtpClient::Poll::PENDING) {
+    return true;
+  }
+  bool ok = poll == FtpClient::Poll::REPLY && reply.transfer_complete();
+  // Fichier modifié entre SIZE et RETR: la longueur annoncée est fausse
+  if (ok && stream.expected >= 0 && (int64_t)stream.bytes_sent != stream.expected) {
+    ok = false;
+  }
+  close_stream(stream, ok ? Outcome::COMPLETE : Outcome::DATA_ERROR, handler);
+  return false;
+}
+
+void StreamMultiplexer::close_stream(Stream &stream, Outcome outcome, const Handler &handler) {
+  if (stream.data_sock >= 0) {
+    close(stream.data_sock);
+    stream.data_sock = -1;
+  }
+  stream.ring.deinit();
+  handler.finish(stream.ctx, stream.control, outcome, stream.bytes_sent, stream.started_at);
+}
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
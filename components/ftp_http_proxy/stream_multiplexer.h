@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ftp_client.h"
+#include "metrics.h"
+#include "platform.h"
+#include "ring_buffer.h"
+#include "slab_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace esphome {
+namespace ftp_http_proxy {
+
+struct FileTransferContext;
+
+// Boucle d'événements unique pour la phase d'envoi des transferts: une fois le
+// RETR accepté et les en-têtes HTTP partis, le worker confie le socket de données,
+// la connexion de contrôle et le socket client à cette boucle et redevient libre.
+// Chaque flux est une petite machine à états (envoi, puis attente du 226) menée
+// par select() sur des sockets non bloquants; un client lent ne coûte plus qu'un
+// tampon, sans pile de tâche.
+//
+// add() est appelable depuis n'importe quelle tâche; run_once() est réservée à
+// la tâche de la boucle.
+class StreamMultiplexer {
+ public:
+  enum class Outcome : uint8_t {
+    COMPLETE,      // Fichier envoyé et 226 reçu: connexion de contrôle réutilisable
+    RANGE_DONE,    // Plage envoyée avant la fin du fichier: RETR interrompu
+    DATA_ERROR,    // Canal de données ou réponse de fin en erreur
+    CLIENT_ERROR,  // Client HTTP parti
+    CLIENT_STALL,  // Client HTTP bloqué
+  };
+
+  // Actions sur les flux, fournies par le proxy
+  struct Handler {
+    // Premier octet du corps envoyé
+    std::function<void(FileTransferContext *ctx)> first_byte;
+    // Fin du flux: la connexion de contrôle et la requête sont rendues à l'appelant
+    std::function<void(FileTransferContext *ctx, FtpClient *control, Outcome outcome, size_t bytes_sent,
+                       int64_t started_at)>
+        finish;
+  };
+
+  StreamMultiplexer() = default;
+  StreamMultiplexer(const StreamMultiplexer &) = delete;
+  StreamMultiplexer &operator=(const StreamMultiplexer &) = delete;
+  ~StreamMultiplexer();
+
+  // max_streams: flux simultanés; buffer_size: tampon de chaque flux, pris dans
+  // une réserve allouée ici
+  bool init(size_t max_streams, size_t buffer_size, uint32_t stall_timeout_ms, Counter *bytes_in,
+            Counter *bytes_out);
+  bool enabled() const { return max_streams_ > 0; }
+  size_t active() const { return active_.load(std::memory_order_relaxed); }
+  const SlabPool &buffers() const { return buffers_; }
+
+  // Confie un flux à la boucle, en-têtes HTTP déjà envoyés (range: la lecture s'arrête
+  // après content_length octets sans attendre la fin du fichier). La connexion de
+  // contrôle est empruntée telle quelle, avec les octets de réponse déjà reçus, et
+  // rendue par finish. false si la boucle est pleine ou sans mémoire: l'appelant
+  // garde le transfert.
+  bool add(FileTransferContext *ctx, int client_sock, int data_sock, FtpClient *control,
+           int64_t content_length, bool range);
+
+  // Un passage de la boucle: attend au plus timeout_ms un socket prêt
+  void run_once(uint32_t timeout_ms, const Handler &handler);
+
+ protected:
+  enum class State : uint8_t {
+    STREAMING,  // Données FTP -> client HTTP
+    FINALIZE,   // Canal de données fermé, attente du 226 sur la connexion de contrôle
+  };
+
+  struct Stream {
+    FileTransferContext *ctx{nullptr};
+    int client_sock{-1};
+    int data_sock{-1};
+    int64_t expected{-1};    // Longueur annoncée au client
+    int64_t remaining{-1};   // Octets encore attendus du serveur (-1: jusqu'à la fin)
+    State state{State::STREAMING};
+    bool data_eof{false};
+    size_t bytes_sent{0};
+    int64_t started_at{0};     // µs
+    int64_t last_progress{0};  // µs: dernier octet reçu ou envoyé
+    int64_t deadline{0};       // µs: attente du 226 jusqu'à
+    RingBuffer ring;
+    FtpClient *control{nullptr};
+  };
+  using StreamPtr = std::unique_ptr<Stream>;
+
+  void take_pending();
+  void wake();
+  // Retournent false quand le flux est terminé (finish déjà appelé)
+  bool receive(Stream &stream, const Handler &handler);
+  bool transmit(Stream &stream, const Handler &handler);
+  bool read_final_reply(Stream &stream, const Handler &handler);
+  void close_stream(Stream &stream, Outcome outcome, const Handler &handler);
+
+  size_t max_streams_{0};
+  int64_t stall_timeout_us_{0};
+  Counter *bytes_in_{nullptr};
+  Counter *bytes_out_{nullptr};
+
+  // Réveil de select() lors d'un ajout: datagramme sur un socket UDP local
+  int wake_rx_{-1};
+  int wake_tx_{-1};
+  uint16_t wake_port_{0};  // Port de wake_rx_ sur 127.0.0.1, ordre réseau
+
+  platform::Mutex mutex_;  // Protège pending_, spare_ et wake_tx_
+  std::vector<StreamPtr> pending_;  // Confiés, pas encore pris en charge par la boucle
+  std::vector<StreamPtr> streams_;
+  std::vector<StreamPtr> spare_;    // Flux terminés, réutilisés par add()
+  SlabPool buffers_;                // Tampons des flux
+  std::atomic<size_t> active_{0};   // pending_ + streams_
+};
+
+}  // namespace ftp_http_proxy
+}  // namespace esphome
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Aléa de qualité cryptographique (getrandom), comme le générateur matériel de la cible
+uint32_t esp_random();
@@ -0,0 +1,113 @@
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "esphome/core/log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <sys/random.h>
+
+// Tas interne rapporté: au-dessus du seuil haut de la régulation des envois
+static const size_t HOST_INTERNAL_HEAP = 256 * 1024;
+static const size_t HOST_PSRAM = 8 * 1024 * 1024;
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_FAIL:
+      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+      return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+      return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+      return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+      return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_INITIALIZED:
+      return "ESP_ERR_NVS_NOT_INITIALIZED";
+    case ESP_ERR_NVS_NOT_FOUND:
+      return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_HANDLE:
+      return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE:
+      return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_LENGTH:
+      return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_NO_FREE_PAGES:
+      return "ESP_ERR_NVS_NO_FREE_PAGES";
+    case ESP_ERR_NVS_NEW_VERSION_FOUND:
+      return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+    case ESP_ERR_NVS_PART_NOT_FOUND:
+      return "ESP_ERR_NVS_PART_NOT_FOUND";
+    case ESP_ERR_HTTPD_INVALID_REQ:
+      return "ESP_ERR_HTTPD_INVALID_REQ";
+    case ESP_ERR_HTTPD_RESULT_TRUNC:
+      return "ESP_ERR_HTTPD_RESULT_TRUNC";
+    default:
+      return "UNKNOWN ERROR";
+  }
+}
+
+uint32_t esp_random() {
+  uint32_t value = 0;
+  if (getrandom(&value, sizeof(value), 0) != sizeof(value)) {
+    abort();
+  }
+  return value;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info) {
+  memset(ap_info, 0, sizeof(*ap_info));
+  strncpy((char *)ap_info->ssid, "hôte", sizeof(ap_info->ssid) - 1);
+  return ESP_OK;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+void *heap_caps_calloc(size_t n, size_t size, uint32_t) { return calloc(n, size); }
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t) {
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+void heap_caps_free(void *ptr) { free(ptr); }
+size_t heap_caps_get_free_size(uint32_t caps) { return caps & MALLOC_CAP_SPIRAM ? HOST_PSRAM : HOST_INTERNAL_HEAP; }
+size_t heap_caps_get_minimum_free_size(uint32_t caps) { return heap_caps_get_free_size(caps); }
+size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+
+namespace esphome {
+
+static std::atomic<int> log_level{-1};
+static std::mutex log_mutex;
+
+void host_log_set_level(int level) { log_level = level; }
+
+bool host_log_enabled(int level) {
+  if (log_level.load(std::memory_order_relaxed) < 0) {
+    const char *env = getenv("FTP_PROXY_LOG_LEVEL");
+    log_level.store(env ? atoi(env) : HOST_LOG_INFO);
+  }
+  return level <= log_level;
+}
+
+void host_log(int level, const char *tag, int line, const char *format, ...) {
+  static const char LETTERS[] = "EWIDV";
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  va_list args;
+  va_start(args, format);
+  std::lock_guard<std::mutex> lock(log_mutex);
+  fprintf(stderr, "[%5ld.%03ld][%c][%s:%03d]: ", (long)now.tv_sec, now.tv_nsec / 1000000L, LETTERS[level], tag, line);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+}  // namespace esphome
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Horloge monotone en µs depuis le démarrage du programme, comme esp_timer
+// depuis celui de la carte
+inline int64_t esp_timer_get_time() {
+  static const auto boot = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "esp_err.h"
+#include <cstdint>
+
+typedef struct {
+  uint8_t ssid[33];
+  int8_t rssi;
+} wifi_ap_record_t;
+
+// Le poste est toujours « connecté »: le réseau est celui de l'hôte
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
@@ -0,0 +1,21 @@
+#pragma once
+
+// Strict nécessaire de la classe Component d'ESPHome: le programme hôte appelle
+// setup() puis loop() comme le ferait l'application.
+
+namespace esphome {
+
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+
+  void mark_failed() { failed_ = true; }
+  bool is_failed() const { return failed_; }
+
+ protected:
+  bool failed_{false};
+};
+
+}  // namespace esphome
@@ -0,0 +1,26 @@
+#pragma once
+
+// Journal sur stderr, au format d'ESPHome. Niveau choisi par host_log_set_level()
+// ou la variable d'environnement FTP_PROXY_LOG_LEVEL (0: erreurs ... 4: verbeux).
+
+namespace esphome {
+
+enum HostLogLevel { HOST_LOG_ERROR = 0, HOST_LOG_WARN, HOST_LOG_INFO, HOST_LOG_DEBUG, HOST_LOG_VERBOSE };
+
+void host_log_set_level(int level);
+bool host_log_enabled(int level);
+void host_log(int level, const char *tag, int line, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+}  // namespace esphome
+
+#define ESP_HOST_LOG(level, tag, ...) \
+  do { \
+    if (::esphome::host_log_enabled(level)) ::esphome::host_log(level, tag, __LINE__, __VA_ARGS__); \
+  } while (0)
+
+#define ESP_LOGE(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESP_HOST_LOG(::esphome::HOST_LOG_VERBOSE, tag, __VA_ARGS__)
@@ -0,0 +1,188 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Attente bornée en ticks (ms), ou sans limite pour portMAX_DELAY
+template<typename Predicate>
+static bool wait_for(std::condition_variable &cond, std::unique_lock<std::mutex> &lock, TickType_t ticks,
+                     Predicate ready) {
+  if (ticks == portMAX_DELAY) {
+    cond.wait(lock, ready);
+    return true;
+  }
+  return cond.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// Sémaphores
+
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable cond;
+  UBaseType_t max_count;
+  UBaseType_t count;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore{{}, {}, 1, 1}; }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore{{}, {}, 1, 0}; }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+  return new HostSemaphore{{}, {}, max_count, initial_count};
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (!wait_for(semaphore->cond, lock, ticks, [semaphore] { return semaphore->count > 0; })) {
+    return pdFALSE;
+  }
+  semaphore->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  std::lock_guard<std::mutex> lock(semaphore->mutex);
+  if (semaphore->count >= semaphore->max_count) {
+    return pdFALSE;
+  }
+  semaphore->count++;
+  semaphore->cond.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+// Files
+
+struct HostQueue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  size_t length;
+  size_t item_size;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  auto *queue = new HostQueue();
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_for(queue->changed, lock, ticks, [queue] { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+  const auto *bytes = (const uint8_t *)item;
+  queue->items.emplace_back(bytes, bytes + queue->item_size);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_for(queue->changed, lock, ticks, [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->item_size);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->items.size();
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+// Tâches
+
+struct HostTask {
+  std::string name;
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t notify_count{0};
+};
+
+// Levée par vTaskDelete(NULL) et rattrapée à la sortie du thread
+struct HostTaskExit {};
+
+static thread_local HostTask *current_task = nullptr;
+// Descripteur des threads adoptés par xTaskGetCurrentTaskHandle()
+static thread_local std::unique_ptr<HostTask> adopted_task;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t, void *param,
+                       UBaseType_t, TaskHandle_t *created) {
+  // Un descripteur remis à l'appelant reste valide pour les notifications, même
+  // après la fin de la tâche; les autres disparaissent avec elle
+  auto *task = new HostTask();
+  task->name = name ? name : "";
+  if (created) {
+    *created = task;
+  }
+  bool owned = created == nullptr;
+  std::thread([function, param, task, owned] {
+    current_task = task;
+    try {
+      function(param);
+    } catch (const HostTaskExit &) {
+    }
+    if (owned) {
+      delete task;
+    }
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t) {
+  return xTaskCreate(function, name, stack_depth, param, priority, created);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == current_task) {
+    throw HostTaskExit();
+  }
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+TickType_t xTaskGetTickCount() { return (TickType_t)(esp_timer_get_time() / 1000); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // Threads qui ne sont pas des tâches (programme principal, serveur HTTP)
+  if (!current_task) {
+    adopted_task.reset(new HostTask());
+    current_task = adopted_task.get();
+  }
+  return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->notify_count++;
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+  HostTask *task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (!wait_for(task->notified, lock, ticks, [task] { return task->notify_count > 0; })) {
+    return 0;
+  }
+  uint32_t count = task->notify_count;
+  task->notify_count = clear_on_exit ? 0 : count - 1;
+  return count;
+}
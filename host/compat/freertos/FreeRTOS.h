@@ -0,0 +1,21 @@
+#pragma once
+
+// FreeRTOS sur threads POSIX: un tick vaut une milliseconde, les priorités et
+// l'affinité de cœur sont ignorées, les piles sont celles des threads de l'hôte.
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
+#define configMAX_TASK_NAME_LEN 16  // CONFIG_FREERTOS_MAX_TASK_NAME_LEN par défaut
@@ -0,0 +1,549 @@
+#include "esp_http_server.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// En-têtes d'une requête: au-delà, 431
+static const size_t MAX_REQUEST_HEADERS_SIZE = 8192;
+
+struct HttpServer;
+
+// Connexion HTTP: requête en cours, état de sa réponse et requêtes détachées
+struct HttpSession {
+  HttpServer *server{nullptr};
+  int fd{-1};
+  std::string input;  // Reçu au-delà des en-têtes de la requête en cours
+
+  // Requête en cours
+  httpd_req_t req{};
+  std::vector<std::pair<std::string, std::string>> headers;
+  size_t body_remaining{0};
+
+  // Réponse en cours
+  std::string status;
+  std::string content_type;
+  std::vector<std::pair<std::string, std::string>> resp_headers;
+  bool chunked{false};
+
+  std::mutex mutex;
+  std::condition_variable async_done;
+  int async_pending{0};
+  bool close_requested{false};
+};
+
+struct HttpServer {
+  httpd_config_t config{};
+  int listen_fd{-1};
+  std::vector<httpd_uri_t> handlers;
+  std::mutex handlers_mutex;  // Gestionnaires appelés un par un, comme par la tâche serveur de la cible
+  std::mutex sessions_mutex;
+  std::vector<HttpSession *> sessions;
+};
+
+static HttpSession *session_of(httpd_req_t *req) { return (HttpSession *)req->aux; }
+
+static bool send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static std::string status_for(httpd_err_code_t error) {
+  switch (error) {
+    case HTTPD_501_METHOD_NOT_IMPLEMENTED:
+      return "501 Method Not Implemented";
+    case HTTPD_505_VERSION_NOT_SUPPORTED:
+      return "505 Version Not Supported";
+    case HTTPD_400_BAD_REQUEST:
+      return "400 Bad Request";
+    case HTTPD_401_UNAUTHORIZED:
+      return "401 Unauthorized";
+    case HTTPD_403_FORBIDDEN:
+      return "403 Forbidden";
+    case HTTPD_404_NOT_FOUND:
+      return "404 Not Found";
+    case HTTPD_405_METHOD_NOT_ALLOWED:
+      return "405 Method Not Allowed";
+    case HTTPD_408_REQ_TIMEOUT:
+      return "408 Request Timeout";
+    case HTTPD_411_LENGTH_REQUIRED:
+      return "411 Length Required";
+    case HTTPD_414_URI_TOO_LONG:
+      return "414 URI Too Long";
+    case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE:
+      return "431 Request Header Fields Too Large";
+    default:
+      // Comme sur la cible, un code inconnu devient une erreur interne
+      return "500 Internal Server Error";
+  }
+}
+
+static std::string response_head(HttpSession *session) {
+  std::string head = "HTTP/1.1 " + session->status + "\r\nContent-Type: " + session->content_type + "\r\n";
+  for (const auto &header : session->resp_headers) {
+    head += header.first + ": " + header.second + "\r\n";
+  }
+  return head;
+}
+
+static int method_of(const std::string &name) {
+  static const std::pair<const char *, httpd_method_t> METHODS[] = {
+      {"DELETE", HTTP_DELETE}, {"GET", HTTP_GET},         {"HEAD", HTTP_HEAD},
+      {"POST", HTTP_POST},     {"PUT", HTTP_PUT},         {"OPTIONS", HTTP_OPTIONS},
+  };
+  for (const auto &method : METHODS) {
+    if (name == method.first) {
+      return method.second;
+    }
+  }
+  return -1;
+}
+
+static void send_error(HttpSession *session, httpd_err_code_t error, const char *message) {
+  session->status = status_for(error);
+  session->content_type = "text/html";
+  session->resp_headers.clear();
+  httpd_resp_send(&session->req, message, HTTPD_RESP_USE_STRLEN);
+}
+
+// Lit et analyse les en-têtes de la requête suivante; false: connexion à fermer
+static bool read_request(HttpSession *session) {
+  size_t end;
+  while ((end = session->input.find("\r\n\r\n")) == std::string::npos) {
+    if (session->input.size() > MAX_REQUEST_HEADERS_SIZE) {
+      send_error(session, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, "En-têtes trop longs");
+      return false;
+    }
+    char buf[2048];
+    ssize_t n = recv(session->fd, buf, sizeof(buf), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && session->input.empty()) {
+      continue;  // Connexion persistante au repos
+    }
+    if (n <= 0) {
+      return false;
+    }
+    session->input.append(buf, n);
+  }
+  std::string head = session->input.substr(0, end);
+  session->input.erase(0, end + 4);
+
+  size_t line_end = head.find("\r\n");
+  std::string request_line = head.substr(0, line_end);
+  size_t sp1 = request_line.find(' ');
+  size_t sp2 = request_line.rfind(' ');
+  if (sp1 == std::string::npos || sp2 == sp1) {
+    send_error(session, HTTPD_400_BAD_REQUEST, "Requête invalide");
+    return false;
+  }
+  std::string uri = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+  if (uri.size() > HTTPD_MAX_URI_LEN) {
+    send_error(session, HTTPD_414_URI_TOO_LONG, "URI trop longue");
+    return false;
+  }
+
+  session->req = httpd_req_t{};
+  session->req.handle = session->server;
+  session->req.aux = session;
+  session->req.method = method_of(request_line.substr(0, sp1));
+  memcpy(session->req.uri, uri.c_str(), uri.size() + 1);
+  session->headers.clear();
+  size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+  while (pos < head.size()) {
+    size_t eol = head.find("\r\n", pos);
+    if (eol == std::string::npos) {
+      eol = head.size();
+    }
+    std::string line = head.substr(pos, eol - pos);
+    pos = eol + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    size_t value_start = line.find_first_not_of(" \t", colon + 1);
+    session->headers.emplace_back(line.substr(0, colon),
+                                  value_start == std::string::npos ? "" : line.substr(value_start));
+  }
+  char length[24];
+  if (httpd_req_get_hdr_value_str(&session->req, "Content-Length", length, sizeof(length)) == ESP_OK) {
+    session->req.content_len = strtoull(length, nullptr, 10);
+  }
+  session->body_remaining = session->req.content_len;
+
+  session->status = "200 OK";
+  session->content_type = "text/html";
+  session->resp_headers.clear();
+  session->chunked = false;
+  return true;
+}
+
+static const httpd_uri_t *find_handler(HttpServer *server, const char *uri, int method, bool &uri_known) {
+  const char *query = strchr(uri, '?');
+  size_t match_upto = query ? query - uri : strlen(uri);
+  uri_known = false;
+  for (const auto &handler : server->handlers) {
+    bool match = server->config.uri_match_fn ? server->config.uri_match_fn(handler.uri, uri, match_upto)
+                                             : strlen(handler.uri) == match_upto &&
+                                                   strncmp(handler.uri, uri, match_upto) == 0;
+    if (!match) {
+      continue;
+    }
+    uri_known = true;
+    if (handler.method == method) {
+      return &handler;
+    }
+  }
+  return nullptr;
+}
+
+static void run_session(HttpSession *session) {
+  HttpServer *server = session->server;
+  while (read_request(session)) {
+    bool uri_known = false;
+    esp_err_t ret;
+    {
+      // La table peut encore grandir pendant les premières requêtes
+      std::lock_guard<std::mutex> lock(server->handlers_mutex);
+      const httpd_uri_t *handler = find_handler(server, session->req.uri, session->req.method, uri_known);
+      if (!handler) {
+        send_error(session, uri_known ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND,
+                   uri_known ? "Méthode non autorisée" : "Aucun gestionnaire pour cette URI");
+        break;
+      }
+      session->req.user_ctx = handler->user_ctx;
+      ret = handler->handler(&session->req);
+    }
+
+    // Requête détachée: la connexion attend qu'elle soit rendue
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->async_done.wait(lock, [session] { return session->async_pending == 0; });
+    if (ret != ESP_OK || session->close_requested) {
+      break;
+    }
+    lock.unlock();
+
+    // Corps non lu par le gestionnaire: écarté avant la requête suivante
+    char discard[1024];
+    while (session->body_remaining > 0) {
+      int n = httpd_req_recv(&session->req, discard, sizeof(discard));
+      if (n <= 0) {
+        session->close_requested = true;
+        break;
+      }
+    }
+    if (session->close_requested) {
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(server->sessions_mutex);
+    auto &sessions = server->sessions;
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), session), sessions.end());
+  }
+  close(session->fd);
+  delete session;
+}
+
+static void accept_loop(HttpServer *server) {
+  while (true) {
+    int fd = accept(server->listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return;
+    }
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    struct timeval recv_timeout = {.tv_sec = server->config.recv_wait_timeout, .tv_usec = 0};
+    struct timeval send_timeout = {.tv_sec = server->config.send_wait_timeout, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    auto *session = new HttpSession();
+    session->server = server;
+    session->fd = fd;
+    {
+      std::lock_guard<std::mutex> lock(server->sessions_mutex);
+      server->sessions.push_back(session);
+    }
+    std::thread(run_session, session).detach();
+  }
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+  // lwIP ne connaît pas SIGPIPE: un client parti se traduit par une erreur d'envoi
+  signal(SIGPIPE, SIG_IGN);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return ESP_FAIL;
+  }
+  int flag = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(config->server_port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, std::max<int>(config->backlog_conn, 16)) != 0) {
+    close(fd);
+    return ESP_FAIL;
+  }
+
+  auto *server = new HttpServer();
+  server->config = *config;
+  server->listen_fd = fd;
+  std::thread(accept_loop, server).detach();
+  *handle = server;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  auto *server = (HttpServer *)handle;
+  if (!server) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // Le thread d'acceptation sort sur l'erreur d'accept(); le serveur reste alloué
+  shutdown(server->listen_fd, SHUT_RDWR);
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+  auto *server = (HttpServer *)handle;
+  if (!server || !uri_handler) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(server->handlers_mutex);
+  for (const auto &handler : server->handlers) {
+    if (handler.method == uri_handler->method && strcmp(handler.uri, uri_handler->uri) == 0) {
+      return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+  }
+  if (server->handlers.size() >= server->config.max_uri_handlers) {
+    return ESP_ERR_HTTPD_HANDLERS_FULL;
+  }
+  server->handlers.push_back(*uri_handler);
+  return ESP_OK;
+}
+
+bool httpd_uri_match_wildcard(const char *reference_uri, const char *uri_to_match, size_t match_upto) {
+  size_t ref_len = strlen(reference_uri);
+  if (ref_len == 0 || reference_uri[ref_len - 1] != '*') {
+    return ref_len == match_upto && strncmp(reference_uri, uri_to_match, match_upto) == 0;
+  }
+  size_t prefix = ref_len - 1;
+  // "?" avant "*": le caractère qui précède est facultatif
+  if (prefix > 0 && reference_uri[prefix - 1] == '?') {
+    prefix--;
+    if (match_upto == prefix - 1 && strncmp(reference_uri, uri_to_match, prefix - 1) == 0) {
+      return true;
+    }
+    std::string without_question(reference_uri, prefix);
+    return match_upto >= prefix && strncmp(without_question.c_str(), uri_to_match, prefix) == 0;
+  }
+  return match_upto >= prefix && strncmp(reference_uri, uri_to_match, prefix) == 0;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+  HttpSession *session = session_of(req);
+  size_t want = std::min(buf_len, session->body_remaining);
+  if (want == 0) {
+    return 0;
+  }
+  if (!session->input.empty()) {
+    size_t n = std::min(want, session->input.size());
+    memcpy(buf, session->input.data(), n);
+    session->input.erase(0, n);
+    session->body_remaining -= n;
+    return (int)n;
+  }
+  ssize_t n = recv(session->fd, buf, want, 0);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+  }
+  session->body_remaining -= n;
+  return (int)n;
+}
+
+static const std::string *find_header(httpd_req_t *req, const char *field) {
+  for (const auto &header : session_of(req)->headers) {
+    if (strcasecmp(header.first.c_str(), field) == 0) {
+      return &header.second;
+    }
+  }
+  return nullptr;
+}
+
+static esp_err_t copy_value(const char *value, size_t len, char *buf, size_t buf_size) {
+  if (buf_size == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t n = std::min(len, buf_size - 1);
+  memcpy(buf, value, n);
+  buf[n] = '\0';
+  return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field) {
+  const std::string *value = find_header(req, field);
+  return value ? value->size() : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size) {
+  const std::string *value = find_header(req, field);
+  if (!value) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return copy_value(value->data(), value->size(), val, val_size);
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *req) {
+  const char *query = strchr(req->uri, '?');
+  return query ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len) {
+  const char *query = strchr(req->uri, '?');
+  if (!query) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return copy_value(query + 1, strlen(query + 1), buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+  size_t key_len = strlen(key);
+  const char *pos = qry;
+  while (pos && *pos) {
+    const char *end = strchr(pos, '&');
+    size_t len = end ? (size_t)(end - pos) : strlen(pos);
+    if (len > key_len && strncmp(pos, key, key_len) == 0 && pos[key_len] == '=') {
+      // Valeur telle quelle, sans décodage, comme sur la cible
+      return copy_value(pos + key_len + 1, len - key_len - 1, val, val_size);
+    }
+    pos = end ? end + 1 : nullptr;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *req) { return session_of(req)->fd; }
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+  session_of(req)->status = status;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+  session_of(req)->content_type = type;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+  HttpSession *session = session_of(req);
+  if (session->resp_headers.size() >= session->server->config.max_resp_headers) {
+    return ESP_ERR_HTTPD_RESP_HDR;
+  }
+  session->resp_headers.emplace_back(field, value);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+  HttpSession *session = session_of(req);
+  size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : (size_t)buf_len;
+  std::string head = response_head(session);
+  head += "Content-Length: " + std::to_string(len) + "\r\n\r\n";
+  if (!send_all(session->fd, head.data(), head.size()) || (len > 0 && !send_all(session->fd, buf, len))) {
+    return ESP_ERR_HTTPD_RESP_SEND;
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+  HttpSession *session = session_of(req);
+  size_t len = buf_len == HTTPD_RESP_USE_STRLEN ? (buf ? strlen(buf) : 0) : (size_t)buf_len;
+  if (!session->chunked) {
+    std::string head = response_head(session) + "Transfer-Encoding: chunked\r\n\r\n";
+    if (!send_all(session->fd, head.data(), head.size())) {
+      return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    session->chunked = true;
+  }
+  char size_line[24];
+  int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", buf ? len : 0);
+  if (!send_all(session->fd, size_line, n) || (buf && len > 0 && !send_all(session->fd, buf, len)) ||
+      !send_all(session->fd, "\r\n", 2)) {
+    return ESP_ERR_HTTPD_RESP_SEND;
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message) {
+  HttpSession *session = session_of(req);
+  session->status = status_for(error);
+  session->content_type = "text/html";
+  return httpd_resp_send(req, message ? message : session->status.c_str(), HTTPD_RESP_USE_STRLEN);
+}
+
+int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len) {
+  if (!send_all(session_of(req)->fd, buf, buf_len)) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+  }
+  return (int)buf_len;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *req, httpd_req_t **out) {
+  HttpSession *session = session_of(req);
+  *out = new httpd_req_t(*req);
+  std::lock_guard<std::mutex> lock(session->mutex);
+  session->async_pending++;
+  return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *req) {
+  HttpSession *session = session_of(req);
+  delete req;
+  std::lock_guard<std::mutex> lock(session->mutex);
+  session->async_pending--;
+  session->async_done.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+  auto *server = (HttpServer *)handle;
+  std::lock_guard<std::mutex> sessions_lock(server->sessions_mutex);
+  for (HttpSession *session : server->sessions) {
+    if (session->fd == sockfd) {
+      // Fermeture côté réseau tout de suite; le descripteur n'est libéré qu'à la
+      // fin de la session, pour qu'un envoi tardif ne vise pas un autre client
+      std::lock_guard<std::mutex> lock(session->mutex);
+      session->close_requested = true;
+      shutdown(sockfd, SHUT_RDWR);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,317 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Limite de la cible: blobs d'au plus ~508 Ko
+static const size_t NVS_BLOB_MAX_SIZE = 508000;
+
+// Géométrie de la cible: pages de 4 Ko, 126 entrées de 32 octets par page
+// (en-tête et table d'état compris), une page gardée libre pour le ramasse-miettes
+static const size_t NVS_PAGE_SIZE = 4096;
+static const size_t NVS_ENTRY_SIZE = 32;
+static const size_t NVS_ENTRIES_PER_PAGE = 126;
+static const size_t NVS_GC_PAGES = 1;
+
+// Table de partitions de l'hôte: "nvs" à la taille par défaut d'ESP-IDF, et la
+// partition dédiée du proxy telle que la décrit le README du composant
+struct PartitionSpec {
+  const char *label;
+  size_t size;
+};
+static const PartitionSpec PARTITION_TABLE[] = {
+    {"nvs", 0x6000},
+    {"ftp_proxy", 0x40000},
+};
+
+using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+struct Partition {
+  size_t pages{0};
+  bool initialized{false};
+  size_t used_entries{0};
+  std::map<std::string, Namespace> namespaces;
+};
+
+struct Handle {
+  std::string partition;
+  std::string name_space;
+};
+
+struct nvs_opaque_iterator_t {
+  std::vector<nvs_entry_info_t> entries;
+  size_t index{0};
+};
+
+static std::mutex nvs_mutex;
+static std::map<std::string, Partition> partitions;
+static std::vector<Handle> handles;  // handle - 1 -> partition et espace de noms
+static int skipped_writes = 0;
+static int failing_writes = 0;
+
+// Entrées occupées par un blob: un index, puis pour chaque page traversée un
+// en-tête de données suivi des données
+static size_t blob_entries(size_t length) {
+  size_t data = (length + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  size_t pieces = std::max<size_t>(1, (data + NVS_ENTRIES_PER_PAGE - 2) / (NVS_ENTRIES_PER_PAGE - 1));
+  return 1 + pieces + data;
+}
+
+static size_t capacity(const Partition &part) {
+  return part.pages > NVS_GC_PAGES ? (part.pages - NVS_GC_PAGES) * NVS_ENTRIES_PER_PAGE : 0;
+}
+
+static Partition *find_partition(const char *label) {
+  if (partitions.empty()) {
+    for (const auto &spec : PARTITION_TABLE) {
+      Partition &part = partitions[spec.label];
+      part.pages = spec.size / NVS_PAGE_SIZE;
+      part.initialized = strcmp(spec.label, NVS_DEFAULT_PART_NAME) == 0;
+    }
+  }
+  auto it = partitions.find(label ? label : NVS_DEFAULT_PART_NAME);
+  return it == partitions.end() ? nullptr : &it->second;
+}
+
+static Namespace *lookup(nvs_handle_t handle, Partition **part = nullptr) {
+  if (handle == 0 || handle > handles.size()) {
+    return nullptr;
+  }
+  Partition *owner = find_partition(handles[handle - 1].partition.c_str());
+  if (part) {
+    *part = owner;
+  }
+  return &owner->namespaces[handles[handle - 1].name_space];
+}
+
+esp_err_t nvs_flash_init() { return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME); }
+
+esp_err_t nvs_flash_init_partition(const char *label) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part = find_partition(label);
+  if (!part) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  part->initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase_partition(const char *label) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part = find_partition(label);
+  if (!part) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  part->namespaces.clear();
+  part->used_entries = 0;
+  part->initialized = false;
+  return ESP_OK;
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name_space, nvs_open_mode_t,
+                                  nvs_handle_t *handle) {
+  if (!name_space || strlen(name_space) >= NVS_KEY_NAME_MAX_SIZE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part = find_partition(part_name);
+  if (!part) {
+    return ESP_ERR_NVS_PART_NOT_FOUND;
+  }
+  if (!part->initialized) {
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  }
+  // Une entrée par espace de noms
+  if (!part->namespaces.count(name_space)) {
+    if (part->used_entries + 1 > capacity(*part)) {
+      return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    part->namespaces[name_space];
+    part->used_entries++;
+  }
+  handles.push_back(Handle{part_name, name_space});
+  *handle = handles.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *handle) {
+  return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name_space, mode, handle);
+}
+
+void nvs_close(nvs_handle_t) {}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Namespace *space = lookup(handle);
+  if (!space) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  auto it = space->find(key);
+  if (it == space->end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  // Sans tampon: seule la taille est retournée
+  if (value) {
+    if (*length < it->second.size()) {
+      *length = it->second.size();
+      return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(value, it->second.data(), it->second.size());
+  }
+  *length = it->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part;
+  Namespace *space = lookup(handle, &part);
+  if (!space) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE || length > NVS_BLOB_MAX_SIZE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (skipped_writes > 0) {
+    skipped_writes--;
+  } else if (failing_writes > 0) {
+    failing_writes--;
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  }
+  // La nouvelle version est écrite avant que l'ancienne ne soit libérée
+  size_t entries = blob_entries(length);
+  if (part->used_entries + entries > capacity(*part)) {
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  }
+  auto it = space->find(key);
+  if (it != space->end()) {
+    part->used_entries -= blob_entries(it->second.size());
+  }
+  part->used_entries += entries;
+  const auto *bytes = (const uint8_t *)value;
+  (*space)[key].assign(bytes, bytes + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part;
+  Namespace *space = lookup(handle, &part);
+  if (!space) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  auto it = space->find(key);
+  if (it == space->end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  part->used_entries -= blob_entries(it->second.size());
+  space->erase(it);
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part;
+  Namespace *space = lookup(handle, &part);
+  if (!space) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  for (const auto &entry : *space) {
+    part->used_entries -= blob_entries(entry.second.size());
+  }
+  space->clear();
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  return lookup(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *stats) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  Partition *part = find_partition(part_name);
+  if (!part) {
+    return ESP_ERR_NVS_PART_NOT_FOUND;
+  }
+  if (!part->initialized) {
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  }
+  // Comme sur la cible, les entrées libres comptent la page du ramasse-miettes
+  stats->total_entries = part->pages * NVS_ENTRIES_PER_PAGE;
+  stats->used_entries = part->used_entries;
+  stats->free_entries = stats->total_entries - part->used_entries;
+  stats->namespace_count = part->namespaces.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char *part_name, const char *name_space, nvs_type_t type, nvs_iterator_t *it) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  *it = nullptr;
+  Partition *part = find_partition(part_name);
+  if (!part) {
+    return ESP_ERR_NVS_PART_NOT_FOUND;
+  }
+  auto *iterator = new nvs_opaque_iterator_t();
+  for (const auto &space : part->namespaces) {
+    if (name_space && space.first != name_space) {
+      continue;
+    }
+    // Seuls des blobs sont stockés
+    if (type != NVS_TYPE_ANY && type != NVS_TYPE_BLOB) {
+      continue;
+    }
+    for (const auto &entry : space.second) {
+      nvs_entry_info_t info{};
+      strncpy(info.namespace_name, space.first.c_str(), sizeof(info.namespace_name) - 1);
+      strncpy(info.key, entry.first.c_str(), sizeof(info.key) - 1);
+      info.type = NVS_TYPE_BLOB;
+      iterator->entries.push_back(info);
+    }
+  }
+  if (iterator->entries.empty()) {
+    delete iterator;
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  *it = iterator;
+  return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it) {
+  if (!it || !*it) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (++(*it)->index >= (*it)->entries.size()) {
+    delete *it;
+    *it = nullptr;
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t *info) {
+  if (!it || !info) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *info = it->entries[it->index];
+  return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t it) { delete it; }
+
+void host_nvs_fail_writes(int count, int skip) {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  skipped_writes = skip;
+  failing_writes = count;
+}
+
+void host_nvs_reset() {
+  std::lock_guard<std::mutex> lock(nvs_mutex);
+  partitions.clear();
+  skipped_writes = 0;
+  failing_writes = 0;
+}
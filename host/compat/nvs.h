@@ -0,0 +1,57 @@
+#pragma once
+
+// NVS en mémoire, conservé pour la durée du processus. Les partitions de la table
+// de l'hôte (nvs.cpp) ont la géométrie de la cible: pages de 4 Ko de 126 entrées
+// de 32 octets, une page réservée au ramasse-miettes. Une écriture qui ne tient
+// plus échoue avec ESP_ERR_NVS_NOT_ENOUGH_SPACE, comme sur la carte.
+// host_nvs_fail_writes() fait échouer des écritures choisies (tests de reprise).
+
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+
+#define NVS_DEFAULT_PART_NAME "nvs"
+#define NVS_KEY_NAME_MAX_SIZE 16
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef enum { NVS_TYPE_BLOB = 0x42, NVS_TYPE_ANY = 0xff } nvs_type_t;
+
+typedef struct {
+  size_t used_entries;
+  size_t free_entries;
+  size_t total_entries;
+  size_t namespace_count;
+} nvs_stats_t;
+
+typedef struct {
+  char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+  char key[NVS_KEY_NAME_MAX_SIZE];
+  nvs_type_t type;
+} nvs_entry_info_t;
+
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *handle);
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name_space, nvs_open_mode_t mode,
+                                  nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *stats);
+
+// Parcours des clés: le parcours se termine par ESP_ERR_NVS_NOT_FOUND, l'itérateur
+// étant alors libéré et remis à NULL
+esp_err_t nvs_entry_find(const char *part_name, const char *name_space, nvs_type_t type, nvs_iterator_t *it);
+esp_err_t nvs_entry_next(nvs_iterator_t *it);
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t *info);
+void nvs_release_iterator(nvs_iterator_t it);
+
+// Après skip écritures réussies, les count suivantes échouent
+// (ESP_ERR_NVS_NOT_ENOUGH_SPACE)
+void host_nvs_fail_writes(int count, int skip = 0);
+// Efface toutes les partitions; seule "nvs" reste initialisée, comme au démarrage
+void host_nvs_reset();
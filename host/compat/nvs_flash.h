@@ -0,0 +1,8 @@
+#pragma once
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init();
+// ESP_ERR_NOT_FOUND si la table de partitions ne contient pas label
+esp_err_t nvs_flash_init_partition(const char *label);
+esp_err_t nvs_flash_erase_partition(const char *label);
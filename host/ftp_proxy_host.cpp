@@ -0,0 +1,163 @@
+// Proxy FTP/HTTP compilé pour l'hôte: le composant tel qu'il tourne sur l'ESP32,
+// au-dessus de l'émulation POSIX de compat/, pour mesurer et tester sans carte
+// (tools/ftp_proxy_bench.py run --proxy http://127.0.0.1:8080 ...).
+
+#include "ftp_http_proxy.h"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <unistd.h>
+
+using esphome::ftp_http_proxy::FTPHTTPProxy;
+
+// Cadence de la boucle principale d'ESPHome
+static const useconds_t LOOP_INTERVAL_US = 16000;
+
+static std::atomic<bool> running{true};
+
+static void stop(int) { running = false; }
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s --ftp HÔTE[:PORT] --user NOM --password MOT [options]\n"
+          "  --port N                    port HTTP (8080)\n"
+          "  --pool-size N               sessions FTP (2)\n"
+          "  --max-transfers N           workers de transfert (3)\n"
+          "  --transfer-queue-size N     transferts en attente (8)\n"
+          "  --event-loop-streams N      flux de la boucle d'événements (0)\n"
+          "  --segment-connections N     connexions d'un téléchargement segmenté (1)\n"
+          "  --segment-threshold OCTETS  taille min. d'un fichier segmenté\n"
+          "  --segment-size OCTETS       taille d'un segment\n"
+          "  --listing-cache-ttl MS      durée de vie d'un listing (30000)\n"
+          "  --listing-cache-size N      listings gardés (16)\n"
+          "  --file-metadata-size N      fichiers suivis (2048)\n"
+          "  --content-cache-size OCTETS cache de contenu (0)\n"
+          "  --content-cache-max-file OCTETS\n"
+          "  --persist-partition NOM     partition NVS des partages (ftp_proxy)\n"
+          "Niveau de journal: FTP_PROXY_LOG_LEVEL=0..4 (2: info)\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  enum {
+    OPT_FTP = 256,
+    OPT_USER,
+    OPT_PASSWORD,
+    OPT_PORT,
+    OPT_POOL_SIZE,
+    OPT_MAX_TRANSFERS,
+    OPT_TRANSFER_QUEUE_SIZE,
+    OPT_EVENT_LOOP_STREAMS,
+    OPT_SEGMENT_CONNECTIONS,
+    OPT_SEGMENT_THRESHOLD,
+    OPT_SEGMENT_SIZE,
+    OPT_LISTING_CACHE_TTL,
+    OPT_LISTING_CACHE_SIZE,
+    OPT_FILE_METADATA_SIZE,
+    OPT_CONTENT_CACHE_SIZE,
+    OPT_CONTENT_CACHE_MAX_FILE,
+    OPT_PERSIST_PARTITION,
+  };
+  static const struct option OPTIONS[] = {
+      {"ftp", required_argument, nullptr, OPT_FTP},
+      {"user", required_argument, nullptr, OPT_USER},
+      {"password", required_argument, nullptr, OPT_PASSWORD},
+      {"port", required_argument, nullptr, OPT_PORT},
+      {"pool-size", required_argument, nullptr, OPT_POOL_SIZE},
+      {"max-transfers", required_argument, nullptr, OPT_MAX_TRANSFERS},
+      {"transfer-queue-size", required_argument, nullptr, OPT_TRANSFER_QUEUE_SIZE},
+      {"event-loop-streams", required_argument, nullptr, OPT_EVENT_LOOP_STREAMS},
+      {"segment-connections", required_argument, nullptr, OPT_SEGMENT_CONNECTIONS},
+      {"segment-threshold", required_argument, nullptr, OPT_SEGMENT_THRESHOLD},
+      {"segment-size", required_argument, nullptr, OPT_SEGMENT_SIZE},
+      {"listing-cache-ttl", required_argument, nullptr, OPT_LISTING_CACHE_TTL},
+      {"listing-cache-size", required_argument, nullptr, OPT_LISTING_CACHE_SIZE},
+      {"file-metadata-size", required_argument, nullptr, OPT_FILE_METADATA_SIZE},
+      {"content-cache-size", required_argument, nullptr, OPT_CONTENT_CACHE_SIZE},
+      {"content-cache-max-file", required_argument, nullptr, OPT_CONTENT_CACHE_MAX_FILE},
+      {"persist-partition", required_argument, nullptr, OPT_PERSIST_PARTITION},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  auto *proxy = new FTPHTTPProxy();
+  bool has_server = false;
+  int option;
+  while ((option = getopt_long(argc, argv, "h", OPTIONS, nullptr)) != -1) {
+    switch (option) {
+      case OPT_FTP:
+        proxy->set_ftp_server(optarg);
+        has_server = true;
+        break;
+      case OPT_USER:
+        proxy->set_username(optarg);
+        break;
+      case OPT_PASSWORD:
+        proxy->set_password(optarg);
+        break;
+      case OPT_PORT:
+        proxy->set_local_port(atoi(optarg));
+        break;
+      case OPT_POOL_SIZE:
+        proxy->set_pool_size(atoi(optarg));
+        break;
+      case OPT_MAX_TRANSFERS:
+        proxy->set_max_transfers(atoi(optarg));
+        break;
+      case OPT_TRANSFER_QUEUE_SIZE:
+        proxy->set_transfer_queue_size(atoi(optarg));
+        break;
+      case OPT_EVENT_LOOP_STREAMS:
+        proxy->set_event_loop_streams(atoi(optarg));
+        break;
+      case OPT_SEGMENT_CONNECTIONS:
+        proxy->set_segment_connections(atoi(optarg));
+        break;
+      case OPT_SEGMENT_THRESHOLD:
+        proxy->set_segment_threshold(strtoul(optarg, nullptr, 10));
+        break;
+      case OPT_SEGMENT_SIZE:
+        proxy->set_segment_size(strtoul(optarg, nullptr, 10));
+        break;
+      case OPT_LISTING_CACHE_TTL:
+        proxy->set_listing_cache_ttl(strtoul(optarg, nullptr, 10));
+        break;
+      case OPT_LISTING_CACHE_SIZE:
+        proxy->set_listing_cache_size(atoi(optarg));
+        break;
+      case OPT_FILE_METADATA_SIZE:
+        proxy->set_file_metadata_size(atoi(optarg));
+        break;
+      case OPT_CONTENT_CACHE_SIZE:
+        proxy->set_content_cache_size(strtoul(optarg, nullptr, 10));
+        break;
+      case OPT_CONTENT_CACHE_MAX_FILE:
+        proxy->set_content_cache_max_file(strtoul(optarg, nullptr, 10));
+        break;
+      case OPT_PERSIST_PARTITION:
+        proxy->set_persist_partition(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return option == 'h' ? 0 : 2;
+    }
+  }
+  if (!has_server) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  proxy->setup();
+  while (running && !proxy->is_failed()) {
+    proxy->loop();
+    usleep(LOOP_INTERVAL_US);
+  }
+  // Les tâches de transfert tournent jusqu'à la fin du processus: le proxy n'est
+  // pas détruit sous leurs pieds
+  return proxy->is_failed() ? 1 : 0;
+}
@@ -0,0 +1,296 @@
+// Analyseurs incrémentaux du proxy, alimentés en deux morceaux coupés à chaque
+// position possible puis octet par octet: réponses FTP multilignes ou collées,
+// listings LIST (Unix, DOS) et MLSD, corps multipart dont la frontière chevauche
+// deux morceaux; en-têtes Range.
+
+#include "ftp_client.h"
+#include "http_range.h"
+#include "listing_parser.h"
+#include "multipart_parser.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+using esphome::ftp_http_proxy::FtpReply;
+using esphome::ftp_http_proxy::FtpReplyParser;
+using esphome::ftp_http_proxy::ListingEntry;
+using esphome::ftp_http_proxy::ListingParser;
+using esphome::ftp_http_proxy::MultipartParser;
+using esphome::ftp_http_proxy::parse_range_header;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: échec: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// Appelle feed sur input coupé en split, puis octet par octet (split < 0)
+static void feed_split(const std::string &input, int split, const std::function<void(const char *, size_t)> &feed) {
+  if (split < 0) {
+    for (char c : input) {
+      feed(&c, 1);
+    }
+    return;
+  }
+  feed(input.data(), split);
+  feed(input.data() + split, input.size() - split);
+}
+
+static void for_each_split(const std::string &input, const std::function<void(int)> &run) {
+  for (int split = 0; split <= (int)input.size(); split++) {
+    run(split);
+  }
+  run(-1);
+}
+
+// Réponses FTP
+
+static std::vector<FtpReply> parse_replies(const std::string &input, int split) {
+  std::vector<FtpReply> replies;
+  FtpReplyParser parser;
+  feed_split(input, split, [&](const char *data, size_t len) {
+    while (len > 0) {
+      size_t used = parser.feed(data, len);
+      data += used;
+      len -= used;
+      if (parser.ready()) {
+        replies.push_back(parser.take());
+      }
+    }
+  });
+  return replies;
+}
+
+static void test_ftp_replies() {
+  // Multiligne: les lignes intermédiaires, même avec un code, ne la terminent pas
+  const std::string multiline =
+      "ligne parasite\r\n"
+      "211-Fonctions:\r\n"
+      " MLST type*;size*;modify*;\r\n"
+      " 211 indentée\r\n"
+      "230 autre code\r\n"
+      "211-encore une\r\n"
+      "211 Fin\r\n";
+  for_each_split(multiline, [&](int split) {
+    auto replies = parse_replies(multiline, split);
+    CHECK(replies.size() == 1);
+    if (replies.size() == 1) {
+      CHECK(replies[0].code == FtpReply::SYSTEM_STATUS);
+      CHECK(replies[0].text ==
+            "Fonctions:\n MLST type*;size*;modify*;\n 211 indentée\n230 autre code\n211-encore une\n211 Fin");
+    }
+  });
+
+  // 226 arrivé dans le même segment que le 150, sans CR sur la dernière ligne
+  const std::string glued = "150 Ouverture du canal de données\r\n226 Transfert terminé\n";
+  for_each_split(glued, [&](int split) {
+    auto replies = parse_replies(glued, split);
+    CHECK(replies.size() == 2);
+    if (replies.size() == 2) {
+      CHECK(replies[0].transfer_starting() && replies[0].text == "Ouverture du canal de données");
+      CHECK(replies[1].transfer_complete() && replies[1].text == "Transfert terminé");
+    }
+  });
+
+  // Réponse incomplète: rien n'est rendu
+  CHECK(parse_replies("211-Début\r\n211 Fi", 5).empty());
+}
+
+// Listings
+
+static std::vector<ListingEntry> parse_listing(ListingParser::Format format, const std::string &input, int split) {
+  std::vector<ListingEntry> entries;
+  ListingParser parser(format, [&entries](const ListingEntry &entry) { entries.push_back(entry); });
+  feed_split(input, split, [&parser](const char *data, size_t len) { parser.feed(data, len); });
+  parser.finish();
+  return entries;
+}
+
+static bool same_entries(const std::vector<ListingEntry> &a, const std::vector<ListingEntry> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].name != b[i].name || a[i].is_dir != b[i].is_dir || a[i].size != b[i].size ||
+        a[i].mtime != b[i].mtime || a[i].exact_mtime != b[i].exact_mtime || a[i].unique != b[i].unique) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_list() {
+  // Dernière ligne sans fin de ligne: rendue par finish()
+  const std::string listing =
+      "total 12\r\n"
+      "drwxr-xr-x    2 ftp      ftp          4096 Mar  2  2023 .\r\n"
+      "-rw-r--r--    1 owner    group    12345 Mar  2  2023 avec groupe.txt\r\n"
+      "-rw-r--r--    1 owner    678 Mar  2  2023 sans_groupe.bin\r\n"
+      "lrwxrwxrwx    1 owner    group       7 Mar  2  2023 lien -> cible\r\n"
+      "drwxr-xr-x    3 owner    group    4096 Mar  2  2023 Dossier Unix\n"
+      "01-15-24  10:30AM       <DIR>          Dossier DOS\r\n"
+      "01-15-24  02:05PM                 1234 fichier dos.txt";
+  auto entries = parse_listing(ListingParser::Format::LIST, listing, (int)listing.size());
+  CHECK(entries.size() == 6);
+  if (entries.size() == 6) {
+    CHECK(entries[0].name == "avec groupe.txt" && !entries[0].is_dir && entries[0].size == 12345);
+    CHECK(entries[0].mtime == 1677715200);  // 2023-03-02
+    CHECK(!entries[0].exact_mtime);
+    CHECK(entries[1].name == "sans_groupe.bin" && !entries[1].is_dir && entries[1].size == 678);
+    CHECK(entries[2].name == "lien" && !entries[2].is_dir);
+    CHECK(entries[3].name == "Dossier Unix" && entries[3].is_dir && entries[3].size == 0);
+    CHECK(entries[4].name == "Dossier DOS" && entries[4].is_dir && entries[4].size == 0);
+    CHECK(entries[4].mtime == 1705314600);  // 2024-01-15 10:30
+    CHECK(entries[5].name == "fichier dos.txt" && !entries[5].is_dir && entries[5].size == 1234);
+    CHECK(entries[5].mtime == 1705327500);  // 2024-01-15 14:05
+  }
+  for_each_split(listing, [&](int split) {
+    CHECK(same_entries(parse_listing(ListingParser::Format::LIST, listing, split), entries));
+  });
+}
+
+static void test_mlsd() {
+  const std::string listing =
+      "type=cdir;modify=20240115103000;perm=el; /media\r\n"
+      "type=pdir;modify=20240115103000;perm=el; /\r\n"
+      "Type=file;Size=42;Modify=20240115103000.123;unique=802U1A; fichier mlsd.txt\r\n"
+      "type=dir;size=4096;modify=20230302081500; sous-dossier\r\n"
+      "size=1; sans type\r\n";
+  auto entries = parse_listing(ListingParser::Format::MLSD, listing, (int)listing.size());
+  CHECK(entries.size() == 2);
+  if (entries.size() == 2) {
+    CHECK(entries[0].name == "fichier mlsd.txt" && !entries[0].is_dir && entries[0].size == 42);
+    CHECK(entries[0].mtime == 1705314600 && entries[0].exact_mtime);
+    CHECK(entries[0].unique == "802U1A");
+    CHECK(entries[1].name == "sous-dossier" && entries[1].is_dir && entries[1].size == 0);
+    CHECK(entries[1].mtime == 1677744900);
+  }
+  for_each_split(listing, [&](int split) {
+    CHECK(same_entries(parse_listing(ListingParser::Format::MLSD, listing, split), entries));
+  });
+}
+
+// Multipart
+
+struct Part {
+  std::string name;
+  std::string filename;
+  std::string data;
+  bool ended{false};
+};
+
+static bool parse_multipart(const std::string &boundary, const std::string &body, int split, std::vector<Part> &parts) {
+  MultipartParser parser(boundary);
+  MultipartParser::Handler handler;
+  handler.begin = [&parts](const std::string &name, const std::string &filename) {
+    parts.push_back(Part{name, filename, "", false});
+    return true;
+  };
+  handler.data = [&parts](const uint8_t *data, size_t len) {
+    parts.back().data.append((const char *)data, len);
+    return true;
+  };
+  handler.end = [&parts]() {
+    parts.back().ended = true;
+    return true;
+  };
+  bool ok = true;
+  feed_split(body, split, [&](const char *data, size_t len) {
+    ok = ok && parser.feed((const uint8_t *)data, len, handler);
+  });
+  return ok && parser.finished();
+}
+
+static void test_multipart() {
+  std::string boundary;
+  CHECK(MultipartParser::parse_boundary("multipart/form-data; boundary=\"----Frontiere42\"", boundary));
+  CHECK(boundary == "----Frontiere42");
+  CHECK(!MultipartParser::parse_boundary("application/json", boundary));
+
+  // Faux départs dans le contenu: fin de ligne suivie de "--", d'une partie de la
+  // frontière, ou CR doublé juste avant un vrai délimiteur
+  const std::string content =
+      "début\r\n-- pas une frontière\r\n------Frontiere4 presque\r\n------Frontiere4\r\r\nfin\r";
+  const std::string body =
+      "préambule ignoré\r\n"
+      "------Frontiere42\r\n"
+      "Content-Disposition: form-data; name=\"commentaire\"\r\n"
+      "\r\n"
+      "bonjour\r\n"
+      "------Frontiere42  \r\n"
+      "Content-Disposition: form-data; name=\"fichier\"; filename=\"données.bin\"\r\n"
+      "Content-Type: application/octet-stream\r\n"
+      "\r\n" +
+      content +
+      "\r\n"
+      "------Frontiere42--\r\n"
+      "épilogue ignoré";
+  for_each_split(body, [&](int split) {
+    std::vector<Part> parts;
+    CHECK(parse_multipart(boundary, body, split, parts));
+    CHECK(parts.size() == 2);
+    if (parts.size() == 2) {
+      CHECK(parts[0].name == "commentaire" && parts[0].filename.empty());
+      CHECK(parts[0].data == "bonjour" && parts[0].ended);
+      CHECK(parts[1].name == "fichier" && parts[1].filename == "données.bin");
+      CHECK(parts[1].data == content && parts[1].ended);
+    }
+  });
+
+  // Délimiteur suivi d'autre chose qu'une fin de ligne ou de "--"
+  std::vector<Part> parts;
+  CHECK(!parse_multipart(boundary, "------Frontiere42xx\r\n", -1, parts));
+}
+
+// Range
+
+static void test_range() {
+  int64_t start = -1, end = -1;
+  CHECK(parse_range_header("bytes=0-99", 1000, start, end) == 1 && start == 0 && end == 99);
+  CHECK(parse_range_header("bytes= 100-", 1000, start, end) == 1 && start == 100 && end == 999);
+  CHECK(parse_range_header("bytes=900-5000", 1000, start, end) == 1 && start == 900 && end == 999);
+  CHECK(parse_range_header("bytes=999-", 1000, start, end) == 1 && start == 999 && end == 999);
+  CHECK(parse_range_header("bytes=1000-", 1000, start, end) == -1);
+  CHECK(parse_range_header("bytes=5-4", 1000, start, end) == 0);
+
+  // Suffixe: les N derniers octets, tout le fichier si N le dépasse
+  CHECK(parse_range_header("bytes=-100", 1000, start, end) == 1 && start == 900 && end == 999);
+  CHECK(parse_range_header("bytes=-5000", 1000, start, end) == 1 && start == 0 && end == 999);
+  CHECK(parse_range_header("bytes=-0", 1000, start, end) == -1);
+  CHECK(parse_range_header("bytes=-10", 0, start, end) == -1);
+  CHECK(parse_range_header("bytes=-", 1000, start, end) == 0);
+
+  // Dépassements d'int64_t: valeurs plafonnées, jamais de plage négative
+  CHECK(parse_range_header("bytes=99999999999999999999-", 1000, start, end) == -1);
+  CHECK(parse_range_header("bytes=0-99999999999999999999", 1000, start, end) == 1 && start == 0 && end == 999);
+  CHECK(parse_range_header("bytes=-99999999999999999999", 1000, start, end) == 1 && start == 0 && end == 999);
+  CHECK(parse_range_header("bytes=9223372036854775807-", INT64_MAX, start, end) == -1);
+
+  // Multi-plages et formes invalides: en-tête ignoré, fichier servi en entier
+  CHECK(parse_range_header("bytes=0-1,5-6", 1000, start, end) == 0);
+  CHECK(parse_range_header("bytes=-1, -2", 1000, start, end) == 0);
+  CHECK(parse_range_header("items=0-1", 1000, start, end) == 0);
+  CHECK(parse_range_header("bytes=abc", 1000, start, end) == 0);
+  CHECK(parse_range_header("bytes=1-2x", 1000, start, end) == 0);
+  CHECK(parse_range_header("bytes=+1-2", 1000, start, end) == 0);
+}
+
+int main() {
+  test_ftp_replies();
+  test_list();
+  test_mlsd();
+  test_multipart();
+  test_range();
+  if (failures) {
+    fprintf(stderr, "%d vérification(s) en échec\n", failures);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,454 @@
+// Persistance de l'état sur NVS en mémoire, partition dédiée à la taille du README:
+// 10 000 fichiers partagés proposés par lots comme le fait persist_state(), admis
+// jusqu'à la capacité de la partition puis rechargés après un « redémarrage »;
+// échecs d'écriture pendant flush() et compact(), blocs orphelins; blocs tronqués
+// ou corrompus.
+
+#include "esp_timer.h"
+#include "nvs.h"
+#include "persist_codec.h"
+#include "persistent_store.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using esphome::ftp_http_proxy::PersistEncoder;
+using esphome::ftp_http_proxy::PersistentStore;
+using esphome::ftp_http_proxy::PersistRecord;
+using esphome::ftp_http_proxy::PersistSizer;
+
+static const char *PARTITION = "ftp_proxy";
+static const char *NAMESPACE = "ftp_proxy_test";
+static const int ENTRY_COUNT = 10000;
+// Modifications entre deux flush(), comme entre deux passages de loop()
+static const int BATCH_SIZE = 100;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: échec: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// Accès à "meta" et au budget pour vérifier la bascule d'emplacement et les bornes
+class InspectableStore : public PersistentStore {
+ public:
+  uint8_t slot() const { return meta_.slot; }
+  uint16_t snap_chunks() const { return meta_.snap_chunks; }
+  uint32_t journal_chunks() const { return meta_.journal_end - meta_.journal_start; }
+  uint32_t journal_max() const { return journal_max_chunks_; }
+  uint32_t snapshot_max() const { return snapshot_max_chunks_; }
+  size_t pending_chunks() {
+    auto chunks = take_pending();
+    size_t count = chunks.size();
+    restore_pending(std::move(chunks));
+    return count;
+  }
+};
+
+// État complet tel que le proxy le reconstruit au démarrage
+struct State {
+  std::map<std::string, std::pair<std::string, int64_t>> shares;  // token -> chemin, échéance
+  std::map<std::string, bool> shareable;
+
+  void apply(const PersistRecord &record) {
+    if (record.type == PersistRecord::SHARE) {
+      shares[record.token] = {record.path, record.expiry};
+    } else {
+      shareable[record.path] = record.shareable;
+    }
+  }
+
+  void fill(PersistEncoder &encoder) const {
+    for (const auto &share : shares) {
+      encoder.add_share(share.second.first, share.first, share.second.second);
+    }
+    for (const auto &status : shareable) {
+      encoder.add_shareable(status.first, status.second);
+    }
+  }
+
+  // Place de l'état, avec un fichier partagé en plus si path n'est pas vide
+  PersistSizer size(const std::string &path = "", const std::string &token = "") const {
+    PersistSizer sizer(PersistentStore::CHUNK_SIZE);
+    for (const auto &share : shares) {
+      sizer.add_share(share.second.first, share.first);
+    }
+    if (!path.empty()) {
+      sizer.add_share(path, token);
+    }
+    for (const auto &status : shareable) {
+      sizer.add_shareable(status.first);
+    }
+    if (!path.empty()) {
+      sizer.add_shareable(path);
+    }
+    return sizer;
+  }
+
+  bool operator==(const State &other) const { return shares == other.shares && shareable == other.shareable; }
+};
+
+static std::string entry_path(int i) {
+  char path[64];
+  snprintf(path, sizeof(path), "/media/films/dossier%03d/fichier%05d.mkv", i % 100, i);
+  return path;
+}
+
+static std::string entry_token(int i) {
+  char token[33];
+  unsigned n = i;
+  snprintf(token, sizeof(token), "%08x%08x%08x%08x", n, n * 2654435761u, ~n, n ^ 0x5a5a5a5au);
+  return token;
+}
+
+static State reload() {
+  State state;
+  InspectableStore store;
+  CHECK(store.open(PARTITION, NAMESPACE));
+  CHECK(store.load([&state](const PersistRecord &record) { state.apply(record); }));
+  return state;
+}
+
+// Comme persist_state(): flush des modifications, compaction si demandée
+static void persist(InspectableStore &store, const State &state) {
+  if (store.has_pending()) {
+    store.flush();
+  }
+  if (store.needs_compaction()) {
+    CHECK(store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+  }
+}
+
+static void test_large_state() {
+  host_nvs_reset();
+  State expected;
+  InspectableStore store;
+  CHECK(store.open(PARTITION, NAMESPACE));
+  CHECK(store.load([](const PersistRecord &) {}));
+
+  // Admis tant que l'instantané tient, comme persisted_state_fits() dans le proxy
+  int admitted = 0;
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < ENTRY_COUNT; i++) {
+    std::string path = entry_path(i);
+    std::string token = entry_token(i);
+    int64_t expiry = 1700000000 + i * 3600LL;
+    if (!store.fits(expected.size(path, token))) {
+      break;
+    }
+    admitted++;
+    expected.shareable[path] = true;
+    expected.shares[token] = {path, expiry};
+    store.record_shareable(path, true);
+    store.record_share(path, token, expiry);
+    if ((i + 1) % BATCH_SIZE == 0) {
+      persist(store, expected);
+    }
+  }
+  persist(store, expected);
+  int64_t save_us = esp_timer_get_time() - start;
+  CHECK(!store.has_pending());
+  CHECK(store.journal_chunks() < store.journal_max());
+
+  // 10 000 fichiers ne tiennent pas dans la partition: la limite a joué avant
+  // toute écriture refusée par la NVS, et rien d'admis n'est perdu
+  CHECK(admitted > 0 && admitted < ENTRY_COUNT);
+  CHECK(!store.fits(expected.size(entry_path(admitted), entry_token(admitted))));
+  CHECK(store.fits(expected.size()));
+
+  start = esp_timer_get_time();
+  State loaded = reload();
+  int64_t load_us = esp_timer_get_time() - start;
+  CHECK(loaded.shares.size() == (size_t)admitted);
+  CHECK(loaded.shareable.size() == (size_t)admitted);
+  CHECK(loaded == expected);
+
+  // Compaction complète de l'état, comme au démarrage après une longue session
+  start = esp_timer_get_time();
+  CHECK(store.compact([&expected](PersistEncoder &encoder) { expected.fill(encoder); }));
+  int64_t compact_us = esp_timer_get_time() - start;
+  CHECK(reload() == expected);
+
+  printf("%d/%d fichiers admis: sauvegarde %.1f ms, compaction %.1f ms (%u/%u blocs), chargement %.1f ms\n",
+         admitted, ENTRY_COUNT, save_us / 1000.0, compact_us / 1000.0, (unsigned)store.snap_chunks(),
+         (unsigned)store.snapshot_max(), load_us / 1000.0);
+}
+
+// Sans la limite du proxy: la compaction refuse l'état et les modifications en
+// attente restent bornées à un journal, l'état déjà écrit reste lisible
+static void test_overflow_is_bounded() {
+  host_nvs_reset();
+  State state;
+  InspectableStore store;
+  CHECK(store.open(PARTITION, NAMESPACE));
+  state.shareable["/premier"] = true;
+  store.record_shareable("/premier", true);
+  CHECK(store.flush());
+  State written = state;
+
+  for (int i = 0; i < ENTRY_COUNT; i++) {
+    std::string path = entry_path(i);
+    state.shareable[path] = true;
+    store.record_shareable(path, true);
+  }
+  CHECK(!store.flush());
+  CHECK(store.needs_compaction());
+  CHECK(!store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+  CHECK(store.pending_chunks() <= store.journal_max());
+  CHECK(reload() == written);
+}
+
+static bool has_key(const char *key) {
+  nvs_handle_t handle;
+  size_t len = 0;
+  nvs_open_from_partition(PARTITION, NAMESPACE, NVS_READWRITE, &handle);
+  bool found = nvs_get_blob(handle, key, nullptr, &len) == ESP_OK;
+  nvs_close(handle);
+  return found;
+}
+
+static void test_compaction_switches_slot() {
+  host_nvs_reset();
+  State state;
+  InspectableStore store;
+  CHECK(store.open(PARTITION, NAMESPACE));
+  CHECK(store.slot() == 0);
+
+  state.shareable["/a"] = true;
+  store.record_shareable("/a", true);
+  CHECK(store.flush());
+  CHECK(has_key("j0"));
+  CHECK(store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+  CHECK(store.slot() == 1);
+  CHECK(store.journal_chunks() == 0);
+  CHECK(has_key("sb0"));
+  CHECK(!has_key("j0"));
+
+  state.shareable["/b"] = false;
+  store.record_shareable("/b", false);
+  CHECK(store.flush());
+  CHECK(store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+  CHECK(store.slot() == 0);
+  CHECK(has_key("sa0"));
+  CHECK(!has_key("sb0"));
+  CHECK(reload() == state);
+
+  // Instantané impossible à écrire: "meta" et l'emplacement actif restent en place,
+  // les modifications en attente sont gardées pour le prochain essai
+  state.shareable["/c"] = true;
+  store.record_shareable("/c", true);
+  host_nvs_fail_writes(1);
+  CHECK(!store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+  CHECK(store.slot() == 0);
+  CHECK(store.has_pending());
+  State before = state;
+  before.shareable.erase("/c");
+  CHECK(reload() == before);
+  CHECK(store.flush());
+  CHECK(reload() == state);
+}
+
+// Blocs d'une compaction interrompue: effacés aussitôt, ou à l'ouverture suivante
+// après une coupure
+static void test_orphans_erased() {
+  host_nvs_reset();
+  State state;
+  {
+    InspectableStore store;
+    CHECK(store.open(PARTITION, NAMESPACE));
+    for (int i = 0; i < 100; i++) {
+      state.shareable[entry_path(i)] = true;
+    }
+    CHECK(state.size().chunks() >= 2);
+    host_nvs_fail_writes(1, 1);  // Deuxième bloc
+    CHECK(!store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+    CHECK(!has_key("sb0"));
+    CHECK(!has_key("sb1"));
+    CHECK(store.compact([&state](PersistEncoder &encoder) { state.fill(encoder); }));
+    CHECK(has_key("sb0"));
+  }
+
+  nvs_handle_t handle;
+  nvs_open_from_partition(PARTITION, NAMESPACE, NVS_READWRITE, &handle);
+  uint8_t junk[64] = {};
+  for (const char *key : {"sa0", "sb9", "j42"}) {
+    nvs_set_blob(handle, key, junk, sizeof(junk));
+  }
+  nvs_close(handle);
+  CHECK(reload() == state);
+  CHECK(!has_key("sa0"));
+  CHECK(!has_key("sb9"));
+  CHECK(!has_key("j42"));
+  CHECK(has_key("sb0"));
+}
+
+// Partition absente de la table: repli sur "nvs", avec le budget de sa taille
+static void test_default_partition_fallback() {
+  host_nvs_reset();
+  InspectableStore store;
+  CHECK(store.open("absente", NAMESPACE));
+  CHECK(store.snapshot_max() >= 1);
+  State state;
+  state.shareable["/a"] = true;
+  CHECK(store.fits(state.size()));
+  for (int i = 0; i < ENTRY_COUNT && store.fits(state.size()); i++) {
+    state.shareable[entry_path(i)] = true;
+  }
+  CHECK(!store.fits(state.size()));
+  CHECK(state.shareable.size() < (size_t)ENTRY_COUNT);
+}
+
+static void test_flush_failure_keeps_records() {
+  host_nvs_reset();
+  State state;
+  InspectableStore store;
+  CHECK(store.open(PARTITION, NAMESPACE));
+
+  state.shareable["/avant"] = true;
+  store.record_shareable("/avant", true);
+  CHECK(store.flush());
+
+  state.shareable["/pendant"] = true;
+  store.record_shareable("/pendant", true);
+  host_nvs_fail_writes(1);
+  CHECK(!store.flush());
+  CHECK(store.has_pending());
+  CHECK(store.needs_compaction());
+
+  // Ajoutées après l'échec: écrites derrière le lot restauré
+  state.shareable["/pendant"] = false;
+  store.record_shareable("/pendant", false);
+  CHECK(store.flush());
+  CHECK(reload() == state);
+
+  persist(store, state);
+  CHECK(!store.needs_compaction());
+  CHECK(reload() == state);
+}
+
+// CRC-32 (IEEE) de la charge, pour fabriquer des blocs valides mais mal formés
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void reseal(std::vector<uint8_t> &chunk) {
+  uint32_t crc = crc32(chunk.data() + PersistEncoder::HEADER_SIZE, chunk.size() - PersistEncoder::HEADER_SIZE);
+  for (int i = 0; i < 4; i++) {
+    chunk[4 + i] = (uint8_t)(crc >> (8 * i));
+  }
+}
+
+static int decode(const std::vector<uint8_t> &chunk, bool &ok) {
+  int records = 0;
+  ok = PersistEncoder::decode_chunk(chunk.data(), chunk.size(), [&records](const PersistRecord &) { records++; });
+  return records;
+}
+
+static void test_decode_bounds() {
+  PersistEncoder encoder(PersistentStore::CHUNK_SIZE);
+  CHECK(encoder.add_share("/dossier/fichier.bin", entry_token(1), 1700000000));
+  CHECK(encoder.add_shareable("/dossier/fichier.bin", true));
+  auto chunks = encoder.take_chunks();
+  CHECK(chunks.size() == 1);
+  const std::vector<uint8_t> chunk = chunks[0];
+  bool ok;
+  CHECK(decode(chunk, ok) == 2 && ok);
+
+  // Chaque troncature, CRC recalculé: jamais de lecture hors du bloc. Coupé juste
+  // après le partage, le bloc reste valide avec un seul enregistrement.
+  size_t first_record_end = PersistEncoder::HEADER_SIZE + 1 + 1 + entry_token(1).size() + 2 +
+                            strlen("/dossier/fichier.bin") + 8;
+  for (size_t len = PersistEncoder::HEADER_SIZE + 1; len < chunk.size(); len++) {
+    std::vector<uint8_t> truncated(chunk.begin(), chunk.begin() + len);
+    reseal(truncated);
+    int records = decode(truncated, ok);
+    CHECK(len == first_record_end ? ok && records == 1 : !ok);
+  }
+
+  std::vector<uint8_t> header_only(chunk.begin(), chunk.begin() + PersistEncoder::HEADER_SIZE);
+  reseal(header_only);
+  CHECK(decode(header_only, ok) == 0 && ok);
+  CHECK(!PersistEncoder::decode_chunk(chunk.data(), PersistEncoder::HEADER_SIZE - 1, [](const PersistRecord &) {}));
+
+  std::vector<uint8_t> corrupt = chunk;
+  corrupt[PersistEncoder::HEADER_SIZE + 3] ^= 0x01;
+  decode(corrupt, ok);
+  CHECK(!ok);  // CRC
+
+  corrupt = chunk;
+  corrupt[0] = 'X';
+  decode(corrupt, ok);
+  CHECK(!ok);  // Signature
+
+  corrupt = chunk;
+  corrupt[2] = PersistEncoder::VERSION + 1;
+  decode(corrupt, ok);
+  CHECK(!ok);  // Version
+
+  corrupt = chunk;
+  corrupt[PersistEncoder::HEADER_SIZE] = 0x7f;
+  reseal(corrupt);
+  CHECK(decode(corrupt, ok) == 0 && !ok);  // Type inconnu
+
+  // Longueurs annoncées au-delà de la fin du bloc
+  corrupt = chunk;
+  corrupt[PersistEncoder::HEADER_SIZE + 1] = 0xff;  // Token
+  reseal(corrupt);
+  decode(corrupt, ok);
+  CHECK(!ok);
+
+  corrupt = chunk;
+  size_t path_len_at = PersistEncoder::HEADER_SIZE + 2 + entry_token(1).size();
+  corrupt[path_len_at] = 0xff;  // Chemin
+  corrupt[path_len_at + 1] = 0xff;
+  reseal(corrupt);
+  decode(corrupt, ok);
+  CHECK(!ok);
+
+  // Bloc illisible en NVS: ignoré au chargement, les autres sont rejoués
+  host_nvs_reset();
+  {
+    InspectableStore store;
+    CHECK(store.open(PARTITION, NAMESPACE));
+    store.record_shareable("/perdu", true);
+    CHECK(store.flush());
+    store.record_shareable("/garde", true);
+    CHECK(store.flush());
+  }
+  nvs_handle_t handle;
+  nvs_open_from_partition(PARTITION, NAMESPACE, NVS_READWRITE, &handle);
+  nvs_set_blob(handle, "j0", corrupt.data(), corrupt.size());
+  nvs_close(handle);
+  State state = reload();
+  CHECK(state.shareable.size() == 1 && state.shareable.count("/garde") == 1);
+}
+
+int main() {
+  test_large_state();
+  test_overflow_is_bounded();
+  test_compaction_switches_slot();
+  test_orphans_erased();
+  test_default_partition_fallback();
+  test_flush_failure_keeps_records();
+  test_decode_bounds();
+  if (failures) {
+    fprintf(stderr, "%d vérification(s) en échec\n", failures);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
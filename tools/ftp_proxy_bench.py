@@ -0,0 +1,695 @@
+#!/usr/bin/env python3
+"""Banc de mesure du proxy FTP/HTTP.
+
+Deux éléments, sans dépendance hors de la bibliothèque standard:
+
+* un serveur FTP simulé (fichiers virtuels au contenu déterministe, latence
+  des réponses de contrôle et débit des connexions de données réglables,
+  répertoires de 10 à 100 000 entrées);
+* un générateur de charge HTTP concurrent qui mesure, par scénario, le débit,
+  le temps jusqu'au premier octet, les latences p50/p99, le taux d'échec et la
+  mémoire minimale libre signalée par le proxy.
+
+Le proxy doit être configuré avec ce poste comme `ftp_server` (identifiants
+quelconques). Exemples:
+
+    # Serveur FTP simulé seul, 20 ms par réponse, 2 Mo/s par connexion de données
+    tools/ftp_proxy_bench.py serve --port 2121 --latency-ms 20 --bandwidth 2M
+
+    # Serveur simulé et campagne complète, résultats en JSON
+    tools/ftp_proxy_bench.py run --proxy http://192.168.1.50:8080 --serve-ftp 21 \\
+        --concurrency 4 --output resultats.json
+
+    # Comparaison de deux campagnes
+    tools/ftp_proxy_bench.py compare avant.json apres.json
+"""
+
+import argparse
+import concurrent.futures
+import datetime
+import hashlib
+import http.client
+import json
+import random
+import socket
+import socketserver
+import sys
+import threading
+import time
+import urllib.parse
+
+# Contenu des fichiers virtuels: motif pseudo-aléatoire répété, décalé selon le
+# nom pour que deux fichiers ne se ressemblent pas et que chaque octet soit vérifiable
+PATTERN_SIZE = 65521  # Premier: un décalage de bloc ne retombe pas sur le motif
+PATTERN = bytes(random.Random(0x5eed).getrandbits(8) for _ in range(PATTERN_SIZE))
+MTIME = '20240115103000'
+
+DEFAULT_FILES = {
+    'bench/small.bin': 64 * 1024,
+    'bench/medium.bin': 4 * 1024 * 1024,
+    'bench/large.bin': 64 * 1024 * 1024,
+}
+DEFAULT_LISTINGS = (10, 1000, 100000)
+
+SCENARIOS = ('download', 'range', 'listing', 'share')
+
+
+def parse_size(text):
+    """'64K', '4M', '1G' ou un nombre d'octets."""
+    text = text.strip().upper()
+    units = {'K': 1024, 'M': 1024 ** 2, 'G': 1024 ** 3}
+    if text and text[-1] in units:
+        return int(float(text[:-1]) * units[text[-1]])
+    return int(text)
+
+
+def pattern_shift(path):
+    return int.from_bytes(hashlib.sha256(path.encode()).digest()[:4], 'big') % PATTERN_SIZE
+
+
+def file_bytes(path, offset, length):
+    """Octets [offset, offset + length) du fichier virtuel `path`."""
+    out = bytearray()
+    pos = (pattern_shift(path) + offset) % PATTERN_SIZE
+    while length > 0:
+        n = min(length, PATTERN_SIZE - pos)
+        out += PATTERN[pos:pos + n]
+        length -= n
+        pos = 0
+    return bytes(out)
+
+
+def normalize(path):
+    parts = [p for p in path.replace('\\', '/').split('/') if p and p != '.']
+    return '/'.join(parts)
+
+
+class VirtualTree:
+    """Arborescence simulée: fichiers de test et répertoires list<N>."""
+
+    def __init__(self, files, listings):
+        self.files = {normalize(k): v for k, v in files.items()}
+        self.listings = {'bench/list%d' % n: n for n in listings}
+
+    def size(self, path):
+        path = normalize(path)
+        if path in self.files:
+            return self.files[path]
+        directory, _, name = path.rpartition('/')
+        count = self.listings.get(directory)
+        if count and name.startswith('f') and name.endswith('.bin'):
+            index = int(name[1:-4]) if name[1:-4].isdigit() else -1
+            if 0 <= index < count:
+                return (index % 1000 + 1) * 1024
+        return None
+
+    def entries(self, path):
+        """Entrées (nom, est_répertoire, taille) d'un répertoire, None s'il n'existe pas."""
+        path = normalize(path)
+        if path in self.listings:
+            return ((('f%06d.bin' % i), False, (i % 1000 + 1) * 1024) for i in range(self.listings[path]))
+        prefix = path + '/' if path else ''
+        children = {}
+        for name in list(self.files) + list(self.listings):
+            if not name.startswith(prefix):
+                continue
+            rest = name[len(prefix):]
+            head, sep, _ = rest.partition('/')
+            if sep or name in self.listings:
+                children[head] = (head, True, 0)
+            else:
+                children[head] = (head, False, self.files[name])
+        if not children and path:
+            return None
+        return iter(sorted(children.values()))
+
+
+class MockFtpHandler(socketserver.StreamRequestHandler):
+    """Session FTP: mode passif uniquement, suffisant pour le proxy."""
+
+    def setup(self):
+        super().setup()
+        self.cwd = ''
+        self.rest = 0
+        self.passive = None
+
+    def reply(self, text):
+        # Une réponse part d'un seul envoi, après la latence simulée
+        if self.server.latency:
+            time.sleep(self.server.latency)
+        self.wfile.write(text.encode('utf-8') + b'\r\n')
+        self.wfile.flush()
+
+    def resolve(self, arg):
+        if arg.startswith('/'):
+            return normalize(arg)
+        return normalize(self.cwd + '/' + arg)
+
+    def handle(self):
+        self.reply('220 Serveur FTP simulé')
+        while True:
+            line = self.rfile.readline()
+            if not line:
+                break
+            command, _, arg = line.decode('utf-8', 'replace').rstrip('\r\n').partition(' ')
+            method = getattr(self, 'ftp_' + command.upper(), None)
+            if method is None:
+                self.reply('502 Commande non implémentée')
+                continue
+            if method(arg) is False:
+                break
+        if self.passive:
+            self.passive.close()
+
+    def ftp_USER(self, arg):
+        self.reply('331 Mot de passe requis')
+
+    def ftp_PASS(self, arg):
+        self.reply('230 Connecté')
+
+    def ftp_SYST(self, arg):
+        self.reply('215 UNIX Type: L8')
+
+    def ftp_FEAT(self, arg):
+        self.reply('211-Extensions:\r\n MLSD\r\n SIZE\r\n MDTM\r\n REST STREAM\r\n211 Fin')
+
+    def ftp_OPTS(self, arg):
+        self.reply('200 OK')
+
+    def ftp_TYPE(self, arg):
+        self.reply('200 Type ' + arg)
+
+    def ftp_NOOP(self, arg):
+        self.reply('200 NOOP')
+
+    def ftp_PWD(self, arg):
+        self.reply('257 "/%s"' % self.cwd)
+
+    def ftp_CWD(self, arg):
+        path = self.resolve(arg)
+        if self.server.tree.entries(path) is None:
+            self.reply('550 Répertoire introuvable')
+        else:
+            self.cwd = path
+            self.reply('250 OK')
+
+    def ftp_QUIT(self, arg):
+        self.reply('221 Au revoir')
+        return False
+
+    def ftp_SIZE(self, arg):
+        size = self.server.tree.size(self.resolve(arg))
+        self.reply('213 %d' % size if size is not None else '550 Fichier introuvable')
+
+    def ftp_MDTM(self, arg):
+        size = self.server.tree.size(self.resolve(arg))
+        self.reply('213 ' + MTIME if size is not None else '550 Fichier introuvable')
+
+    def ftp_REST(self, arg):
+        try:
+            self.rest = int(arg)
+        except ValueError:
+            self.reply('501 Position invalide')
+            return
+        self.reply('350 Reprise à %d' % self.rest)
+
+    def ftp_PASV(self, arg):
+        if self.passive:
+            self.passive.close()
+        self.passive = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.passive.bind((self.connection.getsockname()[0], 0))
+        self.passive.listen(1)
+        self.passive.settimeout(15)
+        host, port = self.passive.getsockname()
+        self.reply('227 Mode passif (%s,%d,%d)' % (host.replace('.', ','), port >> 8, port & 0xff))
+
+    def open_data(self):
+        if not self.passive:
+            self.reply('425 Utilisez PASV d\'abord')
+            return None
+        self.reply('150 Ouverture de la connexion de données')
+        try:
+            conn, _ = self.passive.accept()
+        except OSError:
+            return None
+        finally:
+            self.passive.close()
+            self.passive = None
+        return conn
+
+    def send_data(self, conn, chunks):
+        """Envoi limité au débit simulé; False si le client a fermé la connexion."""
+        bandwidth = self.server.bandwidth
+        start = time.monotonic()
+        sent = 0
+        try:
+            for chunk in chunks:
+                conn.sendall(chunk)
+                sent += len(chunk)
+                if bandwidth:
+                    delay = sent / bandwidth - (time.monotonic() - start)
+                    if delay > 0:
+                        time.sleep(delay)
+        except OSError:
+            return False
+        finally:
+            conn.close()
+        return True
+
+    def ftp_RETR(self, arg):
+        path = self.resolve(arg)
+        size = self.server.tree.size(path)
+        offset, self.rest = self.rest, 0
+        if size is None:
+            self.reply('550 Fichier introuvable')
+            return
+        conn = self.open_data()
+        if conn is None:
+            return
+
+        def chunks():
+            pos = offset
+            while pos < size:
+                n = min(64 * 1024, size - pos)
+                yield file_bytes(path, pos, n)
+                pos += n
+
+        if self.send_data(conn, chunks()):
+            self.reply('226 Transfert terminé')
+        else:
+            self.reply('426 Transfert interrompu')
+
+    def listing(self, arg, line_format):
+        # Les options de LIST ("-la") ne désignent pas un répertoire
+        arg = ' '.join(a for a in arg.split() if not a.startswith('-'))
+        entries = self.server.tree.entries(self.resolve(arg))
+        if entries is None:
+            self.reply('550 Répertoire introuvable')
+            return
+        conn = self.open_data()
+        if conn is None:
+            return
+
+        def chunks():
+            batch = []
+            for entry in entries:
+                batch.append(line_format(*entry))
+                if len(batch) == 256:
+                    yield ''.join(batch).encode('utf-8')
+                    batch = []
+            if batch:
+                yield ''.join(batch).encode('utf-8')
+
+        if self.send_data(conn, chunks()):
+            self.reply('226 Listing terminé')
+        else:
+            self.reply('426 Listing interrompu')
+
+    def ftp_MLSD(self, arg):
+        self.listing(arg, lambda name, is_dir, size: 'type=%s;size=%d;modify=%s; %s\r\n' % (
+            'dir' if is_dir else 'file', size, MTIME, name))
+
+    def ftp_LIST(self, arg):
+        self.listing(arg, lambda name, is_dir, size: '%s 1 ftp ftp %12d Jan 15  2024 %s\r\n' % (
+            'drwxr-xr-x' if is_dir else '-rw-r--r--', size, name))
+
+
+class MockFtpServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+    def __init__(self, address, tree, latency_ms=0, bandwidth=0):
+        super().__init__(address, MockFtpHandler)
+        self.tree = tree
+        self.latency = latency_ms / 1000.0
+        self.bandwidth = bandwidth
+
+
+def start_mock_ftp(args):
+    files = dict(DEFAULT_FILES)
+    for spec in args.file or ():
+        name, _, size = spec.rpartition(':')
+        files[name] = parse_size(size)
+    tree = VirtualTree(files, args.listing or DEFAULT_LISTINGS)
+    server = MockFtpServer((args.ftp_host, args.serve_ftp), tree, args.latency_ms, parse_size(args.bandwidth))
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+# Générateur de charge
+
+class Sample:
+    __slots__ = ('ok', 'ttfb', 'latency', 'bytes', 'error', 'body')
+
+    def __init__(self):
+        self.body = None  # Corps conservé pour les requêtes d'administration
+        self.ok = False
+        self.ttfb = None
+        self.latency = None
+        self.bytes = 0
+        self.error = None
+
+
+def http_request(base, method, path, headers=None, body=None, expect=(200,), check=None, timeout=60):
+    """Une requête chronométrée; check(status, corps) valide la réponse."""
+    url = urllib.parse.urlsplit(base)
+    sample = Sample()
+    start = time.monotonic()
+    conn = http.client.HTTPConnection(url.hostname, url.port or 80, timeout=timeout)
+    try:
+        conn.request(method, path, body=body, headers=headers or {})
+        response = conn.getresponse()
+        first = response.read(1)
+        sample.ttfb = time.monotonic() - start
+        parts = [first]
+        while True:
+            chunk = response.read(64 * 1024)
+            if not chunk:
+                break
+            parts.append(chunk)
+        sample.latency = time.monotonic() - start
+        payload = b''.join(parts)
+        sample.bytes = len(payload)
+        if response.status not in expect:
+            sample.error = 'status %d' % response.status
+        elif check and not check(response, payload):
+            sample.error = 'contenu invalide'
+        else:
+            sample.ok = True
+        if sample.ok and method == 'POST':
+            sample.body = payload
+    except (OSError, http.client.HTTPException) as e:
+        sample.latency = time.monotonic() - start
+        sample.error = type(e).__name__
+    finally:
+        conn.close()
+    return sample
+
+
+class MemorySampler(threading.Thread):
+    """Relève la mémoire libre minimale exposée par /api/metrics pendant un scénario."""
+
+    def __init__(self, base, interval):
+        super().__init__(daemon=True)
+        self.base = base
+        self.interval = interval
+        self.stop_event = threading.Event()
+        self.min_free_heap = None
+        self.min_largest_block = None
+
+    def run(self):
+        while not self.stop_event.is_set():
+            self.sample()
+            self.stop_event.wait(self.interval)
+        self.sample()
+
+    def sample(self):
+        url = urllib.parse.urlsplit(self.base)
+        try:
+            conn = http.client.HTTPConnection(url.hostname, url.port or 80, timeout=5)
+            conn.request('GET', '/api/metrics')
+            response = conn.getresponse()
+            data = json.loads(response.read()) if response.status == 200 else None
+            conn.close()
+        except (OSError, ValueError, http.client.HTTPException):
+            return
+        memory = (data or {}).get('memory', {})
+        for key, attr in (('min_free_heap', 'min_free_heap'), ('min_largest_block', 'min_largest_block')):
+            value = memory.get(key)
+            if value is not None:
+                current = getattr(self, attr)
+                setattr(self, attr, value if current is None else min(current, value))
+
+    def stop(self):
+        self.stop_event.set()
+        self.join()
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    low = int(k)
+    high = min(low + 1, len(values) - 1)
+    return values[low] + (values[high] - values[low]) * (k - low)
+
+
+def summarize(name, samples, wall, memory, extra=None):
+    ok = [s for s in samples if s.ok]
+    ttfb = [s.ttfb * 1000 for s in ok if s.ttfb is not None]
+    latency = [s.latency * 1000 for s in ok]
+    total_bytes = sum(s.bytes for s in ok)
+    errors = {}
+    for s in samples:
+        if not s.ok:
+            errors[s.error] = errors.get(s.error, 0) + 1
+
+    def stats(values):
+        return {
+            'p50': round(percentile(values, 50), 3) if values else None,
+            'p99': round(percentile(values, 99), 3) if values else None,
+            'max': round(max(values), 3) if values else None,
+        }
+
+    result = {
+        'scenario': name,
+        'requests': len(samples),
+        'failures': len(samples) - len(ok),
+        'failure_rate': round((len(samples) - len(ok)) / len(samples), 4) if samples else 0,
+        'errors': errors,
+        'bytes': total_bytes,
+        'wall_s': round(wall, 3),
+        'mb_per_s': round(total_bytes / wall / (1024 * 1024), 3) if wall > 0 else None,
+        'requests_per_s': round(len(ok) / wall, 2) if wall > 0 else None,
+        'ttfb_ms': stats(ttfb),
+        'latency_ms': stats(latency),
+        'min_free_heap': memory.min_free_heap,
+        'min_largest_block': memory.min_largest_block,
+    }
+    if extra:
+        result.update(extra)
+    return result
+
+
+def run_load(args, name, make_request, count, extra=None):
+    memory = MemorySampler(args.proxy, args.metrics_interval)
+    memory.start()
+    start = time.monotonic()
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.concurrency) as pool:
+        samples = list(pool.map(lambda i: make_request(i), range(count)))
+    wall = time.monotonic() - start
+    memory.stop()
+    result = summarize(name, samples, wall, memory, extra)
+    print('%-22s %5d req  %3d échecs  %8s Mo/s  ttfb p50 %s ms  p99 %s ms' % (
+        name, result['requests'], result['failures'], result['mb_per_s'],
+        result['ttfb_ms']['p50'], result['ttfb_ms']['p99']), file=sys.stderr)
+    return result
+
+
+def full_file_check(path):
+    expected = None
+
+    def check(response, payload):
+        nonlocal expected
+        if expected is None:
+            expected = hashlib.sha256(file_bytes(path, 0, len(payload))).digest()
+        return hashlib.sha256(payload).digest() == expected
+    return check
+
+
+def scenario_download(args):
+    results = []
+    for path, size in sorted(DEFAULT_FILES.items(), key=lambda item: item[1]):
+        if size > parse_size(args.max_file_size):
+            continue
+        check = full_file_check(path) if args.verify else None
+        results.append(run_load(args, 'download %s' % path.rpartition('/')[2],
+                                lambda i, p=path, c=check: http_request(args.proxy, 'GET', '/' + p, check=c),
+                                args.requests, {'file_size': size}))
+    return results
+
+
+def scenario_range(args):
+    path = 'bench/medium.bin'
+    size = DEFAULT_FILES[path]
+    rng = random.Random(args.seed)
+    ranges = []
+    for _ in range(args.requests):
+        start = rng.randrange(size)
+        ranges.append((start, min(size - 1, start + rng.randrange(1, 256 * 1024))))
+
+    def request(i):
+        start, end = ranges[i]
+
+        def check(response, payload):
+            return (response.getheader('Content-Range', '').startswith('bytes %d-%d/' % (start, end)) and
+                    payload == file_bytes(path, start, end - start + 1))
+        return http_request(args.proxy, 'GET', '/' + path, headers={'Range': 'bytes=%d-%d' % (start, end)},
+                            expect=(206,), check=check if args.verify else None)
+    return [run_load(args, 'range medium.bin', request, args.requests)]
+
+
+def scenario_listing(args):
+    results = []
+    for count in args.listing or DEFAULT_LISTINGS:
+        directory = 'bench/list%d' % count
+
+        def check(response, payload, n=count):
+            try:
+                return len(json.loads(payload)) == n
+            except ValueError:
+                return False
+        requests = max(1, args.requests // (10 if count >= 100000 else 1))
+        query = '/api/files?dir=' + urllib.parse.quote(directory)
+        results.append(run_load(args, 'listing %d' % count,
+                                lambda i, q=query, c=check: http_request(args.proxy, 'GET', q, check=c),
+                                requests, {'entries': count}))
+    return results
+
+
+def scenario_share(args):
+    path = 'bench/small.bin'
+    headers = {'Content-Type': 'application/json'}
+    http_request(args.proxy, 'POST', '/api/toggle-shareable',
+                 body=json.dumps({'path': path, 'shareable': True}), headers=headers)
+    created = http_request(args.proxy, 'POST', '/api/share', body=json.dumps({'path': path, 'expiry': 1}),
+                           headers=headers)
+    if not created.ok:
+        print('Création du lien de partage impossible: %s' % created.error, file=sys.stderr)
+        return [{'scenario': 'share lookup', 'requests': 0, 'failures': 1, 'failure_rate': 1.0,
+                 'errors': {'création du partage': 1}}]
+    link = json.loads(created.body)['link']
+    rng = random.Random(args.seed)
+    check = full_file_check(path) if args.verify else None
+
+    # Un tiers de jetons inconnus: mesure aussi le coût d'une recherche infructueuse
+    def request(i):
+        if rng.random() < 1 / 3:
+            return http_request(args.proxy, 'GET', '/share/%032x' % rng.getrandbits(128), expect=(404,))
+        return http_request(args.proxy, 'GET', link, check=check)
+    return [run_load(args, 'share lookup', request, args.requests)]
+
+
+def command_run(args):
+    server = start_mock_ftp(args) if args.serve_ftp else None
+    results = []
+    try:
+        for name in args.scenario:
+            results.extend(globals()['scenario_' + name](args))
+    finally:
+        if server:
+            server.shutdown()
+
+    report = {
+        'generated_at': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        'proxy': args.proxy,
+        'config': {
+            'concurrency': args.concurrency,
+            'requests': args.requests,
+            'latency_ms': args.latency_ms,
+            'bandwidth': parse_size(args.bandwidth),
+            'seed': args.seed,
+            'verify': args.verify,
+        },
+        'results': results,
+    }
+    text = json.dumps(report, indent=2, ensure_ascii=False)
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+    return 0 if all(r.get('failures', 0) == 0 for r in results) else 1
+
+
+def command_serve(args):
+    server = start_mock_ftp(args)
+    print('Serveur FTP simulé sur %s:%d' % server.server_address, file=sys.stderr)
+    try:
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        server.shutdown()
+    return 0
+
+
+def command_compare(args):
+    """Écart relatif des indicateurs principaux entre deux campagnes."""
+    with open(args.before, encoding='utf-8') as f:
+        before = {r['scenario']: r for r in json.load(f)['results']}
+    with open(args.after, encoding='utf-8') as f:
+        after = {r['scenario']: r for r in json.load(f)['results']}
+
+    regressions = 0
+    for name in after:
+        if name not in before:
+            continue
+        a, b = before[name], after[name]
+        row = []
+        for label, key, sub, higher_is_better in (('Mo/s', 'mb_per_s', None, True),
+                                                  ('ttfb p50', 'ttfb_ms', 'p50', False),
+                                                  ('ttfb p99', 'ttfb_ms', 'p99', False),
+                                                  ('lat p99', 'latency_ms', 'p99', False)):
+            old = a.get(key)
+            new = b.get(key)
+            if sub:
+                old = old and old.get(sub)
+                new = new and new.get(sub)
+            if not old or new is None:
+                continue
+            delta = (new - old) / old * 100
+            worse = delta < -args.threshold if higher_is_better else delta > args.threshold
+            regressions += worse
+            row.append('%s %+.1f%%%s' % (label, delta, ' !' if worse else ''))
+        if b.get('failures', 0) > a.get('failures', 0):
+            regressions += 1
+            row.append('échecs %d -> %d !' % (a.get('failures', 0), b['failures']))
+        print('%-22s %s' % (name, '  '.join(row)))
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    def ftp_options(p):
+        p.add_argument('--ftp-host', default='0.0.0.0', help='adresse d\'écoute du serveur simulé')
+        p.add_argument('--latency-ms', type=float, default=0, help='délai avant chaque réponse de contrôle')
+        p.add_argument('--bandwidth', default='0', help='débit max par connexion de données (0: illimité)')
+        p.add_argument('--file', action='append', help='fichier supplémentaire, chemin:taille (ex. a/b.bin:8M)')
+        p.add_argument('--listing', type=int, action='append', help='taille de répertoire bench/list<N>')
+
+    serve = sub.add_parser('serve', help='serveur FTP simulé seul')
+    serve.add_argument('--port', dest='serve_ftp', type=int, default=2121)
+    ftp_options(serve)
+    serve.set_defaults(func=command_serve)
+
+    run = sub.add_parser('run', help='campagne de mesure contre un proxy')
+    run.add_argument('--proxy', required=True, help='URL du proxy, ex. http://192.168.1.50:8080')
+    run.add_argument('--serve-ftp', type=int, metavar='PORT', help='démarrer aussi le serveur FTP simulé')
+    run.add_argument('--scenario', action='append', choices=SCENARIOS, help='scénarios (défaut: tous)')
+    run.add_argument('--concurrency', type=int, default=4)
+    run.add_argument('--requests', type=int, default=20, help='requêtes par scénario')
+    run.add_argument('--max-file-size', default='64M', help='taille max des fichiers téléchargés')
+    run.add_argument('--no-verify', dest='verify', action='store_false', help='ne pas vérifier le contenu reçu')
+    run.add_argument('--seed', type=int, default=1)
+    run.add_argument('--metrics-interval', type=float, default=0.5, help='période de relevé de /api/metrics (s)')
+    run.add_argument('--output', help='fichier JSON de résultats (défaut: sortie standard)')
+    ftp_options(run)
+    run.set_defaults(func=command_run)
+
+    compare = sub.add_parser('compare', help='comparer deux fichiers de résultats')
+    compare.add_argument('before')
+    compare.add_argument('after')
+    compare.add_argument('--threshold', type=float, default=10, help='écart toléré en pourcentage')
+    compare.set_defaults(func=command_compare)
+
+    args = parser.parse_args()
+    if getattr(args, 'scenario', 0) is None:
+        args.scenario = list(SCENARIOS)
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())